@@ -0,0 +1,15 @@
+AC_DEFUN([PROTO_WITH_MEMORY_POOL], [
+    AC_ARG_ENABLE(memory-pool, [AS_HELP_STRING([--enable-memory-pool], [Serve small VM allocations from a slab allocator])])
+
+    if test "x$enable_memory_pool" = xyes; then
+        AC_DEFINE([MEMORY_POOL], 1,
+                  [Define if you want the VM to allocate small blocks from a memory pool])
+    fi
+
+    AC_ARG_ENABLE(memory-stats, [AS_HELP_STRING([--enable-memory-stats], [Count VM allocations, for the simulator's -memory-stats])])
+
+    if test "x$enable_memory_stats" = xyes; then
+        AC_DEFINE([MEMORY_STATISTICS], 1,
+                  [Define if you want the VM to count its allocations])
+    fi
+])
@@ -0,0 +1,33 @@
+AC_DEFUN([PROTO_WITH_THREADS], [
+    dnl Off by default: a VM built for threads counts its references
+    dnl atomically, which slows down serial runs as well.
+    AC_ARG_ENABLE(threads, [AS_HELP_STRING([--enable-threads], [Build the simulator's parallel execution mode (-threads)])])
+
+    if test "x$enable_threads" = xyes; then
+        ACX_PTHREAD([have_threads=yes], [have_threads=no])
+    else
+        have_threads=no
+    fi
+
+    if test "x$have_threads" = xyes; then
+        AC_MSG_CHECKING([for thread-local storage])
+        AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[static __thread int x;]], [[x = 1;]])],
+                          [AC_MSG_RESULT([yes])],
+                          [AC_MSG_RESULT([no]); have_threads=no])
+    fi
+
+    if test "x$enable_threads" = xyes && test "x$have_threads" != xyes; then
+        AC_MSG_WARN([no POSIX threads with thread-local storage: -threads will run serially])
+    fi
+
+    if test "x$have_threads" = xyes; then
+        LIBS="$PTHREAD_LIBS $LIBS"
+        CXXFLAGS="$CXXFLAGS $PTHREAD_CFLAGS"
+        AC_DEFINE([HAVE_PTHREAD], 1,
+                  [Define if you have POSIX threads libraries and header files.])
+        AC_DEFINE([THREAD_SAFE_VM], 1,
+                  [Define if VMs may run concurrently in separate threads])
+        AC_DEFINE([THREAD_LOCAL], [__thread],
+                  [Storage class for variables that have a value per thread])
+    fi
+])
@@ -0,0 +1,78 @@
+/* Field construction micro-benchmark
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// Measures the cost of building a field of one entry per neighbour,
+// as NBR_IDS and the pointwise field instructions do, against the
+// size of the neighbourhood.  Three ways of building are compared:
+//   by-one:    growing by a single element per push, copy-constructing
+//              and destroying every element each time, as FieldData did
+//              before it grew geometrically (see ByOneVector)
+//   geometric: pushing into an empty field and letting it grow
+//   reserved:  pushing into a field pre-sized to the neighbourhood
+//
+// usage: fieldbench [total entries per measurement]
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "data.hpp"
+
+enum Strategy { BY_ONE, GEOMETRIC, RESERVED };
+
+// the old SharedVector storage: full pushes reallocate one element larger
+template<typename Element> class ByOneVector {
+  Element* elements; Size size, capacity;
+ public:
+  ByOneVector() : elements(0), size(0), capacity(0) {}
+  ~ByOneVector() {
+    for(Index i=0;i<size;i++) elements[i].~Element();
+    if(elements) Memory<Element>::deallocate(elements,capacity);
+  }
+  void push(Element const & element) {
+    if(size==capacity) {
+      Element* grown = Memory<Element>::allocate(capacity+1);
+      for(Index i=0;i<size;i++)
+        { new (&grown[i]) Element(elements[i]); elements[i].~Element(); }
+      if(elements) Memory<Element>::deallocate(elements,capacity);
+      elements = grown; capacity++;
+    }
+    new (&elements[size++]) Element(element);
+  }
+};
+
+// build fields of n entries until 'entries' entries have been pushed;
+// returns nanoseconds per field
+double build_fields(Strategy strategy, int n, int entries) {
+  int rounds = entries/n;
+  double start = get_real_secs();
+  for(int r=0;r<rounds;r++) {
+    if(strategy==BY_ONE) { // ids and values, like the old FieldData
+      ByOneVector<MachineId> ids; ByOneVector<Data> values;
+      for(int i=0;i<n;i++)
+        { ids.push(i); values.push(Data(static_cast<Number>(i))); }
+      continue;
+    }
+    FieldData f = (strategy==RESERVED) ? FieldData(n) : FieldData();
+    for(int i=0;i<n;i++) f.push(i,Data(static_cast<Number>(i)));
+  }
+  return (get_real_secs()-start)*1e9/rounds;
+}
+
+int main(int argc, char *argv[]) {
+  int entries = (argc>1) ? atoi(argv[1]) : 4000000;
+  printf("%10s %14s %14s %14s\n","neighbours","by-one (ns)","geometric (ns)",
+         "reserved (ns)");
+  for(int n=1;n<=1024;n*=2) {
+    printf("%10d %14.1f %14.1f %14.1f\n",n,
+           build_fields(BY_ONE,n,entries),
+           build_fields(GEOMETRIC,n,entries),
+           build_fields(RESERVED,n,entries));
+  }
+  return 0;
+}
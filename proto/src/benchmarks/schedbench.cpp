@@ -0,0 +1,73 @@
+/* Scheduler throughput benchmark
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// Measures how many events per second each kind of Scheduler can take
+// in and give out, against the number of devices.  After running the
+// regression test of Scheduler::test, each device is driven the way
+// SpatialComputer drives it: every computation schedules the next
+// computation one period later and a broadcast half a period later, and
+// time advances in steps of 0.01 seconds.  Periods are either jittered
+// (like the default time model) or all the same (like -sync).  A
+// measurement stops after 10 seconds of real time, since the slot
+// scheduler can take hours on large synchronized runs; a measurement of
+// 0 means the devices could not even be loaded in that time.
+//
+// usage: schedbench [simulated seconds per measurement]
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+#include "scheduler.h"
+
+enum { COMPUTE, BROADCAST };
+#define MAX_REAL_SECS 10
+
+// runs n devices for 'seconds' of simulated time; returns events/second
+double run_devices(const char* name, int n, bool sync, double seconds) {
+  RandomStream rng(n);
+  Scheduler* sch = Scheduler::create(name, n, 1.0);
+  long events = 0;
+  Event e;
+  double start = get_real_secs(), elapsed = 0;
+  for(int i=0;i<n && elapsed<MAX_REAL_SECS;i++) {
+    sch->schedule_event((void*)(long)i,sync?0:rng.urnd(0,1),0,COMPUTE,i);
+    if(!(i%1024)) elapsed=get_real_secs()-start;
+  }
+  for(double t=0.01; t<=seconds && elapsed<MAX_REAL_SECS; t+=0.01) {
+    sch->set_bound(t);
+    while(sch->pop_next_event(&e)) {
+      events++;
+      if(e.type==COMPUTE) {
+        double period = sync ? 1 : rng.urnd(0.95,1.05);
+        sch->schedule_event(e.target,e.true_time+period,0,COMPUTE,e.uid);
+        sch->schedule_event(e.target,e.true_time+period/2,0,BROADCAST,e.uid);
+      }
+      if(!(events%1024) && (elapsed=get_real_secs()-start)>MAX_REAL_SECS)
+        break;
+    }
+    elapsed = get_real_secs()-start;
+  }
+  delete sch;
+  return events/elapsed;
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = (argc>1) ? atof(argv[1]) : 10;
+  const char* names[] = {"slots", "calendar", "heap"};
+  Scheduler::test();
+  printf("%10s %10s %16s %16s\n","scheduler","devices","events/second",
+         "(synchronized)");
+  for(int k=0;k<3;k++) {
+    for(int n=10000;n<=1000000;n*=10)
+      printf("%10s %10d %16.0f %16.0f\n",names[k],n,
+             run_devices(names[k],n,false,seconds),
+             run_devices(names[k],n,true,seconds));
+  }
+  return 0;
+}
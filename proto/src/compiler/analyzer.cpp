@@ -535,6 +535,7 @@ private:
   CompoundOp *add_detuplization(CompoundOp *cop);
   CompoundOp *make_nbr_subroutine(OperatorInstance *oi, Field **exportf);
   Operator *nbr_op_to_folder(OperatorInstance *oi);
+  Operator *fused_folder(OperatorInstance *oi);
   void restrict_elements(OIset* elts,vector<Field *>* exports, AM* am,OI* summary_op);
 };
 
@@ -630,9 +631,19 @@ HoodToFolder::act(OperatorInstance *oi)
   if (oi->inputs.size() == 1 && oi->inputs[0] != NULL
       && oi->inputs[0]->range->isA("ProtoField")
       && oi->output->range->isA("ProtoLocal")) {
+    AM *space = oi->output->domain;
+    // A summary of a single nbr needs no subroutines: (fold-hood-X input)
+    Operator *fused = fused_folder(oi);
+    if (fused) {
+      V2 << "Changing to " << fused->name << ": " << ce2s(oi) << endl;
+      OI *noi = new OperatorInstance(oi, fused, space);
+      noi->add_input(oi->inputs[0]->producer->inputs[0]);
+      root->relocate_consumers(oi->output, noi->output); note_change(oi);
+      root->delete_node(oi);
+      return;
+    }
     V2 << "Changing to fold-hood: " << ce2s(oi) << endl;
     // (fold-hood-plus folder fn input)
-    AM *space = oi->output->domain;
     Field *exportf;
     CompoundOp *nbrop = make_nbr_subroutine(oi, &exportf);
     Operator *folder = nbr_op_to_folder(oi);
@@ -924,6 +935,26 @@ HoodToFolder::nbr_op_to_folder(OperatorInstance *oi)
       op_err(oi, "Can't convert summary '" + name + "' to local operator");
 }
 
+/**
+ * The fused fold that does what a summary does to the nbr of a single
+ * export, or NULL if the summary is of anything else.
+ */
+Operator *
+HoodToFolder::fused_folder(OperatorInstance *oi)
+{
+  OI *nbr = oi->inputs[0]->producer;
+  if (nbr->op != Env::core_op("nbr") || nbr->inputs.size() != 1)
+    return NULL;
+  const string &name = oi->op->name;
+  if      (name == "min-hood") return Env::core_op("fold-hood-min");
+  else if (name == "max-hood") return Env::core_op("fold-hood-max");
+  else if (name == "any-hood") return Env::core_op("fold-hood-max");
+  else if (name == "all-hood") return Env::core_op("fold-hood-min");
+  else if (name == "sum-hood") return Env::core_op("fold-hood-sum");
+  else
+    return NULL;
+}
+
 // Changes restrict/mux complexes to branches
 // Mechanism:
 // 1. find complementary AM selector pairs
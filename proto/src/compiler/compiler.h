@@ -186,10 +186,12 @@ class ProtoKernelEmitter : public CodeEmitter { public: reflection_sub(ProtoKern
   /// List of folding ops, which are also scalar/vector pairs.
   std::map<std::string, std::pair<int, int> > fold_ops;
 
+  /// List of fused folding ops, which are also scalar/vector pairs.
+  std::map<std::string, std::pair<int, int> > fused_fold_ops;
+
   /// List of Feedback ops, dchange, delay
   std::map<std::string, std::pair<int, int> > feedback_ops;
 
-  Instruction *start, *end;
 
   void load_ops(const std::string &name);
   void read_extension_ops(std::istream *stream);
@@ -201,6 +203,7 @@ class ProtoKernelEmitter : public CodeEmitter { public: reflection_sub(ProtoKern
   Instruction *standard_primitive_instruction(OperatorInstance *oi);
   Instruction *vector_primitive_instruction(OperatorInstance *oi);
   Instruction *fold_primitive_instruction(OperatorInstance *oi);
+  Instruction *fused_fold_primitive_instruction(OperatorInstance *oi);
   Instruction *init_feedback_instruction(OperatorInstance *oi);
   Instruction *ref_instruction(OperatorInstance *oi);
   OperatorInstance *find_dchange(OperatorInstance *oi);
@@ -222,6 +225,37 @@ class ProtoKernelEmitter : public CodeEmitter { public: reflection_sub(ProtoKern
 
   /// allocates globals for vector ops
   Instruction *vec_op_store(ProtoType *t);
+
+ protected:
+  /// The emitted instruction chain, from DEF_VM to EXIT.
+  Instruction *start, *end;
+};
+
+/**
+ * Emits ProtoKernel bytecode, then lowers the straight-line numeric runs
+ * of that bytecode to C++ and compiles them into a shared library.  The
+ * simulator runs a lowered block in place of its instructions whenever
+ * all of the block's inputs are numbers, and the bytecode otherwise, so
+ * results are the same either way.
+ */
+class NativeEmitter : public ProtoKernelEmitter { public: reflection_sub(NativeEmitter, ProtoKernelEmitter);
+ public:
+  /// Library compiled for the last script, or "" if none was made.
+  std::string library;
+
+  NativeEmitter(NeoCompiler *parent, Args *args);
+  ~NativeEmitter() { discard_library(); }
+  uint8_t *emit_from(DFG *g, int *len);
+  /// Removes the library's files, once it is loaded (unless they are kept).
+  void discard_library();
+  virtual void print(std::ostream *out = cpout) { *cpout << "NativeEmitter"; }
+
+ private:
+  /// Where source and library go: fixed by -native-dir, else a temp dir.
+  std::string dir;
+  bool is_keep;
+
+  int write_source(uint8_t *buf, int len, std::ostream *out);
 };
 
 /*****************************************************************************
@@ -10,10 +10,16 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 // execute it.
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -21,6 +27,7 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "compiler.h"
 #include "plugin_manager.h"
+#include "proto_native.h"
 #include "proto_opcodes.h"
 #include "scoped_ptr.h"
 
@@ -582,7 +589,7 @@ struct InstructionWithIndex : public Instruction {
     buf[location] = op;
     for (size_t i = 0; i < parameters.size(); i++)
       buf[location + 1 + i] = parameters[i];
-    buf[location + 1 + parameters.size() + 1] = static_cast<uint8_t>(index);
+    buf[location + 1 + parameters.size()] = static_cast<uint8_t>(index);
     if (next)
       next->output(buf);
   }
@@ -598,6 +605,13 @@ struct Fold : public InstructionWithIndex {
   {}
 };
 
+// A fold of the exports of the neighbors that needs no callbacks.
+
+struct FusedFold : public InstructionWithIndex {
+  reflection_sub(FusedFold, InstructionWithIndex);
+  FusedFold(OPCODE opcode) : InstructionWithIndex(opcode) {}
+};
+
 struct InitFeedback : public Instruction {
   CompoundOp *init;
   CompoundOp *update;
@@ -1349,8 +1363,9 @@ class ResolveState : public InstructionPropagator {
   void
   act(Instruction *instruction)
   {
-    if (instruction->isA("Fold")) {
-      Fold *fold = &dynamic_cast<Fold &>(*instruction);
+    if (instruction->isA("Fold") || instruction->isA("FusedFold")) {
+      InstructionWithIndex *fold
+        = &dynamic_cast<InstructionWithIndex &>(*instruction);
       fold->index = n_exports_++;
       export_len_ += 1;   // FIXME: Add up the tuple lengths.
     }  else if (instruction->isA("InitFeedback")) {
@@ -1725,6 +1740,8 @@ ProtoKernelEmitter::primitive_to_instruction(OperatorInstance *oi)
     return vector_primitive_instruction(oi);
   else if (fold_ops.count(primitive->name))
     return fold_primitive_instruction(oi);
+  else if (fused_fold_ops.count(primitive->name))
+    return fused_fold_primitive_instruction(oi);
   else if (primitive->name == "dchange")
 	  return init_feedback_instruction(oi);
   else if (primitive->name == "store")
@@ -1842,6 +1859,20 @@ ProtoKernelEmitter::fold_primitive_instruction(OperatorInstance *oi)
   return newf;
 }
 
+Instruction *
+ProtoKernelEmitter::fused_fold_primitive_instruction(OperatorInstance *oi)
+{
+  Primitive *p = &dynamic_cast<Primitive &>(*oi->op);
+  ProtoType *output_type = oi->output->range;
+
+  if (!output_type->isA("ProtoTuple"))
+    return new FusedFold(fused_fold_ops[p->name].first);
+  // The vector variants take the length of the tuple first.
+  FusedFold *fold = new FusedFold(fused_fold_ops[p->name].second);
+  fold->padd8(dynamic_cast<ProtoTuple &>(*output_type).types.size());
+  return fold;
+}
+
 Instruction *
 ProtoKernelEmitter::init_feedback_instruction(OperatorInstance *oi)
 {
@@ -2203,6 +2234,10 @@ ProtoKernelEmitter::load_ops(const string &name)
 
   fold_ops["fold-hood"] = make_pair(FOLD_HOOD_OP, VFOLD_HOOD_OP);
   fold_ops["fold-hood-plus"] = make_pair(FOLD_HOOD_PLUS_OP, VFOLD_HOOD_PLUS_OP);
+
+  fused_fold_ops["fold-hood-min"] = make_pair(FOLD_HOOD_MIN_OP, VFOLD_HOOD_MIN_OP);
+  fused_fold_ops["fold-hood-max"] = make_pair(FOLD_HOOD_MAX_OP, VFOLD_HOOD_MAX_OP);
+  fused_fold_ops["fold-hood-sum"] = make_pair(FOLD_HOOD_SUM_OP, VFOLD_HOOD_SUM_OP);
 }
 
 // Load a .proto file named `name', containing not Proto code but
@@ -2701,6 +2736,293 @@ uint8_t* ProtoKernelEmitter::emit_from(DFG* g, int* len) {
   return buf;
 }
 
+/*****************************************************************************
+ *  NATIVE EMITTER                                                           *
+ *****************************************************************************/
+
+// Lowering works on the finished bytecode, using the instruction chain
+// only to find where each instruction starts.  A block is a straight run
+// of instructions that compute nothing but numbers from numbers: literals,
+// references, lets, and scalar math, following the VM's definitions of
+// each exactly.  It becomes a C++ function from the block's inputs (the
+// stack, environment, and global values it reads) to its outputs (what it
+// leaves on the stack, then the lets it leaves on the environment).
+
+// The C++ compiler for native code: the one the simulator was built with,
+// so that math functions resolve to the same overloads as in the VM
+#ifndef NATIVE_CXX
+#define NATIVE_CXX "c++"
+#endif
+#define NATIVE_MIN_OPS 3 // shorter blocks cost more to enter than they save
+
+// add the offset and size of each instruction under i, in script order
+static void native_spans(Instruction* i, vector<pair<int,int> >* spans) {
+  for(; i; i=i->next) {
+    Block* b = dynamic_cast<Block*>(i);
+    if(b) native_spans(b->contents,spans);
+    else if(i->size()>0) spans->push_back(make_pair(i->location,i->size()));
+  }
+}
+
+// the same decoding as Machine::nextInt
+static unsigned int native_int(const uint8_t* p) {
+  unsigned int value = 0;
+  while(true) {
+    uint8_t next = *p++;
+    value |= next & 0x7F;
+    if(next & 0x80) value <<= 7; else break;
+  }
+  return value;
+}
+
+/// Gathers blocks one instruction at a time, writing each as a function
+struct NativeLowering {
+  ostringstream functions, table;
+  vector<uint32_t> literals; // bit patterns, read back at run time
+  int n_blocks;
+  // the block being gathered
+  int start, end, n_ops, n_pop, n_temps;
+  vector<uint32_t> inputs;
+  map<uint32_t,string> input_names;
+  vector<string> stack, lets; // names of the values the block has left
+  ostringstream code;
+
+  NativeLowering() { n_blocks=0; clear(); }
+  void clear() {
+    start=end=-1; n_ops=n_pop=n_temps=0;
+    inputs.clear(); input_names.clear(); stack.clear(); lets.clear();
+    code.str("");
+  }
+  bool is_full() { // could the next instruction overflow the block's I/O?
+    return inputs.size()+3 > PROTO_NATIVE_MAX_IO ||
+      stack.size()+lets.size()+1 > PROTO_NATIVE_MAX_IO;
+  }
+
+  string input(uint32_t kind, uint32_t index) {
+    uint32_t key = (kind<<28) | index;
+    if(!input_names.count(key)) {
+      input_names[key] = "in["+i2s(inputs.size())+"]";
+      inputs.push_back(key);
+    }
+    return input_names[key];
+  }
+  string pop() {
+    if(stack.empty()) return input(PROTO_NATIVE_STACK,n_pop++);
+    string v = stack.back(); stack.pop_back(); return v;
+  }
+  void push(string expr) {
+    string t = "t"+i2s(n_temps++);
+    code << "  Number " << t << " = " << expr << ";\n";
+    stack.push_back(t);
+  }
+  string literal(float value) {
+    uint32_t bits; memcpy(&bits,&value,sizeof(bits));
+    literals.push_back(bits);
+    return "L("+i2s(literals.size()-1)+")";
+  }
+  void ref(unsigned int index) {
+    if(index<lets.size()) stack.push_back(lets[lets.size()-1-index]);
+    else stack.push_back(input(PROTO_NATIVE_ENV,index-lets.size()));
+  }
+  void let(unsigned int n) { // deepest first, as LET pushes them
+    vector<string> v(n);
+    for(int i=n-1;i>=0;i--) v[i]=pop();
+    for(unsigned int i=0;i<n;i++) lets.push_back(v[i]);
+  }
+  void all(unsigned int n) {
+    string keep = pop();
+    for(unsigned int i=1;i<n;i++) pop();
+    stack.push_back(keep);
+  }
+  void unary(string f) { string a=pop(); push(f+"("+a+")"); }
+  void binary(string f) { string b=pop(), a=pop(); push(f+"("+a+", "+b+")"); }
+  void infix(string op) { string b=pop(), a=pop(); push(a+" "+op+" "+b); }
+  void test(string op) { string b=pop(), a=pop(); push(a+" "+op+" "+b+" ? 1 : 0"); }
+  void pick(string op) {
+    string b=pop(), a=pop(); push(a+" "+op+" "+b+" ? "+a+" : "+b);
+  }
+
+  /// Adds the instruction to the block; false if it cannot be lowered
+  bool lower(const uint8_t* ins) {
+    OPCODE op = ins[0]; const uint8_t* p = ins+1;
+    switch(op) {
+    case LIT_OP: push(literal(native_int(p))); break;
+    case LIT_0_OP: case LIT_1_OP: case LIT_2_OP: case LIT_3_OP: case LIT_4_OP:
+      push(literal(op-LIT_0_OP)); break;
+    case LIT_FLO_OP: { float f; memcpy(&f,p,sizeof(f)); push(literal(f)); } break;
+    case INF_OP: push(literal(INFINITY)); break;
+    case REF_OP: ref(native_int(p)); break;
+    case REF_0_OP: case REF_1_OP: case REF_2_OP: case REF_3_OP:
+      ref(op-REF_0_OP); break;
+    case GLO_REF_OP:
+      stack.push_back(input(PROTO_NATIVE_GLOBAL,native_int(p))); break;
+    case GLO_REF_0_OP: case GLO_REF_1_OP: case GLO_REF_2_OP: case GLO_REF_3_OP:
+      stack.push_back(input(PROTO_NATIVE_GLOBAL,op-GLO_REF_0_OP)); break;
+    case LET_OP: let(native_int(p)); break;
+    case LET_1_OP: case LET_2_OP: case LET_3_OP: case LET_4_OP:
+      let(op-LET_1_OP+1); break;
+    case POP_LET_OP: case POP_LET_1_OP: case POP_LET_2_OP: case POP_LET_3_OP:
+    case POP_LET_4_OP: { // only the block's own lets can be dropped
+      unsigned int n = (op==POP_LET_OP) ? native_int(p) : op-POP_LET_1_OP+1;
+      if(n>lets.size()) return false;
+      lets.resize(lets.size()-n);
+    } break;
+    case ALL_OP: all(native_int(p)); break;
+    case MUX_OP: {
+      string f=pop(), t=pop(), c=pop(); push(c+" ? "+t+" : "+f);
+    } break;
+    case ADD_OP: infix("+"); break;
+    case SUB_OP: infix("-"); break;
+    case MUL_OP: infix("*"); break;
+    case DIV_OP: infix("/"); break;
+    case LT_OP: test("<"); break;
+    case LTE_OP: test("<="); break;
+    case GT_OP: test(">"); break;
+    case GTE_OP: test(">="); break;
+    case EQ_OP: test("=="); break;
+    case MAX_OP: pick(">"); break;
+    case MIN_OP: pick("<"); break;
+    case NOT_OP: { string a=pop(); push(a+" ? 0 : 1"); } break;
+    case ABS_OP: { string a=pop(); push(a+" < 0 ? -"+a+" : "+a); } break;
+    case POW_OP: binary("pow"); break;
+    case REM_OP: binary("fmod"); break;
+    case MOD_OP: binary("native_mod"); break;
+    case ATAN2_OP: binary("atan2"); break; // y under x, as ATAN2 pops them
+    case FLOOR_OP: unary("floor"); break;
+    case CEIL_OP: unary("ceil"); break;
+    case ROUND_OP: unary("rint"); break;
+    case LOG_OP: unary("log"); break;
+    case SQRT_OP: unary("sqrt"); break;
+    case SIN_OP: unary("sin"); break;
+    case COS_OP: unary("cos"); break;
+    case TAN_OP: unary("tan"); break;
+    case SINH_OP: unary("sinh"); break;
+    case COSH_OP: unary("cosh"); break;
+    case TANH_OP: unary("tanh"); break;
+    case ASIN_OP: unary("asin"); break;
+    case ACOS_OP: unary("acos"); break;
+    default: return false;
+    }
+    return true;
+  }
+
+  /// Writes out the block gathered so far, if it is worth running natively
+  void finish() {
+    if(n_ops >= NATIVE_MIN_OPS) {
+      int n = n_blocks++;
+      functions << "static void block" << n
+                << "(const Number* in, Number* out) {\n" << code.str();
+      for(size_t i=0;i<stack.size();i++)
+        functions << "  out[" << i << "] = " << stack[i] << ";\n";
+      for(size_t i=0;i<lets.size();i++)
+        functions << "  out[" << stack.size()+i << "] = " << lets[i] << ";\n";
+      functions << "}\n";
+      if(inputs.size()) {
+        functions << "static const uint32_t inputs" << n << "[] = {";
+        for(size_t i=0;i<inputs.size();i++)
+          functions << (i ? ", " : " ") << inputs[i] << "u";
+        functions << " };\n";
+      }
+      table << "  { " << start << ", " << end << ", " << inputs.size()
+            << ", " << n_pop << ", " << stack.size() << ", " << lets.size()
+            << ", " << (inputs.size() ? "inputs"+i2s(n) : "0")
+            << ", block" << n << " },\n";
+    }
+    clear();
+  }
+};
+
+NativeEmitter::NativeEmitter(NeoCompiler *parent, Args *args)
+  : ProtoKernelEmitter(parent, args)
+{
+  is_keep = args->extract_switch("-native-dir");
+  dir = is_keep ? args->pop_next() : "";
+}
+
+int NativeEmitter::write_source(uint8_t *buf, int len, ostream *out) {
+  vector<pair<int,int> > spans; native_spans(start,&spans);
+  NativeLowering l;
+  for(size_t i=0;i<spans.size();i++) {
+    if(l.is_full()) l.finish();
+    if(l.start<0) l.start = spans[i].first;
+    if(l.lower(buf+spans[i].first)) {
+      l.end = spans[i].first+spans[i].second; l.n_ops++;
+    } else {
+      l.finish();
+    }
+  }
+  l.finish();
+  if(!l.n_blocks) return 0;
+
+  *out << "// Native blocks for a " << len << " byte script, made by proto -native\n"
+       << "#include <stdint.h>\n#include <string.h>\n#include <cmath>\n"
+       << "using namespace std; // for the float overloads, as in the VM\n"
+       << "typedef float Number;\n\n"
+       << "// as declared in proto_native.h\n"
+       << "struct ProtoNativeBlock {\n"
+       << "  uint32_t start, end;\n  uint16_t n_in, n_pop;\n"
+       << "  uint16_t n_out, n_let;\n  const uint32_t* inputs;\n"
+       << "  void (*run)(const float* in, float* out);\n};\n"
+       << "struct ProtoNativeProgram {\n"
+       << "  uint32_t version, script_size, n_blocks;\n"
+       << "  const ProtoNativeBlock* blocks;\n};\n\n"
+       << "// literals are read at run time, so none are folded into math\n"
+       << "// functions at compile time (which may round differently)\n"
+       << "extern \"C\" uint32_t proto_native_literals[] = {";
+  for(size_t i=0;i<l.literals.size();i++)
+    *out << (i ? ", " : " ") << l.literals[i] << "u";
+  if(l.literals.empty()) *out << " 0";
+  *out << " };\n"
+       << "static inline Number L(int i) {\n"
+       << "  Number x; memcpy(&x,&proto_native_literals[i],sizeof(x)); return x;\n}\n"
+       << "static inline Number native_mod(Number a, Number b) { // as in MOD\n"
+       << "  Number x = fmod(a,b);\n  if (x < 0) x += b;\n  return x;\n}\n\n"
+       << l.functions.str() << "\n"
+       << "static const ProtoNativeBlock blocks[] = {\n" << l.table.str() << "};\n"
+       << "extern \"C\" const ProtoNativeProgram " << PROTO_NATIVE_SYMBOL
+       << " = {\n  " << PROTO_NATIVE_VERSION << ", " << len << ", "
+       << l.n_blocks << ", blocks\n};\n";
+  return l.n_blocks;
+}
+
+uint8_t* NativeEmitter::emit_from(DFG* g, int* len) {
+  discard_library();
+  uint8_t* buf = ProtoKernelEmitter::emit_from(g,len);
+
+  V1<<"Lowering instruction sequence to native code...\n";
+  if(dir.empty()) {
+    const char* tmp = getenv("TMPDIR");
+    string path = string(tmp ? tmp : "/tmp")+"/proto-native-XXXXXX";
+    vector<char> name(path.begin(),path.end()); name.push_back(0);
+    if(mkdtemp(&name[0])==NULL)
+      { compile_warn("Unable to make a directory for native code"); return buf; }
+    dir = &name[0];
+  }
+  string stem = dir+"/program";
+  ofstream source((stem+".cpp").c_str());
+  int n = write_source(buf,*len,&source);
+  source.close();
+  if(n) {
+    string cmd = string(NATIVE_CXX)+" -shared -fPIC -ffp-contract=off -o \""
+      +stem+".so\" \""+stem+".cpp\"";
+    V2<<cmd<<endl;
+    if(system(cmd.c_str())==0) library = stem+".so";
+    else compile_warn("Unable to compile native code; running bytecode only");
+  }
+  V1<<"Lowered "<<n<<" blocks to native code\n";
+  if(!is_keep) remove((stem+".cpp").c_str());
+  if(library.empty()) discard_library();
+  return buf;
+}
+
+void NativeEmitter::discard_library() {
+  if(!is_keep && !dir.empty()) {
+    if(!library.empty()) remove(library.c_str());
+    rmdir(dir.c_str()); dir = "";
+  }
+  library = "";
+}
+
 // How will the emitter work:
 // There are template mappings for;
 // Literal: -> LIT_k_OP, LIT8_OP, LIT16_OP, LIT_FLO_OP
@@ -1049,6 +1049,10 @@ AST_OP *fold_op;
 AST_OP *vfold_op;
 AST_OP *fold_hood_plus_op;
 AST_OP *vfold_hood_plus_op;
+AST_OP *fold_hood_min_op, *vfold_hood_min_op;
+AST_OP *fold_hood_max_op, *vfold_hood_max_op;
+AST_OP *fold_hood_sum_op, *vfold_hood_sum_op;
+AST_OP *fold_hood_any_op, *fold_hood_all_op;
 AST_OP *apply_op;
 AST_OP *nul_tup_op;
 AST_OP *tup_op;
@@ -1063,6 +1067,23 @@ AST_OP *def_vec_op;
 AST_OP *def_tup_op;
 AST_OP *def_op;
 
+bool is_fused_fold_hood (AST_OP *op) {
+  return op == fold_hood_min_op || op == vfold_hood_min_op ||
+         op == fold_hood_max_op || op == vfold_hood_max_op ||
+         op == fold_hood_sum_op || op == vfold_hood_sum_op ||
+         op == fold_hood_any_op || op == fold_hood_all_op;
+}
+
+// fused folds export their only argument
+void fused_fold_hood_lift (AST_OP_CALL *ast, LIFT_DATA *data) {
+  AST* arg = ast->args->front();
+  int size = arg->type->size();
+  if (size <= 0)
+    cerror(arg, "UNDERSPECIFIED TYPE SIZE IN EXPORT");
+  data->export_len += size;
+  add_offset(ast, data->n_exports++);
+}
+
 AST *ast_op_call_lift_walk (AST_WALKER_KIND action, AST *ast_, void *arg) {
   AST_OP_CALL *ast = (AST_OP_CALL*)ast_;
   AST_OP *op = ast->op;
@@ -1072,11 +1093,16 @@ AST *ast_op_call_lift_walk (AST_WALKER_KIND action, AST *ast_, void *arg) {
     if (op == fold_hood_op || op == vfold_hood_op ||
         op == fold_hood_plus_op || op == vfold_hood_plus_op)
       fold_hood_lift(ast, data);
+    else if (is_fused_fold_hood(op))
+      fused_fold_hood_lift(ast, data);
   } else {
     if (op == map_op || op == vadd_op || op == vsub_op || op == vmul_op ||
         op == vfold_op || op == vfold_hood_op || op == vfold_hood_plus_op ||
         op == nbr_vec_op || op == hsv_op || op == vmux_op)
       map_lift(ast, data);
+    else if (op == vfold_hood_min_op || op == vfold_hood_max_op ||
+             op == vfold_hood_sum_op)
+      add_offset(ast, tup_type_len(ast->type)); // ignored by the VM
     else if (op == tup_op )
       tup_lift(ast, data);
     else if (op == feedback_op)
@@ -1430,6 +1456,11 @@ TYPE* fold_hood_plus_type_infer (AST* ast_) {
   return fun->value->ast_body->type;
 }
 
+TYPE* fused_fold_hood_type_infer (AST* ast_) {
+  AST_OP_CALL* ast = (AST_OP_CALL*)ast_;
+  return ast->args->front()->type;
+}
+
 TYPE* apply_type_infer (AST* ast_) {
   AST_OP_CALL* ast = (AST_OP_CALL*)ast_;
   ONE_FUN_TYPE* fun = (ONE_FUN_TYPE*)ast->args->front()->type;
@@ -1508,6 +1539,30 @@ void init_ops () {
   add_op_typed("ELT", ELT_OP, 0, 0, 
                new FUN_TYPE(ANYT,ANYT,NUMT,0), &elt_type_infer);
   def_op_alias("MIX", fold_hood_op);
+  fold_hood_min_op =
+    add_op_typed("FOLD-HOOD-MIN", FOLD_HOOD_MIN_OP, 1, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  vfold_hood_min_op =
+    add_op_typed("VFOLD-HOOD-MIN", VFOLD_HOOD_MIN_OP, 2, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  fold_hood_max_op =
+    add_op_typed("FOLD-HOOD-MAX", FOLD_HOOD_MAX_OP, 1, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  vfold_hood_max_op =
+    add_op_typed("VFOLD-HOOD-MAX", VFOLD_HOOD_MAX_OP, 2, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  fold_hood_sum_op =
+    add_op_typed("FOLD-HOOD-SUM", FOLD_HOOD_SUM_OP, 1, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  vfold_hood_sum_op =
+    add_op_typed("VFOLD-HOOD-SUM", VFOLD_HOOD_SUM_OP, 2, 0, 
+                 new FUN_TYPE(ANYT,ANYT,0), &fused_fold_hood_type_infer);
+  fold_hood_any_op =
+    add_op_typed("FOLD-HOOD-ANY", FOLD_HOOD_ANY_OP, 1, 0, 
+                 new FUN_TYPE(NUMT,NUMT,0), &fused_fold_hood_type_infer);
+  fold_hood_all_op =
+    add_op_typed("FOLD-HOOD-ALL", FOLD_HOOD_ALL_OP, 1, 0, 
+                 new FUN_TYPE(NUMT,NUMT,0), &fused_fold_hood_type_infer);
   add_op("DT", DT_OP, 0, 0, new FUN_TYPE(NUMT,0));
   op = add_op("MOV", MOV_OP, 0, 0, new FUN_TYPE(VEC3T,VEC3T,0));
   add_op("SPEED", SPEED_OP, 0, 0, new FUN_TYPE(NUMT,0));
@@ -2024,6 +2079,40 @@ Obj* rewrite_fold_hood_star(Obj *expr, Obj **nexprs, int *n) {
   return form;
 }
 
+// (fold-hood-plus folder (fun (e) e) expr) as a fused fold, which folds
+// without calling back for each neighbor, if the folder is the fuse
+// function of a summary; otherwise NULL
+AST* parse_fused_fold_hood (Obj *folder, Obj *expr, list<VAR*> *env) {
+  if (!symbolp(folder))
+    return NULL;
+  const char *name = sym_name(folder).c_str();
+  if (lookup_name(name, env) != NULL)
+    return NULL; // shadowed by a local
+  AST_OP *op, *vop;
+  if (!strcasecmp(name, "muxor"))
+    op = vop = fold_hood_any_op;
+  else if (!strcasecmp(name, "muxand"))
+    op = vop = fold_hood_all_op;
+  else if (lookup_name(name, globals) != NULL)
+    return NULL; // not the built-in op
+  else if (!strcasecmp(name, "min"))
+    { op = fold_hood_min_op; vop = vfold_hood_min_op; }
+  else if (!strcasecmp(name, "max"))
+    { op = fold_hood_max_op; vop = vfold_hood_max_op; }
+  else if (!strcasecmp(name, "+"))
+    { op = fold_hood_sum_op; vop = vfold_hood_sum_op; }
+  else
+    return NULL;
+  AST *arg = parse(expr, env);
+  list<AST*> *args = new list<AST*>();
+  args->push_back(arg);
+  AST_OP_CALL *ast = new AST_OP_CALL
+    ((arg->type->kind == TUP_KIND || arg->type->kind == VEC_KIND) ? vop : op,
+     args);
+  ast->type = ast->op->type_infer(ast);
+  return ast;
+}
+
 Obj* hood_folder (const char *name, List *args, Obj *merge, Obj *cmp) {
   switch (lst_len(args)) {
   case 1:
@@ -2137,6 +2226,11 @@ AST* parse_special_form (const char *name, Obj *e, List *args, list<VAR*> *env)
     Obj *expr   = lst_elt(args, 1);
     Obj *nexprs = lisp_nil;
     Obj *nexpr  = rewrite_fold_hood_star(expr, &nexprs, &n);
+    if (n == 1 && symbolp(nexpr)) { // a summary of a single nbr
+      AST *fused = parse_fused_fold_hood(folder, lst_elt((List*)nexprs, 0), env);
+      if (fused != NULL)
+        return fused;
+    }
     List *qqenv
       = qq_env("$folder", folder,
                "$nexpr",  nexpr,
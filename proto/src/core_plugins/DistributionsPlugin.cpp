@@ -145,9 +145,9 @@ GridRandom::GridRandom(Args* args, int n, Rect* volume) : Grid(n,volume) {
 }
 bool GridRandom::next_location(METERS *loc) {
   Grid::next_location(loc);
-  loc[0] += epsilon*((rand()%1000/1000.0) - 0.5);
-  loc[1] += epsilon*((rand()%1000/1000.0) - 0.5);
-  if(volume->dimensions()==3) loc[2] += epsilon*((rand()%1000/1000.0) - 0.5);
+  loc[0] += epsilon*urnd(-0.5,0.5);
+  loc[1] += epsilon*urnd(-0.5,0.5);
+  if(volume->dimensions()==3) loc[2] += epsilon*urnd(-0.5,0.5);
   return true;
 }
 
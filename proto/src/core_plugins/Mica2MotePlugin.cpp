@@ -9,6 +9,7 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #include <sstream>
 #include "config.h"
 #include "Mica2MotePlugin.h"
+#include "dumpfile.h"
 #include "visualizer.h"
 using namespace std;
 
@@ -43,31 +44,31 @@ void MoteIO::register_colors() {
 #endif
 }
 
-void MoteIO::speak_op(Machine* machine) {
+void MoteIO::speak_op(Machine* machine, const VMContext& context) {
   set_speak(machine->stack.peek().asNumber());
 }
 
-void MoteIO::light_op(Machine* machine) {
-  machine->stack.push(read_light_sensor());
+void MoteIO::light_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_light_sensor(context.device));
 }
 
-void MoteIO::sound_op(Machine* machine) {
-  machine->stack.push(read_microphone());
+void MoteIO::sound_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_microphone(context.device));
 }
 
-void MoteIO::temp_op(Machine* machine) {
-  machine->stack.push(read_temp());
+void MoteIO::temp_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_temp(context.device));
 }
 
-void MoteIO::conductive_op(Machine* machine) {
+void MoteIO::conductive_op(Machine* machine, const VMContext& context) {
   machine->stack.push(read_short());
 }
 
-void MoteIO::button_op(Machine* machine) {
-  machine->stack.push(read_button((int) machine->stack.popNumber()));
+void MoteIO::button_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_button(context.device,(int) machine->stack.popNumber()));
 }
 
-void MoteIO::slider_op(Machine* machine) {
+void MoteIO::slider_op(Machine* machine, const VMContext& context) {
   Number max  = machine->stack.popNumber();
   Number min  = machine->stack.popNumber();
   Number incr = machine->stack.popNumber();
@@ -93,17 +94,15 @@ void MoteIO::set_speak (Number period) {
   // right now, setting the speaker does *nothing*, as in the old sim
 }
 
-extern Machine * machine;
-
-Number MoteIO::read_light_sensor()
-{ return ((DeviceMoteIO*)device->layers[id])->light; }
-Number MoteIO::read_microphone ()
-{ return ((DeviceMoteIO*)device->layers[id])->sound; }
-Number MoteIO::read_temp ()
-{ return ((DeviceMoteIO*)device->layers[id])->temperature; }
+Number MoteIO::read_light_sensor(Device* d)
+{ return ((DeviceMoteIO*)d->layers[id])->light; }
+Number MoteIO::read_microphone (Device* d)
+{ return ((DeviceMoteIO*)d->layers[id])->sound; }
+Number MoteIO::read_temp (Device* d)
+{ return ((DeviceMoteIO*)d->layers[id])->temperature; }
 Number MoteIO::read_short () { return 0; }
-Number MoteIO::read_button (uint8_t n) {
-  return ((DeviceMoteIO*)device->layers[id])->button;
+Number MoteIO::read_button (Device* d, uint8_t n) {
+  return ((DeviceMoteIO*)d->layers[id])->button;
 }
 Number MoteIO::read_slider (uint8_t ikey, uint8_t dkey, Number init, 
 			     Number incr, Number min, Number max) {
@@ -120,6 +119,10 @@ void DeviceMoteIO::dump_state(FILE* out, int verbosity) {
   }
 }
 
+void DeviceMoteIO::dump_values(DumpWriter* out) {
+  out->put(sound,2); out->put(temperature,2); out->put(button,0);
+}
+
 // individual device implementations
 bool DeviceMoteIO::handle_key(KeyEvent* key) {
   // I think that the slider is supposed to consume keys too
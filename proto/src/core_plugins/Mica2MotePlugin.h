@@ -25,21 +25,21 @@ class MoteIO : public Layer, public HardwarePatch {
   static Color* BUTTON_COLOR;
   virtual void register_colors();
  private:
-  void speak_op(Machine* machine);
-  void light_op(Machine* machine);
-  void sound_op(Machine* machine);
-  void temp_op(Machine* machine);
-  void conductive_op(Machine* machine);
-  void button_op(Machine* machine);
-  void slider_op(Machine* machine);
+  void speak_op(Machine* machine, const VMContext& context);
+  void light_op(Machine* machine, const VMContext& context);
+  void sound_op(Machine* machine, const VMContext& context);
+  void temp_op(Machine* machine, const VMContext& context);
+  void conductive_op(Machine* machine, const VMContext& context);
+  void button_op(Machine* machine, const VMContext& context);
+  void slider_op(Machine* machine, const VMContext& context);
 
   // hardware emulation
   void set_speak (Number period);
-  Number read_light_sensor();
-  Number read_microphone ();
-  Number read_temp ();
+  Number read_light_sensor(Device* d);
+  Number read_microphone (Device* d);
+  Number read_temp (Device* d);
   Number read_short ();       // test for conductivity
-  Number read_button (uint8_t n);
+  Number read_button (Device* d, uint8_t n);
   Number read_slider (uint8_t ikey, uint8_t dkey, Number init, // frob knob
 		       Number incr, Number min, Number max);
 };
@@ -55,6 +55,7 @@ class DeviceMoteIO : public DeviceLayer {
   bool handle_key(KeyEvent* event);
   void copy_state(DeviceLayer* src) {} // to be called during cloning
   void dump_state(FILE* out, int verbosity); // print state to file
+  void dump_values(DumpWriter* out); // the same, for binary dumps
 };
 
 // Plugin class
@@ -7,6 +7,7 @@ the GNU General Public License, with a linking exception, as described
 in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "SimpleLifeCyclePlugin.h"
+#include "dumpfile.h"
 
 #define DIE_OP "die scalar boolean"
 #define CLONE_OP "clone scalar boolean"
@@ -24,23 +25,23 @@ SimpleLifeCycle::SimpleLifeCycle(Args* args, SpatialComputer* p) : Layer(p) {
   parent->hardware.registerOpcode(new OpHandler<SimpleLifeCycle>(this, &SimpleLifeCycle::clone_op, CLONE_OP));
 }
 
-void SimpleLifeCycle::die_op(Machine* machine) {
-  die(machine->stack.peek().asNumber());
+void SimpleLifeCycle::die_op(Machine* machine, const VMContext& context) {
+  die(context.device,machine->stack.peek().asNumber());
 }
 
-void SimpleLifeCycle::clone_op(Machine* machine) {
-  clone_machine(machine->stack.peek().asNumber());
+void SimpleLifeCycle::clone_op(Machine* machine, const VMContext& context) {
+  clone_machine(context.device,machine->stack.peek().asNumber());
 }
 
 void SimpleLifeCycle::add_device(Device* d) {
   d->layers[id] = new SimpleLifeCycleDevice(this,d);
 }
 
-void SimpleLifeCycle::die (Number val) {
-  if(val != 0) parent->death_q.push(device->backptr);
+void SimpleLifeCycle::die (Device* d, Number val) {
+  if(val != 0) parent->death_q.push(d->backptr);
 }
-void SimpleLifeCycle::clone_machine (Number val) {
-  if(val != 0) ((SimpleLifeCycleDevice*)device->layers[id])->clone_cmd=true;
+void SimpleLifeCycle::clone_machine (Device* d, Number val) {
+  if(val != 0) ((SimpleLifeCycleDevice*)d->layers[id])->clone_cmd=true;
 }
 
 void SimpleLifeCycle::dump_header(FILE* out) {
@@ -61,12 +62,16 @@ void SimpleLifeCycleDevice::dump_state(FILE* out, int verbosity) {
   }
 }
 
+void SimpleLifeCycleDevice::dump_values(DumpWriter* out) {
+  out->put(clone_time,2);
+}
+
 // choose new position w. random polar coordinates
 void SimpleLifeCycleDevice::clone_me() {
   const flo* p = container->body->position();
   flo dp = 2*container->body->display_radius();
-  flo theta = urnd(0,2*M_PI);
-  flo phi = (parent->parent->is_3d() ? urnd(0,2*M_PI) : 0);
+  flo theta = container->rng.urnd(0,2*M_PI);
+  flo phi = (parent->parent->is_3d() ? container->rng.urnd(0,2*M_PI) : 0);
   METERS cp[3];
   cp[0] = p[0] + dp*cos(phi)*cos(theta);
   cp[1] = p[1] + dp*cos(phi)*sin(theta);
@@ -75,14 +80,12 @@ void SimpleLifeCycleDevice::clone_me() {
   parent->parent->clone_q.push(cr);
 }
 
-extern Machine * machine;
-
 void SimpleLifeCycleDevice::update() {
   if(clone_cmd) {
     if(clone_time<0) { 
-      clone_time = (machine->startTime() + parent->clone_delay); 
+      clone_time = (container->vm->startTime() + parent->clone_delay); 
     }
-    if(machine->startTime() >= clone_time) {
+    if(container->vm->startTime() >= clone_time) {
       clone_cmd=false; // reset clone_cmd
       clone_time=-1;   // reset clone_time
       clone_me();
@@ -24,10 +24,10 @@ class SimpleLifeCycle : public Layer, public HardwarePatch {
   // hardware patch functions
   void dump_header(FILE* out); // list log-file fields
  private:
-  void die_op(Machine* machine);
-  void clone_op(Machine* machine);
-  void die (Number val);
-  void clone_machine (Number val);
+  void die_op(Machine* machine, const VMContext& context);
+  void clone_op(Machine* machine, const VMContext& context);
+  void die (Device* d, Number val);
+  void clone_machine (Device* d, Number val);
 };
 
 class SimpleLifeCycleDevice : public DeviceLayer {
@@ -41,6 +41,7 @@ class SimpleLifeCycleDevice : public DeviceLayer {
   void clone_me();
   void copy_state(DeviceLayer* src) {} // to be called during cloning
   void dump_state(FILE* out, int verbosity); // print state to file
+  void dump_values(DumpWriter* out); // the same, for binary dumps
 };
 
 /*************** Plugin Interface ***************/
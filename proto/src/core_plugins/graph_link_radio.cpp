@@ -136,28 +136,25 @@ void GraphLinkRadio::device_moved(Device* d) {
  *  HARDWARE EMULATION                                                       *
  *****************************************************************************/
 // No real range, just hops (= 1 "unit")
-Number GraphLinkRadio::read_radio_range () { return 1; }
+Number GraphLinkRadio::read_radio_range (const VMContext& c) { return 1; }
 
-int GraphLinkRadio::radio_send_export (uint8_t version, Array<Data> const & data) {
-  if(!try_tx())  // transmission failure
+int GraphLinkRadio::radio_send_export (const VMContext& c, uint8_t version,
+                                       Imports const & data) {
+  if(!try_tx(c.device))  // transmission failure
     return 0;
 
   // cache data
-  int src_id = device->uid;
+  int src_id = c.device->uid;
   // walk neighbors
-  GraphLinkDevice* udd = (GraphLinkDevice*)device->layers[id];
+  GraphLinkDevice* udd = (GraphLinkDevice*)c.device->layers[id];
   for(int i=0;i<udd->neighbors.max_id();i++) {
     GLNbrRecord* nr = (GLNbrRecord*)udd->neighbors.get(i);
-    if(nr && try_rx()) { // non-failing receive
+    if(nr && try_rx(nr->nbr->container,c.device)) { // non-failing receive
       // hardware->set_vm_context(nr->nbr->container);
       /*radio_receive_export(src_id, version, timeout, -nr->dp[0], -nr->dp[1],
                            -nr->dp[2], n, buf);*/
       Neighbour & nbr = nr->nbr->container->vm->hood[src_id];
-      for(Size i = 0; i < data.size(); i++) nbr.imports[i] = data[i];
-      nbr.x = -nr->dp[0];
-      nbr.y = -nr->dp[1];
-      nbr.z = -nr->dp[2];
-      nbr.data_age = 0;
+      nbr.receive(data,-nr->dp[0],-nr->dp[1],-nr->dp[2]);
     }
   }
   // hardware->set_vm_context(udd->container); // restore context
@@ -26,8 +26,9 @@ class GraphLinkRadio : public RadioSim {
   void device_moved(Device* d);
 
   // hardware emulation
-  Number read_radio_range ();
-  int radio_send_export (uint8_t version, Array<Data> const & data);
+  Number read_radio_range (const VMContext& c);
+  int radio_send_export (const VMContext& c, uint8_t version,
+                         Imports const & data);
   int radio_send_script_pkt (uint8_t version, uint16_t n, 
 			     uint8_t pkt_num, uint8_t *script);
   int radio_send_digest (uint8_t version, uint16_t script_len, 
@@ -56,6 +57,7 @@ class GraphLinkDevice : public DeviceLayer {
   ~GraphLinkDevice();
   void visualize();
   void copy_state(DeviceLayer* src) {} // to be called during cloning
+  void dump_values(DumpWriter* out) {} // nothing is dumped
 };
 
 #endif // __GRAPHLINKRADIO__
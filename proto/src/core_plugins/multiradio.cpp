@@ -66,11 +66,13 @@ void MultiRadio::add_device(Device *d) {}
 
 void MultiRadio::device_moved(Device *d) {}
 
-int MultiRadio::radio_send_export (uint8_t version, Array<Data> const & data){
+int MultiRadio::radio_send_export (const VMContext& c, uint8_t version,
+                                   Imports const & data){
   vector<RadioSim*>::iterator it;
   for(it = radios.begin(); it != radios.end(); it++) {
-    (*it)->radio_send_export(version, data);
+    (*it)->radio_send_export(c, version, data);
   }
+  return 1;
 }
 
 int MultiRadio::radio_send_script_pkt (uint8_t version, uint16_t n,
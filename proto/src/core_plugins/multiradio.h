@@ -24,7 +24,8 @@ public:
   void add_device(Device* d);
   void device_moved(Device *d);
 
-  int radio_send_export (uint8_t version, Array<Data> const & n);
+  int radio_send_export (const VMContext& c, uint8_t version,
+                         Imports const & n);
   int radio_send_script_pkt (uint8_t version, uint16_t n, 
                              uint8_t pkt_num, uint8_t *script);
   int radio_send_digest (uint8_t version, uint16_t script_len, 
@@ -26,10 +26,10 @@ void StopWhen::add_device(Device *d) {
   n_devices++;
 }
 
-void StopWhen::stop_op(Machine* machine) {
+void StopWhen::stop_op(Machine* machine, const VMContext& context) {
   Number val = machine->stack.peek().asNumber();
   if(val!=0) {
-    probed.insert(device);
+    probed.insert(context.device);
     if(probed.size() > n_devices * stop_pct
        || (stop_pct == 1.0 && probed.size() == n_devices)) {
       post("Stopping simulation at t=%f\n", parent->sim_time);
@@ -55,7 +55,7 @@ void WormHoleRadio::attach_wormholes() {
 WormHoleRadioDevice *WormHoleRadio::random_device() {
   Device *d;
   do {
-    int i = rand() % parent->devices.max_id();
+    int i = rng.next() % parent->devices.max_id();
     d = (Device*)parent->devices.get(i);
   } while(d == NULL);
   return (WormHoleRadioDevice*)(d->layers[id]);
@@ -66,34 +66,30 @@ void WormHoleRadio::connect_devices(WormHoleRadioDevice *d1, WormHoleRadioDevice
   d2->nbrs.insert(d1);
 }
 
-Number WormHoleRadio::read_radio_range () {
+Number WormHoleRadio::read_radio_range (const VMContext& c) {
   /* FIXME There isn't really a reasonable value to return here.*/
   return 10;
 }
 
-int WormHoleRadio::radio_send_export (uint8_t version, Array<Data> const & data){
-  if(!try_tx())  // transmission failure
+int WormHoleRadio::radio_send_export (const VMContext& c, uint8_t version,
+                                      Imports const & data){
+  if(!try_tx(c.device))  // transmission failure
     return 0;
 
-  int src_id = device->uid;
-  const flo *me = device->body->position();
-  WormHoleRadioDevice *dev = (WormHoleRadioDevice*)device->layers[id];
+  int src_id = c.device->uid;
+  const flo *me = c.device->body->position();
+  WormHoleRadioDevice *dev = (WormHoleRadioDevice*)c.device->layers[id];
   for(set<WormHoleRadioDevice*>::iterator it = dev->nbrs.begin();
       it != dev->nbrs.end(); it++) {
     WormHoleRadioDevice *o = *it;
-    if(try_rx()) {
+    if(try_rx(o->container,c.device)) {
       const flo *them = o->container->body->position();
 
       Neighbour & nbr = o->container->vm->hood[src_id];
-      nbr.x = me[0]-them[0];
-      nbr.y = me[1]-them[1];
-      nbr.z = me[2]-them[2];
-      nbr.imports = data;
-      nbr.data_age = 0;
+      nbr.receive(data,me[0]-them[0],me[1]-them[1],me[2]-them[2]);
     }
   }
-
-  hardware->set_vm_context(dev->container);
+  return 1;
 }
 
 int WormHoleRadio::radio_send_script_pkt (uint8_t version, uint16_t n,
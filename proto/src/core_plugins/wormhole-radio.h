@@ -29,8 +29,9 @@ public:
   bool handle_key(KeyEvent* key);
   void add_device(Device* d);
 
-  Number read_radio_range ();
-  int radio_send_export (uint8_t version, Array<Data> const &);
+  Number read_radio_range (const VMContext& c);
+  int radio_send_export (const VMContext& c, uint8_t version,
+                         Imports const &);
   int radio_send_script_pkt (uint8_t version, uint16_t n, 
                              uint8_t pkt_num, uint8_t *script);
   int radio_send_digest (uint8_t version, uint16_t script_len, 
@@ -56,6 +57,7 @@ public:
   void visualize();
 
   void copy_state(DeviceLayer* src) {}
+  void dump_values(DumpWriter* out) {} // nothing is dumped
 };
 
 #endif
@@ -30,9 +30,9 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 using namespace std;
 
 // Dummy declarations to fill in simulator names required to dlopen plugins.
-Device *device = 0;
-SimulatedHardware *hardware = 0;
-Machine *machine = 0;
+THREAD_LOCAL Device *device = 0;
+THREAD_LOCAL SimulatedHardware *hardware = 0;
+THREAD_LOCAL Machine *machine = 0;
 void *palette = 0;
 
 // Touch a neocompiler element to ensure it gets linked in.
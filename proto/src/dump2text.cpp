@@ -0,0 +1,51 @@
+/* Converts binary dumps back to text
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// usage: dump2text FILE.pdump [DIR]
+// Writes each frame of a -dump-binary file as the .log file the run
+// would have written without -dump-binary: {STEM}{TIME}.log in DIR
+// (default, the directory holding FILE), where STEM is FILE's name
+// without ".pdump".  If DIR is "-", all frames are printed in sequence
+// to standard output, like the log of a --test-mode run.
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "utils.h"
+#include "dumpfile.h"
+
+int main(int argc, char *argv[]) {
+  if(argc<2 || argc>3) uerror("usage: dump2text FILE.pdump [DIR]");
+  FILE* in = fopen(argv[1],"rb");
+  if(in==NULL) uerror("Unable to open dump file '%s'",argv[1]);
+  std::string path(argv[1]), dir, stem;
+  size_t slash = path.rfind('/');
+  dir = (slash==std::string::npos) ? "." : path.substr(0,slash);
+  stem = (slash==std::string::npos) ? path : path.substr(slash+1);
+  if(stem.size()>6 && stem.substr(stem.size()-6)==".pdump")
+    stem.resize(stem.size()-6);
+  if(argc>2) dir = argv[2];
+  bool to_stdout = (dir=="-");
+
+  DumpReader reader(in);
+  int frames=0;
+  while(reader.read_frame()) {
+    if(to_stdout) { reader.write_text(stdout); frames++; continue; }
+    char buf[1000];
+    snprintf(buf,sizeof(buf),"%s/%s%.2f.log",dir.c_str(),stem.c_str(),
+             reader.time);
+    FILE* out = fopen(buf,"w");
+    if(out==NULL) uerror("Unable to open dump file '%s'",buf);
+    reader.write_text(out);
+    fclose(out); frames++;
+  }
+  fclose(in);
+  if(!to_stdout) post("Wrote %d frames\n",frames);
+  return 0;
+}
@@ -210,3 +210,18 @@ ProtoPluginManager::get_compiler_plugin(string type, string name, Args *args,
   if (lib == NULL) return NULL;
   return lib->get_compiler_plugin(type, name, args, c);
 }
+
+void *
+ProtoPluginManager::get_library_symbol(string libfile, string symbol)
+{
+  ensure_initialized(NULL);
+  lt_dlhandle handle = lt_dlopen(libfile.c_str());
+  if (handle == NULL) {
+    cerr << "Could not load library " + libfile + "\n";
+    return NULL;
+  }
+  void *fp = lt_dlsym(handle, symbol.c_str());
+  if (fp == NULL)
+    cerr << "Could not get " + symbol + " from " + libfile + "\n";
+  return fp;
+}
@@ -44,6 +44,10 @@ class ProtoPluginManager {
   void *get_compiler_plugin(std::string type, std::string name, Args *args,
       Compiler *c);
 
+  /// Used to load libraries that are not plugins, like -native programs:
+  /// returns the named symbol, or null (with a message) on failure
+  void *get_library_symbol(std::string libfile, std::string symbol);
+
   /// Accessor for get_plugin_inventory
   const PluginInventory *get_plugin_inventory();
 
@@ -0,0 +1,44 @@
+/* Interface to the native code that proto -native compiles programs to
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#ifndef PROTO_SHARED_NATIVE_H
+#define PROTO_SHARED_NATIVE_H
+
+#include <stdint.h>
+
+// A library made by the NativeEmitter exports one ProtoNativeProgram,
+// named PROTO_NATIVE_SYMBOL.  Each of its blocks stands in for a straight
+// run of instructions in the script it was compiled with: given inputs
+// that are all numbers, it computes the numbers those instructions would
+// leave on the stack and environment.  The generated source declares its
+// own copy of these structures, so bump PROTO_NATIVE_VERSION with them.
+
+#define PROTO_NATIVE_VERSION 1
+#define PROTO_NATIVE_SYMBOL "proto_native_program"
+#define PROTO_NATIVE_MAX_IO 64 // most inputs, or outputs, of any block
+
+// Where an input is read from: the kind is in its top 4 bits, and the
+// rest is the index (from the top, for the stack and environment)
+enum { PROTO_NATIVE_STACK=0, PROTO_NATIVE_ENV=1, PROTO_NATIVE_GLOBAL=2 };
+#define PROTO_NATIVE_KIND(input) ((input)>>28)
+#define PROTO_NATIVE_INDEX(input) ((input)&0x0FFFFFFF)
+
+struct ProtoNativeBlock {
+  uint32_t start, end;   // script offsets of its first instruction & the next
+  uint16_t n_in, n_pop;  // inputs, and how many of them are stack pops
+  uint16_t n_out, n_let; // values it pushes on the stack, then environment
+  const uint32_t* inputs;
+  void (*run)(const float* in, float* out);
+};
+
+struct ProtoNativeProgram {
+  uint32_t version, script_size, n_blocks;
+  const ProtoNativeBlock* blocks; // in script order
+};
+
+#endif  // PROTO_SHARED_NATIVE_H
@@ -22,13 +22,29 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 using namespace std;
 
+#ifndef THREAD_LOCAL
+#define THREAD_LOCAL
+#endif
+
+static THREAD_LOCAL RandomStream *current_stream = NULL;
+
 flo
 urnd(flo min, flo max)
 {
+  if (current_stream)
+    return current_stream->urnd(min, max);
   // FIXME: What a crock!
   return min + (((max - min) * rand()) / RAND_MAX);
 }
 
+RandomStream *
+RandomStream::use(RandomStream *s)
+{
+  RandomStream *previous = current_stream;
+  current_stream = s;
+  return previous;
+}
+
 /*****************************************************************************
  *  NOTIFICATION FUNCTIONS                                                   *
  *****************************************************************************/
@@ -115,7 +131,6 @@ Args::remove(size_t i)
 // ARG_SAFE is used to check if two different things modules request the
 // same argument
 #define ARG_SAFE true
-static vector<string> switch_rec;  // remember a set of switch arguments
 
 bool
 Args::extract_switch(const char *sw, bool warn)
@@ -123,13 +138,13 @@ Args::extract_switch(const char *sw, bool warn)
   if (ARG_SAFE && warn) {
     string s = sw;
     // Warns the user if a switch is overloaded.
-    for (size_t i = 0; i < switch_rec.size(); i++)
-      if (s == switch_rec[i]) {
+    for (size_t i = 0; i < switch_rec_.size(); i++)
+      if (s == switch_rec_[i]) {
 	debug("WARNING: Switch '%s' used more than once.\n", sw);
         break;
       }
 
-    switch_rec.push_back(s);
+    switch_rec_.push_back(s);
   }
 
   if (!find_switch(sw))
@@ -67,9 +67,74 @@ struct Rect3 : public Rect {
   virtual int dimensions() const { return 3; }
 };
 
-// uniform random numbers
+// uniform random numbers, from the stream in use by this thread (see below)
 flo urnd(flo min, flo max);
 
+// A RandomStream is an independent pseudo-random sequence, so that
+// several simulations in one process, and the devices and layers in a
+// simulation, don't share their randomness.  It is counter-based: the
+// i-th value is a hash (SplitMix64) of the stream's key and i, so values
+// can be drawn in bulk, and substreams are just other keys.
+// urnd() draws from the stream that the calling thread is using, or
+// from the C library rand() if there is none.
+class RandomStream {
+ public:
+  explicit RandomStream(unsigned long long seed = 0) { this->seed(seed); }
+
+  // Restart the sequence from a seed.
+  void seed(unsigned long long seed) { key_ = mix(seed); counter_ = 0; }
+
+  // An independent stream, numbered id, derived from this one's key.
+  RandomStream substream(unsigned long long id) const
+  { return RandomStream(key_ ^ mix(id + 0x9e3779b97f4a7c15ULL)); }
+
+  // Next raw value of the sequence.
+  unsigned long long next() { return value(counter_++); }
+
+  // Uniform over [min, max).
+  flo urnd(flo min, flo max) { return min + (max - min) * unit(next()); }
+
+  // The i-th value of urnd(min, max), without moving along the sequence.
+  flo urnd_at(unsigned long long i, flo min, flo max) const
+  { return min + (max - min) * unit(value(i)); }
+
+  // Fill out[0..n-1] with the next n values of urnd(min, max).
+  void fill(flo *out, int n, flo min, flo max) {
+    unsigned long long base = counter_;
+    for (int i = 0; i < n; i++)
+      out[i] = min + (max - min) * unit(value(base + i));
+    counter_ += n;
+  }
+
+  // Make s the stream of the calling thread (NULL for rand()); returns the
+  // stream that was in use before, so it can be put back afterwards.
+  static RandomStream *use(RandomStream *s);
+
+  // Uses a stream for as long as the Scope exists.
+  class Scope {
+   public:
+    explicit Scope(RandomStream *s) : outer_(use(s)) {}
+    ~Scope() { use(outer_); }
+   private:
+    RandomStream *outer_;
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+  };
+
+ private:
+  unsigned long long key_, counter_;
+
+  static unsigned long long mix(unsigned long long z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+  unsigned long long value(unsigned long long i) const
+  { return mix(key_ + (i + 1) * 0x9e3779b97f4a7c15ULL); }
+  // top 24 bits, as a flo in [0,1)
+  static flo unit(unsigned long long v)
+  { return (flo)(v >> 40) * (1.0f / 16777216.0f); }
+};
+
 /*****************************************************************************
  *  SMALL MISC EXTENSIONS                                                    *
  *****************************************************************************/
@@ -181,6 +246,9 @@ class Args {
   // Stack of saved pointers.
   std::vector<int> save_ptrs_;
 
+  // Switches extracted so far, to warn about ones used more than once.
+  std::vector<std::string> switch_rec_;
+
   // Read args from .[appname] and ~/.[appname] files.
   void add_defaults();
   void parse_argstream(std::istream *s);
@@ -29,6 +29,7 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #endif
 #include "visualizer.h"
 #include "sim-instructions.h"
+#include "workerpool.h"
 
 map<string,uint8_t> OPCODE_MAP = create_opcode_map();
 
@@ -44,6 +45,7 @@ Visualizer* vis = NULL;
 
 bool test_mode = false;
 char dump_name[1000]; // for controlling all outputs when test_mode is true
+char binary_dump_name[1000]; // where test_mode dumps go with -dump-binary
 
 /*****************************************************************************
  *  TIMING AND UPDATE LOOP                                                   *
@@ -64,6 +66,8 @@ bool evolution_lagging = false; // is the simulator keeping up or not?
 double fps=1.0; // frames-per-second measurement
 bool show_time=false;
 string opcode_file=""; // file to look for opcodes
+bool show_memory_stats=false; // report VM allocations on shutdown
+vector<string> sweep_specs; // arguments of each point of a sweep
 
 
 // evolve all top-level items
@@ -397,15 +401,146 @@ void special_handler( int key_id, int x, int y ) {
 #endif // WANT_GLUT
 }
 
+/*****************************************************************************
+ *  PARAMETER SWEEPS                                                         *
+ *****************************************************************************/
+// A sweep runs one program on many SpatialComputers in the same process,
+// compiling it only once.  Each point of the sweep is a set of arguments
+// that override the command line for its computer, e.g. "-n 500 -r 10".
+// Points get their own random seed (-seed, else the main seed + the point
+// number) and dump files (-dump-stem, else STEM-i-), and are run in
+// parallel on -threads N threads.  The compiler takes its arguments from
+// those left over by the first point.
+struct SweepPoint {
+  vector<string> words;       // the point's own arguments, which argv shares
+  vector<char*> argv;         // command line of this point's computer
+  Args* args;
+  SpatialComputer* computer;
+  FILE* dump;                 // in test mode, merged into the log at the end
+};
+vector<SweepPoint*> sweep;
+
+// read the points of a sweep file: one per line, '#' starts a comment
+void read_sweep_file(const char* file) {
+  ifstream in(file);
+  if(!in.is_open()) uerror("Unable to open sweep file '%s'", file);
+  string line;
+  while(getline(in,line)) {
+    if(line.find('#') != string::npos) line.erase(line.find('#'));
+    if(line.find_first_not_of(" \t\r") != string::npos)
+      sweep_specs.push_back(line);
+  }
+}
+
+void make_sweep_point(Args* args, const char* stem, unsigned int seed) {
+  int i = sweep.size();
+  SweepPoint* p = new SweepPoint(); sweep.push_back(p);
+  // the point's own arguments come first, so they are found first
+  const string& spec = sweep_specs[i];
+  for(size_t a=0; (a=spec.find_first_not_of(" \t\r",a)) != string::npos; ) {
+    size_t b = spec.find_first_of(" \t\r",a);
+    p->words.push_back(spec.substr(a,b-a)); a = b;
+  }
+  char point[16]; sprintf(point,"-%d-",i);
+  p->words.push_back("-dump-stem"); p->words.push_back(stem+string(point));
+  p->argv.push_back(args->argv[0]);
+  for(size_t j=0;j<p->words.size();j++)
+    p->argv.push_back((char*)p->words[j].c_str());
+  for(int j=1;j<args->argc;j++) p->argv.push_back(args->argv[j]);
+  p->args = new Args(p->argv.size(),&p->argv[0]);
+  // seeded like a lone run with this -seed, so the two give the same results
+  if(p->args->extract_switch("-seed")) seed = p->args->pop_number();
+  srand(seed);
+  p->computer = new SpatialComputer(p->args,!test_mode,seed);
+  p->dump = NULL;
+  if(test_mode) p->computer->dump_file = p->dump = tmpfile();
+}
+
+// advance a point the same way idle() advances a lone computer
+void run_sweep_point(void* context, int i) {
+  SpatialComputer* c = sweep[i]->computer;
+  double t = 0.0;
+  while(t<=stop_time) { t+=step_size; c->evolve(t); }
+}
+
+void make_compiler(Args* args, SpatialComputer* c);
+void load_native(SpatialComputer** computers, int n, uint8_t* s, int len);
+uint8_t* read_script(string file, int *len);
+void run_sweep(Args* args, unsigned int seed) {
+  if(stop_time==INFINITY)
+    uerror("Sweeps must set an end time with -stop-after N");
+  int n_threads = args->extract_switch("-threads") ? args->pop_int() : 1;
+  const char* stem =
+    args->extract_switch("-dump-stem") ? args->pop_next() : "dump";
+  for(size_t i=0;i<sweep_specs.size();i++) make_sweep_point(args,stem,seed+i);
+
+  int len = -1; uint8_t* s = NULL;
+  if(opcode_file != "") {
+    s = read_script(opcode_file,&len);
+    if(len <= 0 || s == NULL)
+      uerror("Problem loading opcode file: %s", opcode_file.c_str());
+  } else {
+    // compile with what is left once the first computer took its arguments
+    Args* first = sweep[0]->args;
+    make_compiler(first,sweep[0]->computer);
+    if(first->argc==1) uerror("No program specified: all arguments consumed.");
+    s = compiler->compile(first->argv[first->argc-1],&len);
+  }
+  vector<SpatialComputer*> computers;
+  for(size_t i=0;i<sweep.size();i++) {
+    sweep[i]->computer->load_script(s,len);
+    computers.push_back(sweep[i]->computer);
+  }
+  if(compiler) load_native(&computers[0],computers.size(),s,len);
+  if(test_mode) delete cpout;
+
+  WorkerPool pool(n_threads); // of one thread if built without --enable-threads
+  post("Running %d sweep points on %d threads\n",(int)sweep.size(),pool.size());
+  double start = get_real_secs();
+  pool.run(run_sweep_point,NULL,sweep.size());
+  post("Sweep finished in %.2f seconds\n",get_real_secs()-start);
+
+  if(test_mode) { // gather the dumps into the log, in point order
+    // (binary dump files can simply be concatenated)
+    FILE* log = sweep[0]->computer->is_dump_binary ?
+      fopen(binary_dump_name,"wb") : fopen(dump_name,"a");
+    for(size_t i=0;i<sweep.size();i++) {
+      char buf[4096]; size_t n;
+      rewind(sweep[i]->dump);
+      while((n = fread(buf,1,sizeof(buf),sweep[i]->dump)) > 0)
+        fwrite(buf,1,n,log);
+      fclose(sweep[i]->dump); sweep[i]->computer->dump_file = NULL;
+    }
+    fclose(log);
+  }
+  shutdown_app();
+}
+
 /*****************************************************************************
  *  STARTING AND STOPPING APPLICATION                                        *
  *****************************************************************************/
 // destroy in the opposite order from creation
 void shutdown_app() {
+  if(show_memory_stats) {
+#ifdef MEMORY_STATISTICS
+    MemoryStatistics &m = MemoryStatistics::get();
+    post("VM memory: %lu allocations, %lu from the heap, %lu device rounds",
+         (unsigned long)m.allocations, (unsigned long)m.heap_allocations,
+         (unsigned long)m.rounds);
+    if(m.rounds)
+      post(" (%.2f heap allocations per device round)",
+           (double)m.heap_allocations/m.rounds);
+    post("\n");
+#else
+    post("VM memory: not counted (configure with --enable-memory-stats)\n");
+#endif
+  }
 #ifdef WANT_GLUT
   if(vis) delete vis;
 #endif // WANT_GLUT
   delete computer;
+  for(size_t i=0;i<sweep.size();i++)
+    { delete sweep[i]->computer; delete sweep[i]->args; delete sweep[i]; }
   delete compiler;
   exit(0);
 }
@@ -448,6 +583,12 @@ void process_app_args(Args *args) {
     last_inflection_real=get_real_secs(); // need to know when it starts
   }
   show_time = args->extract_switch("-T");
+  // report how much the VM allocates when the simulator shuts down
+  show_memory_stats = args->extract_switch("-memory-stats");
+  // run many variants of the program at once?
+  while(args->extract_switch("-sweep",false)) read_sweep_file(args->pop_next());
+  while(args->extract_switch("-sweep-point",false))
+    sweep_specs.push_back(args->pop_next());
   // set the ratio between simulated and real time
   if(args->extract_switch("-ratio")) time_ratio = args->pop_number();
   // minimum amount of time to advance in each simulation step
@@ -469,6 +610,7 @@ void process_app_args(Args *args) {
       //ignore
     }
     sprintf(dump_name,"%s/%s.log",dump_dir,dump_stem);
+    sprintf(binary_dump_name,"%s/%s.pdump",dump_dir,dump_stem);
     cperr = cpout = new ofstream(dump_name); // begin by making compiler output
   }
 }
@@ -527,6 +669,34 @@ uint8_t* read_script(string file, int *len) {
    return ret;
 }
 
+// set up the compiler, with the defops of the computer it compiles for
+void make_compiler(Args* args, SpatialComputer* c) {
+#if USE_NEOCOMPILER
+  compiler = new NeoCompiler(args);  // first the compiler
+  if(args->extract_switch("-native"))
+    compiler->emitter = new NativeEmitter(compiler,args);
+  else
+    compiler->emitter = new ProtoKernelEmitter(compiler,args);
+#else
+  compiler = new PaleoCompiler(args);  // first the compiler
+  if(args->extract_switch("-native"))
+    post("WARNING: -native needs the neocompiler; running bytecode only\n");
+#endif
+  string defops;
+  c->appendDefops(defops);
+  compiler->setDefops(defops);
+}
+
+// hand any native code compiled along with script s to the computers
+void load_native(SpatialComputer** computers, int n, uint8_t* s, int len) {
+#if USE_NEOCOMPILER
+  NativeEmitter* e = dynamic_cast<NativeEmitter*>(compiler->emitter);
+  if(e==NULL || e->library.empty()) return;
+  for(int i=0;i<n;i++) computers[i]->load_native(e->library.c_str(),s,len);
+  e->discard_library(); // it stays loaded
+#endif
+}
+
 int main (int argc, char *argv[]) {
   post("PROTO v%s%s (%s) (Developed by MIT Space-Time Programming Group 2005-2008)\n",
       PROTO_VERSION,
@@ -547,6 +717,12 @@ int main (int argc, char *argv[]) {
 
   process_app_args(args);
   bool headless = args->extract_switch("-headless") || DEFAULT_HEADLESS;
+  if(!sweep_specs.empty()) {
+#ifdef WANT_GLUT
+    palette = Palette::default_palette;
+#endif // WANT_GLUT
+    run_sweep(args,seed); // sweeps are always headless
+  }
   if(!headless) {
     vis = new Visualizer(args); // start visualizer
   } else {
@@ -555,7 +731,7 @@ int main (int argc, char *argv[]) {
 #endif // WANT_GLUT
   }
 
-  computer = new SpatialComputer(args,!test_mode);
+  computer = new SpatialComputer(args,!test_mode,seed);
 
   if(opcode_file != "") {
      post("reading opcodes from: %s\n", opcode_file.c_str());
@@ -576,15 +752,7 @@ int main (int argc, char *argv[]) {
      }
   } else {
      // use a compiler
-#if USE_NEOCOMPILER
-     compiler = new NeoCompiler(args);  // first the compiler
-     compiler->emitter = new ProtoKernelEmitter(compiler,args);
-#else
-     compiler = new PaleoCompiler(args);  // first the compiler
-#endif
-     string defops;
-     computer->appendDefops(defops);
-     compiler->setDefops(defops);
+     make_compiler(args,computer);
      if(!headless) {
         vis->set_bounds(computer->vis_volume); // connect to computer
         register_app_colors();
@@ -596,12 +764,14 @@ int main (int argc, char *argv[]) {
      } else {
        uint8_t* s = compiler->compile(args->argv[args->argc-1],&len);
        computer->load_script(s,len);
+       load_native(&computer,1,s,len);
      }
   }
   // if in test mode, swap the C++ file for a C file for the SpatialComputer
   if(test_mode) {
     delete cpout;
-    computer->dump_file = fopen(dump_name,"a");
+    computer->dump_file = computer->is_dump_binary ?
+      fopen(binary_dump_name,"wb") : fopen(dump_name,"a");
   }
   
   // Overlay palettes, if needed
@@ -48,9 +48,11 @@ DeviceTimer* FixedIntervalTime::next_timer(SECONDS* start_lag) {
     new FixedTimer(max(static_cast<flo>(0), p), max(static_cast<flo>(0), ip));
 }
 
-Number FixedIntervalTime::set_dt (Number dt) {
-	//TODO/Delft: Let the VM scheduler handle this instead.
-  ((FixedTimer*)device->timer)->set_internal_dt(dt);
+// Changes the rate of the whole device.  The set-dt primitive does not
+// come here: it sets the period of its own thread, which the scheduler
+// uses to wake the device (see SpatialComputer::schedule_next).
+Number FixedIntervalTime::set_dt (const VMContext& c, Number dt) {
+  ((FixedTimer*)c.device->timer)->set_internal_dt(dt);
   return dt;
 }
 
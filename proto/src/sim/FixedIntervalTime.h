@@ -38,7 +38,7 @@ public:
   DeviceTimer* next_timer(SECONDS* start_lag);
 
   SECONDS cycle_time() { return dt; }
-  Number set_dt (Number dt);
+  Number set_dt (const VMContext& c, Number dt);
 
 };
 
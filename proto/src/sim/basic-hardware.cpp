@@ -10,10 +10,9 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "config.h"
 #include "basic-hardware.h"
+#include "dumpfile.h"
 #include "visualizer.h"
 
-extern Machine * machine;
-
 /*****************************************************************************
  *  DEBUG                                                                    *
  *****************************************************************************/
@@ -60,30 +59,30 @@ void DebugLayer::register_colors() {
 #endif
 }
 
-void DebugLayer::leds_op(Machine* machine) {
+void DebugLayer::leds_op(Machine* machine, const VMContext& context) {
   Number val = machine->stack.peek().asNumber();
-  set_b_led((val > 0.25) != 0 ? 1.0 : 0);
-  set_g_led((val > 0.50) != 0 ? 1.0 : 0);
-  set_r_led((val > 0.75) != 0 ? 1.0 : 0);
+  set_b_led(context.device,(val > 0.25) != 0 ? 1.0 : 0);
+  set_g_led(context.device,(val > 0.50) != 0 ? 1.0 : 0);
+  set_r_led(context.device,(val > 0.75) != 0 ? 1.0 : 0);
 }
 
-void DebugLayer::red_op(Machine* machine) {
-  set_r_led(machine->stack.peek().asNumber());;
+void DebugLayer::red_op(Machine* machine, const VMContext& context) {
+  set_r_led(context.device,machine->stack.peek().asNumber());;
 }
 
-void DebugLayer::green_op(Machine* machine) {
-  set_g_led(machine->stack.peek().asNumber());;
+void DebugLayer::green_op(Machine* machine, const VMContext& context) {
+  set_g_led(context.device,machine->stack.peek().asNumber());;
 }
 
-void DebugLayer::blue_op(Machine* machine) {
-  set_b_led(machine->stack.peek().asNumber());;
+void DebugLayer::blue_op(Machine* machine, const VMContext& context) {
+  set_b_led(context.device,machine->stack.peek().asNumber());;
 }
 
-void DebugLayer::rgb_op(Machine* machine) {
+void DebugLayer::rgb_op(Machine* machine, const VMContext& context) {
   Tuple t = machine->stack.peek().asTuple();
-  set_r_led(t[0].asNumber());
-  set_g_led(t[1].asNumber());
-  set_b_led(t[2].asNumber());
+  set_r_led(context.device,t[0].asNumber());
+  set_g_led(context.device,t[1].asNumber());
+  set_b_led(context.device,t[2].asNumber());
 }
 
 // CLIP forces the number x into the range [min,max]
@@ -121,7 +120,7 @@ void my_hsv_to_rgb (flo h, flo s, flo v, flo *r, flo *g, flo *b) {
   *r = rt*255; *g = gt*255; *b = bt*255;
 }
 
-void DebugLayer::hsv_op(Machine* machine) {
+void DebugLayer::hsv_op(Machine* machine, const VMContext& context) {
   machine->nextInt8();
   Tuple hsv = machine->stack.popTuple();
   flo r, g, b;
@@ -133,8 +132,8 @@ void DebugLayer::hsv_op(Machine* machine) {
   machine->stack.push(rgb);
 }
 
-void DebugLayer::sense_op(Machine* machine) {
-  machine->stack.push(read_sensor((uint8_t) machine->stack.popNumber()));
+void DebugLayer::sense_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_sensor(context.device,(uint8_t) machine->stack.popNumber()));
 }  
 
 bool DebugLayer::handle_key(KeyEvent* key) {
@@ -168,18 +167,18 @@ void DebugLayer::dump_header(FILE* out) {
 }
 
 // actuators
-void DebugLayer::set_probe (Data val, uint8_t index) { 
+void DebugLayer::set_probe (const VMContext& c, Data val, uint8_t index) { 
   if(index >= MAX_PROBES) return; // sanity check index
-   ((DebugDevice*)device->layers[id])->probes[index] = val;
+   ((DebugDevice*)c.device->layers[id])->probes[index] = val;
 }
-void DebugLayer::set_r_led (Number val) 
-{ ((DebugDevice*)device->layers[id])->actuators[R_LED] = val; }
-void DebugLayer::set_g_led (Number val)
-{ ((DebugDevice*)device->layers[id])->actuators[G_LED] = val; }
-void DebugLayer::set_b_led (Number val)
-{ ((DebugDevice*)device->layers[id])->actuators[B_LED] = val; }
-Number DebugLayer::read_sensor (uint8_t n)
-{ return (n<N_SENSORS) ? ((DebugDevice*)device->layers[id])->sensors[USER_A+n-1] : NAN;}
+void DebugLayer::set_r_led (Device* d, Number val) 
+{ ((DebugDevice*)d->layers[id])->actuators[R_LED] = val; }
+void DebugLayer::set_g_led (Device* d, Number val)
+{ ((DebugDevice*)d->layers[id])->actuators[G_LED] = val; }
+void DebugLayer::set_b_led (Device* d, Number val)
+{ ((DebugDevice*)d->layers[id])->actuators[B_LED] = val; }
+Number DebugLayer::read_sensor (Device* d, uint8_t n)
+{ return (n<N_SENSORS) ? ((DebugDevice*)d->layers[id])->sensors[USER_A+n-1] : NAN;}
 
 // per-device interface, used primarily for visualization
 DebugDevice::DebugDevice(DebugLayer* parent, Device* d) : DeviceLayer(d) {
@@ -216,6 +215,17 @@ void DebugDevice::dump_state(FILE* out, int verbosity) {
   }
 }
 
+void DebugDevice::dump_values(DumpWriter* out) {
+  uint32_t dumpmask = parent->dumpmask; // shorten the name
+  if(dumpmask & 0x02) out->put(sensors[USER_A],2);
+  if(dumpmask & 0x04) out->put(sensors[USER_B],2);
+  if(dumpmask & 0x08) out->put(sensors[USER_C],2);
+  if(dumpmask & 0x10) out->put(sensors[USER_D],2);
+  if(dumpmask & 0x20) out->put(actuators[R_LED],3);
+  if(dumpmask & 0x40) out->put(actuators[G_LED],3);
+  if(dumpmask & 0x80) out->put(actuators[B_LED],3);
+}
+
 bool DebugDevice::handle_key(KeyEvent* key) {
   if(key->normal && !key->ctrl) {
     switch(key->key) {
@@ -310,8 +320,8 @@ PerfectLocalizer::PerfectLocalizer(SpatialComputer* parent) : Layer(parent) {
   parent->hardware.patch(this,READ_SPEED_FN);
 }
 
-void PerfectLocalizer::coord_op(Machine* machine) {
-  machine->stack.push(read_coord_sensor());
+void PerfectLocalizer::coord_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(read_coord_sensor(context.device));
 }
 
 vector<HardwareFunction> PerfectLocalizer::getImplementedHardwareFunctions()
@@ -325,7 +335,7 @@ void PerfectLocalizer::add_device(Device* d) {
   d->layers[id] = new PerfectLocalizerDevice(d);
 }
 
-Tuple PerfectLocalizer::read_coord_sensor() {
+Tuple PerfectLocalizer::read_coord_sensor(Device* device) {
   PerfectLocalizerDevice* d = (PerfectLocalizerDevice*)device->layers[id];
   if(!d->coord_sense.isSet()) {
     Tuple c(3);
@@ -339,8 +349,8 @@ Tuple PerfectLocalizer::read_coord_sensor() {
   return d->coord_sense.asTuple();
 }
 
-Number PerfectLocalizer::read_speed() {
-  const METERS* v = device->body->velocity();
+Number PerfectLocalizer::read_speed(const VMContext& c) {
+  const METERS* v = c.device->body->velocity();
   return sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
 }
 
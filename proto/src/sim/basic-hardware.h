@@ -36,20 +36,21 @@ public:
   void add_device(Device* d);
   bool handle_key(KeyEvent* event);
   // hardware emulation
-  void set_probe (Data val, uint8_t index); // debugging data probe
+  void set_probe (const VMContext& c, Data val, uint8_t index); // debugging data probe
   void dump_header(FILE* out); // list log-file fields
+  bool is_thread_safe() { return true; }
  private:
-  void leds_op(Machine* machine);
-  void red_op(Machine* machine);
-  void green_op(Machine* machine);
-  void blue_op(Machine* machine);
-  void rgb_op(Machine* machine);
-  void hsv_op(Machine* machine);
-  void sense_op(Machine* machine);
-  void set_r_led (Number val);
-  void set_g_led (Number val);
-  void set_b_led (Number val);
-  Number read_sensor (uint8_t n); // for "user" sensors                                       
+  void leds_op(Machine* machine, const VMContext& context);
+  void red_op(Machine* machine, const VMContext& context);
+  void green_op(Machine* machine, const VMContext& context);
+  void blue_op(Machine* machine, const VMContext& context);
+  void rgb_op(Machine* machine, const VMContext& context);
+  void hsv_op(Machine* machine, const VMContext& context);
+  void sense_op(Machine* machine, const VMContext& context);
+  void set_r_led (Device* d, Number val);
+  void set_g_led (Device* d, Number val);
+  void set_b_led (Device* d, Number val);
+  Number read_sensor (Device* d, uint8_t n); // for "user" sensors                                       
 
  public:
   void register_colors();
@@ -87,6 +88,7 @@ public:
   bool handle_key(KeyEvent* event);
   void copy_state(DeviceLayer* src) {} // to be called during cloning
   void dump_state(FILE* out, int verbosity); // print state to file
+  void dump_values(DumpWriter* out); // the same, for binary dumps
 };
 
 /*****************************************************************************
@@ -97,19 +99,21 @@ class PerfectLocalizer : public Layer, public HardwarePatch {
  public:
   PerfectLocalizer(SpatialComputer* parent);
   void add_device(Device* d);
-  Number read_speed ();
+  bool is_thread_safe() { return true; }
+  Number read_speed (const VMContext& c);
 
   // returns a list of function  that it patches/ provides impementation for
   static vector<HardwareFunction> getImplementedHardwareFunctions();
  private:
-  void coord_op(Machine* machine);
-  Tuple read_coord_sensor();
+  void coord_op(Machine* machine, const VMContext& context);
+  Tuple read_coord_sensor(Device* device);
 };
 class PerfectLocalizerDevice : public DeviceLayer {
  public:
   Data coord_sense; // data location for kernel to access coordinates
   PerfectLocalizerDevice(Device* container) : DeviceLayer(container) { }
   void copy_state(DeviceLayer*) {} // no state worth copying
+  void dump_values(DumpWriter* out) {} // nothing is dumped
 };
 
 class LeftoverLayer : public Layer {
@@ -1,11 +1,28 @@
+class Device;
+class SimulatedHardware;
 
-void platform_operation(Int8); // This will be called for any unknown opcode.
+/// The simulator objects a SimMachine is running for.
+/**
+ * Platform opcodes and the hardware functions patched in a SimulatedHardware are given the context of the Machine calling them,
+ * so they do not depend on global state, and several Machines (or SpatialComputers) can run at the same time.
+ */
+struct VMContext {
+	SimulatedHardware * hardware;
+	Device * device;
+	VMContext() : hardware(0), device(0) {}
+};
+
+void platform_operation(VMContext const & context, Int8 opcode); // This will be called for any unknown opcode.
 
 class SimMachine : public Machine {
 	
+	public:
+		/// The device and hardware this Machine is running for.
+		VMContext context;
+	
 	protected:
 		void execute_unknown(Int8 opcode) {
-			platform_operation(opcode);
+			platform_operation(context, opcode);
 		}
 		
 };
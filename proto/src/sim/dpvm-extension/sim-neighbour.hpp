@@ -6,8 +6,23 @@ class SimNeighbour : public Neighbour {
 		Number lag;
 		
 		bool in_range;
+		bool is_changed; // Has anything the Machine can read of this neighbour changed since it last ran? (for -quiescent)
 		
-		SimNeighbour(MachineId const & id, Size imports) : Neighbour(id, imports) {x = 0; y = 0; z = 0; lag = 0; in_range = false;}
+		SimNeighbour(MachineId const & id, Size imports) : Neighbour(id, imports) {x = 0; y = 0; z = 0; lag = 0; in_range = false; is_changed = true;}
+		
+		// Deliver an export of this neighbour, at the given offset.
+		// The imports keep the size of the receiving Machine: a snapshot of another size
+		// (from a Machine running another script) is copied in as far as it fits.
+		void receive(Imports const & data, Number dx, Number dy, Number dz) {
+			if (!imports.shares(data) || x != dx || y != dy || z != dz) is_changed = true;
+			if (data.size() == imports.size()) {
+				imports = data; // shares the snapshot, no copying
+			} else {
+				for(Index i = 0; i < data.size() && i < imports.size(); i++) imports.set(i, data[i]);
+			}
+			x = dx; y = dy; z = dz;
+			data_age = 0;
+		}
 };
 
 #undef Neighbour
@@ -0,0 +1,254 @@
+/* Binary, columnar dump files
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dumpfile.h"
+#include "utils.h"
+
+/*****************************************************************************
+ *  WRITING                                                                  *
+ *****************************************************************************/
+
+DumpWriter::DumpWriter(FILE* out) {
+  this->out=out; scratch=NULL; warned=false;
+  uint32_t version = DUMP_VERSION;
+  fwrite(DUMP_MAGIC,1,8,out); fwrite(&version,sizeof(version),1,out);
+}
+
+DumpWriter::~DumpWriter() { if(scratch) fclose(scratch); }
+
+void DumpWriter::begin_frame(double time, const std::string& header,
+                             int flags) {
+  this->time=time; this->header=header; this->flags=flags;
+  n_devices=0; n_cols=-1; col=0; device_open=false;
+  for(size_t i=0;i<columns.size();i++) columns[i].clear();
+  precision.clear(); value_lengths.clear(); values.clear(); value_text="";
+  neighbor_counts.clear(); neighbors.clear();
+}
+
+void DumpWriter::begin_device() { end_device(); device_open=true; col=0; }
+
+void DumpWriter::put(double value, int precision) {
+  if(n_cols<0) { // the first device sets the columns for the frame
+    if(columns.size()<=(size_t)col) columns.resize(col+1);
+    this->precision.push_back(precision);
+  } else if(col>=n_cols) {
+    if(!warned) post("WARNING: dumped device has more than %d fields\n",n_cols);
+    warned=true; return;
+  }
+  columns[col++].push_back(value);
+}
+
+// Each whitespace-separated number is a column; its precision is the
+// number of digits after its decimal point.  Text that is not a number
+// (which no layer is expected to dump) is kept as NAN.
+void DumpWriter::put_fields(const std::string& text) {
+  const char* s = text.c_str();
+  while(true) {
+    while(*s==' ' || *s=='\t' || *s=='\n') s++;
+    if(!*s) return;
+    char* end; double v = strtod(s,&end);
+    if(end==s) { // skip the unreadable token
+      v = NAN; while(*end && *end!=' ' && *end!='\t' && *end!='\n') end++;
+    }
+    const char* point = strchr(s,'.'); int digits=0;
+    if(point && point<end)
+      for(point++; point<end && *point>='0' && *point<='9'; point++) digits++;
+    put(v,digits);
+    s=end;
+  }
+}
+
+void DumpWriter::put_value(const double* v, int n) {
+  end_device(); // OUT always comes after the fixed columns
+  value_lengths.push_back(n);
+  values.insert(values.end(),v,v+n);
+}
+
+void DumpWriter::put_value_text(const char* text) {
+  end_device();
+  int n = strlen(text);
+  value_lengths.push_back(-n);
+  value_text.append(text,n);
+}
+
+void DumpWriter::put_neighbor_count(int n) {
+  end_device();
+  neighbor_counts.push_back(n);
+}
+
+void DumpWriter::put_neighbor(int id) { neighbors.push_back(id); }
+
+// finishes the fixed columns of a device; safe to call more than once
+void DumpWriter::end_device() {
+  if(!device_open) return;
+  device_open=false; n_devices++;
+  if(n_cols<0) { n_cols=col; columns.resize(n_cols); return; }
+  if(col<n_cols && !warned) {
+    post("WARNING: dumped device has %d fields instead of %d\n",col,n_cols);
+    warned=true;
+  }
+  for(;col<n_cols;col++) columns[col].push_back(NAN);
+}
+
+void DumpWriter::end_frame() {
+  end_device();
+  if(n_cols<0) n_cols=0; // no devices
+  uint32_t header_len = header.size(), n = n_devices, cols = n_cols,
+    f = flags;
+  fwrite(DUMP_FRAME_MAGIC,1,4,out);
+  fwrite(&time,sizeof(time),1,out);
+  fwrite(&header_len,sizeof(header_len),1,out);
+  fwrite(header.data(),1,header_len,out);
+  fwrite(&n,sizeof(n),1,out);
+  fwrite(&cols,sizeof(cols),1,out);
+  fwrite(&f,sizeof(f),1,out);
+  if(cols) fwrite(&precision[0],1,cols,out);
+  std::vector<uint8_t> width(cols,sizeof(float));
+  for(uint32_t c=0;c<cols;c++)
+    for(uint32_t i=0;i<n;i++)
+      if((double)(float)columns[c][i]!=columns[c][i] && !isnan(columns[c][i]))
+        { width[c]=sizeof(double); break; }
+  if(cols) fwrite(&width[0],1,cols,out);
+  for(uint32_t c=0;c<cols;c++) {
+    if(!n) continue;
+    if(width[c]==sizeof(double)) {
+      fwrite(&columns[c][0],sizeof(double),n,out);
+    } else {
+      narrow.assign(columns[c].begin(),columns[c].end());
+      fwrite(&narrow[0],sizeof(float),n,out);
+    }
+  }
+  if(flags & DUMP_HAS_VALUE) {
+    if(n) fwrite(&value_lengths[0],sizeof(int32_t),n,out);
+    // numbers and text are interleaved in device order
+    size_t vi=0, ti=0;
+    for(uint32_t i=0;i<n;i++) {
+      int len = value_lengths[i];
+      if(len>=0) { fwrite(&values[vi],sizeof(double),len,out); vi+=len; }
+      else { fwrite(value_text.data()+ti,1,-len,out); ti+=-len; }
+    }
+  }
+  if(flags & DUMP_HAS_NETWORK) {
+    if(n) fwrite(&neighbor_counts[0],sizeof(int32_t),n,out);
+    if(neighbors.size())
+      fwrite(&neighbors[0],sizeof(int32_t),neighbors.size(),out);
+  }
+  fflush(out);
+}
+
+FILE* DumpWriter::begin_scratch() {
+  if(!scratch && !(scratch = tmpfile()))
+    uerror("Unable to open a scratch file for dumping");
+  rewind(scratch);
+  return scratch;
+}
+
+std::string DumpWriter::end_scratch() {
+  long len = ftell(scratch);
+  std::string text(len,' ');
+  rewind(scratch);
+  if(len && fread(&text[0],1,len,scratch)!=(size_t)len)
+    uerror("Unable to read back the dump scratch file");
+  rewind(scratch);
+  return text;
+}
+
+/*****************************************************************************
+ *  READING                                                                  *
+ *****************************************************************************/
+
+DumpReader::DumpReader(FILE* in) { this->in=in; n_devices=n_cols=flags=0; }
+
+void DumpReader::read(void* dst, size_t size, size_t n) {
+  if(n && fread(dst,size,n,in)!=n) uerror("Dump file is truncated");
+}
+
+bool DumpReader::read_frame() {
+  char magic[8];
+  while(true) {
+    if(fread(magic,1,4,in)!=4) return false;
+    if(!memcmp(magic,DUMP_FRAME_MAGIC,4)) break;
+    // the start of a file, perhaps in the middle of concatenated ones
+    read(magic+4,1,4);
+    uint32_t version; read(&version,sizeof(version),1);
+    if(memcmp(magic,DUMP_MAGIC,8)) uerror("Not a binary dump file");
+    if(version!=DUMP_VERSION)
+      uerror("Unknown binary dump version %d",(int)version);
+  }
+  uint32_t header_len, n, cols, f;
+  read(&time,sizeof(time),1);
+  read(&header_len,sizeof(header_len),1);
+  header.resize(header_len);
+  if(header_len) read(&header[0],1,header_len);
+  read(&n,sizeof(n),1); read(&cols,sizeof(cols),1); read(&f,sizeof(f),1);
+  n_devices=n; n_cols=cols; flags=f;
+  precision.resize(cols); if(cols) read(&precision[0],1,cols);
+  std::vector<uint8_t> width(cols); if(cols) read(&width[0],1,cols);
+  columns.resize(cols*n);
+  std::vector<float> narrow;
+  for(uint32_t c=0;c<cols && n;c++) {
+    if(width[c]==sizeof(double)) {
+      read(&columns[c*n],sizeof(double),n);
+    } else if(width[c]==sizeof(float)) {
+      narrow.resize(n); read(&narrow[0],sizeof(float),n);
+      for(uint32_t i=0;i<n;i++) columns[c*n+i]=narrow[i];
+    } else {
+      uerror("Bad column width %d in binary dump",(int)width[c]);
+    }
+  }
+  value_lengths.clear(); values.clear(); value_text="";
+  if(flags & DUMP_HAS_VALUE) {
+    value_lengths.resize(n); read(&value_lengths[0],sizeof(int32_t),n);
+    for(uint32_t i=0;i<n;i++) {
+      int len = value_lengths[i];
+      if(len>=0) {
+        size_t at = values.size(); values.resize(at+len);
+        if(len) read(&values[at],sizeof(double),len);
+      } else {
+        size_t at = value_text.size(); value_text.resize(at-len);
+        read(&value_text[at],1,-len);
+      }
+    }
+  }
+  neighbor_counts.clear(); neighbors.clear();
+  if(flags & DUMP_HAS_NETWORK) {
+    neighbor_counts.resize(n); read(&neighbor_counts[0],sizeof(int32_t),n);
+    size_t total=0;
+    for(uint32_t i=0;i<n;i++) total+=neighbor_counts[i];
+    neighbors.resize(total);
+    if(total) read(&neighbors[0],sizeof(int32_t),total);
+  }
+  return true;
+}
+
+void DumpReader::write_text(FILE* out) {
+  fputs(header.c_str(),out);
+  size_t vi=0, ti=0, ni=0;
+  for(int d=0;d<n_devices;d++) {
+    for(int c=0;c<n_cols;c++)
+      fprintf(out,c?" %.*f":"%.*f",precision[c],columns[c*n_devices+d]);
+    if(flags & DUMP_HAS_VALUE) {
+      int len = value_lengths[d];
+      fputc(' ',out);
+      if(len>=0) {
+        for(int i=0;i<len;i++) fprintf(out,i?" %.2f":"%.2f",values[vi++]);
+      } else {
+        fwrite(value_text.data()+ti,1,-len,out); ti+=-len;
+      }
+    }
+    if(flags & DUMP_HAS_NETWORK) {
+      fprintf(out," %i",neighbor_counts[d]);
+      for(int i=0;i<neighbor_counts[d];i++) fprintf(out," %i",neighbors[ni++]);
+    }
+    fputc('\n',out);
+  }
+}
@@ -0,0 +1,97 @@
+/* Binary, columnar dump files
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#ifndef __DUMPFILE__
+#define __DUMPFILE__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// With -dump-binary, a run's dumps are appended as frames to a single
+// .pdump file instead of being printed to one .log file per frame.
+// Every frame holds exactly what its .log would, and can be turned back
+// into it (see dump2text and tests/protodump.py).  All numbers are in
+// the byte order of the machine that wrote the file.
+//
+//   file:   "PROTODMP" uint32(1) frame*   (files may be concatenated)
+//   frame:  "FRAM" double time
+//           uint32 header length, header text (the .log's first line)
+//           uint32 devices, uint32 columns, uint32 flags (1=OUT, 2=NBRS)
+//           uint8 precision[columns]   (digits after the point)
+//           uint8 width[columns]       (4: float, 8: double)
+//           column[columns][devices]   (each a float or double array)
+//           if OUT:  int32 length[devices], then for each device either
+//                    length doubles or, if negative, -length bytes of text
+//           if NBRS: int32 count[devices], then int32 ids of all devices
+//
+// The fixed columns are the UID, TICKS and TIME of each device and then
+// the numbers of every dumped layer, in the order of the header.  A
+// column is stored as floats when that loses nothing, as it does for
+// the many fields that are flo.
+
+#define DUMP_MAGIC "PROTODMP"
+#define DUMP_FRAME_MAGIC "FRAM"
+#define DUMP_VERSION 1
+#define DUMP_HAS_VALUE 0x01
+#define DUMP_HAS_NETWORK 0x02
+
+// Collects one frame at a time, device by device, then writes it out
+class DumpWriter {
+ public:
+  DumpWriter(FILE* out); // writes the file's header; does not close it
+  ~DumpWriter();
+  void begin_frame(double time, const std::string& header, int flags);
+  void begin_device();
+  void put(double value, int precision); // add the next fixed column
+  void put_fields(const std::string& text); // columns from a text dump
+  void put_value(const double* values, int n); // OUT as numbers
+  void put_value_text(const char* text); // OUT when it is not numeric
+  void put_neighbor_count(int n);
+  void put_neighbor(int id);
+  void end_frame(); // write the frame and flush the file
+  // text dumps are captured by printing them to a scratch file
+  FILE* begin_scratch();
+  std::string end_scratch();
+
+ private:
+  FILE* out; FILE* scratch;
+  double time; std::string header; int flags;
+  int n_devices, col, n_cols;
+  bool device_open, warned;
+  std::vector<std::vector<double> > columns;
+  std::vector<uint8_t> precision;
+  std::vector<float> narrow; // a column being written as floats
+  std::vector<int32_t> value_lengths, neighbor_counts, neighbors;
+  std::vector<double> values;
+  std::string value_text;
+  void end_device();
+};
+
+// Reads the frames of a .pdump file back in
+class DumpReader {
+ public:
+  double time; std::string header; int flags;
+  int n_devices, n_cols;
+  std::vector<uint8_t> precision;
+  std::vector<double> columns;  // column c of device d is [c*n_devices+d]
+  std::vector<int32_t> value_lengths, neighbor_counts, neighbors;
+  std::vector<double> values;
+  std::string value_text;
+
+  DumpReader(FILE* in);
+  bool read_frame(); // false at the end of the file; errors are fatal
+  void write_text(FILE* out); // print the frame as its .log would be
+
+ private:
+  FILE* in;
+  void read(void* dst, size_t size, size_t n);
+};
+
+#endif // __DUMPFILE__
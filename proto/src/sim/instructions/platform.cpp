@@ -5,12 +5,12 @@
 using std::sqrt;
 using std::atan2;
 
-extern Number read_speed();
-extern Number read_bearing();
-extern Number read_radio_range();
-extern void flex(Number);
-extern void mov(Tuple);
-extern void set_probe(Data, Int8);
+extern Number read_speed(VMContext const &);
+extern Number read_bearing(VMContext const &);
+extern Number read_radio_range(VMContext const &);
+extern void flex(VMContext const &, Number);
+extern void mov(VMContext const &, Tuple);
+extern void set_probe(VMContext const &, Data, Int8);
 
 namespace Instructions {
 	
@@ -23,24 +23,24 @@ namespace Instructions {
 	}
 	
 	void SPEED(Machine & machine){
-		machine.stack.push(read_speed());
+		machine.stack.push(read_speed(machine.context));
 	}
 	
 	void BEARING(Machine & machine){
-		machine.stack.push(read_bearing());
+		machine.stack.push(read_bearing(machine.context));
 	}
 	
 	void FLEX(Machine & machine){
-		flex(machine.stack.peek().asNumber());
+		flex(machine.context, machine.stack.peek().asNumber());
 	}
 	
 	void MOV(Machine & machine){
-		mov(machine.stack.peek().asTuple());
+		mov(machine.context, machine.stack.peek().asTuple());
 	}
 	
 	void PROBE(Machine & machine){
 		Int8 i = machine.stack.pop().asNumber();
-		set_probe(machine.stack.peek(), i);
+		set_probe(machine.context, machine.stack.peek(), i);
 	}
 	
 	void NBR_LAG(Machine & machine){
@@ -71,7 +71,8 @@ namespace Instructions {
 	
 	namespace {
 		Number machine_disc_area(Machine & machine) {
-			return read_radio_range() * read_radio_range() * 3.14;
+			Number range = read_radio_range(machine.context);
+			return range * range * 3.14;
 		}
 		
 		Number machine_area(Machine & machine) {
@@ -88,7 +89,7 @@ namespace Instructions {
 	}
 	
 	void HOOD_RADIUS(Machine & machine){
-		machine.stack.push(read_radio_range());
+		machine.stack.push(read_radio_range(machine.context));
 	}
 	
 	void INFINITESIMAL(Machine & machine){
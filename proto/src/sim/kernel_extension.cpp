@@ -10,7 +10,6 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #include <stdlib.h>
 #include "sim-hardware.h"
 
-void my_platform_operation(uint8_t op) {
-  extern SimulatedHardware* hardware;
-  hardware->dispatchOpcode(op);
+void my_platform_operation(const VMContext& context, uint8_t op) {
+  context.hardware->dispatchOpcode(context,op);
 }
@@ -155,7 +155,7 @@ int main (int argc, char *argv[]) {
 #ifdef WANT_GLUT
   palette = Palette::default_palette;
 #endif //WANT_GLUT
-  computer = new SpatialComputer(args,!test_mode); // then the computer
+  computer = new SpatialComputer(args,!test_mode,rand()); // then the computer
   int len = -1;
   if(args->argc <= 0)
      FATAL("Insufficient arguments");
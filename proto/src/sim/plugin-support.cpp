@@ -7,12 +7,19 @@ the GNU General Public License, with a linking exception, as described
 in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "spatialcomputer.h"
+#include "dumpfile.h"
 
 Layer::Layer(SpatialComputer* p) {
-  parent = p;
+  parent = p; rng = p->layer_stream();
   can_dump = p->is_dump_default;
 }
 
+// layers that don't know about binary dumps have their text dump parsed
+void DeviceLayer::dump_values(DumpWriter* out) {
+  dump_state(out->begin_scratch(),0);
+  out->put_fields(out->end_scratch());
+}
+
 Distribution::Distribution(int n, Rect *volume) {
   this->n=n; this->volume=volume;
   width = volume->r-volume->l; height = volume->t-volume->b; depth=0;
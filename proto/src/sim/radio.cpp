@@ -55,10 +55,15 @@ bool RadioSim::handle_key(KeyEvent* key) {
   return false;
 }
 
-bool RadioSim::try_tx() {
-  return tx_error==0 || urnd(0,1) > tx_error;
+// transmit errors are drawn from the sender's own stream, in the order of
+// its own broadcasts.  A receive error is picked out of the receiver's
+// stream by the sender and the number of its broadcast, so it does not
+// depend on the order in which the packets arrive.
+bool RadioSim::try_tx(Device* sender) {
+  return tx_error==0 || sender->rng.urnd(0,1) > tx_error;
 }
 
-bool RadioSim::try_rx() {
-  return rx_error==0 || urnd(0,1) > rx_error;
+bool RadioSim::try_rx(Device* receiver, Device* sender) {
+  return rx_error==0 || receiver->rng.substream(sender->uid)
+    .urnd_at(sender->broadcasts,0,1) > rx_error;
 }
@@ -32,8 +32,8 @@ class RadioSim : public Layer, public HardwarePatch {
   virtual void register_colors();
   
 protected:
-  bool try_tx();
-  bool try_rx();
+  bool try_tx(Device* sender);   // does a transmission get out?
+  bool try_rx(Device* receiver, Device* sender); // does it get in?
 };
 
 #endif
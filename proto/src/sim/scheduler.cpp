@@ -1,4 +1,4 @@
-/* Special-purpose priority queue variant
+/* Special-purpose priority queue variants
 Copyright (C) 2005-2008, Jonathan Bachrach, Jacob Beal, and contributors 
 listed in the AUTHORS file in the MIT Proto distribution's top directory.
 
@@ -9,46 +9,80 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #include "config.h"
 #include <stdio.h>
 #include "scheduler.h"
+#include <algorithm>
+#include <string>
 
+Scheduler* Scheduler::create(const char* name, int num_users,
+                             double cycle_time) {
+  std::string s = name;
+  if(s=="slots") return new SlotScheduler(num_users,cycle_time);
+  if(s=="calendar") return new CalendarScheduler(num_users,cycle_time);
+  if(s=="heap") return new HeapScheduler(num_users);
+  return NULL;
+}
+
+/*****************************************************************************
+ *  SLOT SCHEDULER                                                           *
+ *****************************************************************************/
 /*****   IMPLEMENTATION *****/
 // Assuming an even distribution of N users into S time-slots, 
 // there is expected to be 4*N/S users per slot (each user has an
 // execute event and a transmit event, both generally in the front half
 // Cycle time is the expected time of a devices' round
-Scheduler::Scheduler(int num_users, double cycle_time) {
+SlotScheduler::SlotScheduler(int num_users, double cycle_time) {
   cur_slot=0;
   num_slots = num_users;
-  queue = (evtList**)calloc(sizeof(evtList*),num_slots);
+  queue = (int*)malloc(sizeof(int)*num_slots);
+  for(int i=0;i<num_slots;i++) queue[i]=NO_EVT;
+  num_nodes = 0; nodes = NULL; free_nodes = NO_EVT;
   slot_cycle_time = cycle_time*2;
   working_min = 0; working_max = slot_cycle_time;
   cycle_safety = num_slots*10;
 }
 
-Scheduler::~Scheduler() {
-  for(int i=0;i<num_slots;i++) {
-    evtList *l = queue[i];
-    while(l) { evtList* next=l->next; free(l); l=next; }
-  }
+SlotScheduler::~SlotScheduler() {
+  free(nodes);
   free(queue);
 }
 
-Event* Scheduler::insert_evt(int slot, double time) {
-  evtList *new_evt = (evtList*)malloc(sizeof(evtList));
-  evtList *l = queue[slot];
-  while(l) {
-    if(time<l->e.true_time) {
-      new_evt->prev=l->prev; new_evt->next=l; l->prev=new_evt;
-      if(new_evt->prev) new_evt->prev->next=new_evt;
-      if(queue[slot]==l) queue[slot]=new_evt;
+// take a node from the free chain, growing the array if it is empty
+int SlotScheduler::new_node() {
+  if(free_nodes==NO_EVT) {
+    int old_size = num_nodes;
+    num_nodes = (num_nodes ? 2*num_nodes : 2*num_slots+16);
+    nodes = (evtList*)realloc(nodes,sizeof(evtList)*num_nodes);
+    for(int i=old_size;i<num_nodes;i++) nodes[i].next=i+1;
+    nodes[num_nodes-1].next=NO_EVT;
+    free_nodes=old_size;
+  }
+  int n = free_nodes;
+  free_nodes = nodes[n].next;
+  return n;
+}
+
+void SlotScheduler::delete_node(int n) {
+  nodes[n].next = free_nodes;
+  free_nodes = n;
+}
+
+Event* SlotScheduler::insert_evt(int slot, double time) {
+  int n = new_node();
+  evtList *new_evt = &nodes[n];
+  int l = queue[slot];
+  while(l!=NO_EVT) {
+    if(time<nodes[l].e.true_time) {
+      new_evt->prev=nodes[l].prev; new_evt->next=l; nodes[l].prev=n;
+      if(new_evt->prev!=NO_EVT) nodes[new_evt->prev].next=n;
+      if(queue[slot]==l) queue[slot]=n;
       return &new_evt->e;
-    } else if(!l->next) {
+    } else if(nodes[l].next==NO_EVT) {
       break;
     } else {
-      l=l->next;
+      l=nodes[l].next;
     }
   }
-  if(!queue[slot]) queue[slot]=new_evt;
-  new_evt->prev=l; new_evt->next=NULL; if(l) l->next=new_evt;
+  if(queue[slot]==NO_EVT) queue[slot]=n;
+  new_evt->prev=l; new_evt->next=NO_EVT; if(l!=NO_EVT) nodes[l].next=n;
   return &new_evt->e;
 }
 
@@ -58,7 +92,7 @@ void copy_evt(Event* from, Event* to) {
   to->type=from->type; to->uid=from->uid;
 }
 
-void Scheduler::schedule_event(void* target, double true_time, 
+void SlotScheduler::schedule_event(void* target, double true_time, 
                                double internal_time, int type, int uid) {
   // wrap time to choose slot
   double wraps = fmod(true_time,slot_cycle_time);
@@ -70,9 +104,13 @@ void Scheduler::schedule_event(void* target, double true_time,
 }
 
 // returns 1 if the list is well structured, 0 otherwise
-int test_validity(evtList* l, double prev_time) {
-  if(!l) return 1;
-  return (l->e.true_time>prev_time) && test_validity(l->next, l->e.true_time);
+int SlotScheduler::test_validity(int slot) {
+  int prev = NO_EVT;
+  for(int l=queue[slot]; l!=NO_EVT; prev=l, l=nodes[l].next) {
+    if(nodes[l].prev!=prev) return 0;
+    if(prev!=NO_EVT && nodes[l].e.true_time<nodes[prev].e.true_time) return 0;
+  }
+  return 1;
 }
 
 /*** deletion routines ***/
@@ -80,20 +118,22 @@ int test_validity(evtList* l, double prev_time) {
 // find if there's an event in the working range.  If so, put it in scratch
 // and shrink the contents of the slot
 // return 1 when successful
-int Scheduler::get_next_from_cur_slot() {
-  evtList *l = queue[cur_slot];
-  if(l && l->e.true_time<=bound_time) { // used to be working_max
+int SlotScheduler::get_next_from_cur_slot() {
+  int n = queue[cur_slot];
+  if(n!=NO_EVT && nodes[n].e.true_time<=bound_time) { // used to be working_max
+    evtList *l = &nodes[n];
     copy_evt(&l->e,scratch);
-    // remove event from list and deallocate
-    if(l->next) l->next->prev=l->prev;
-    if(l->prev) { l->prev->next=l->next; } else { queue[cur_slot]=l->next; }
-    free(l);
+    // remove event from list and return its node to the free chain
+    if(l->next!=NO_EVT) nodes[l->next].prev=l->prev;
+    if(l->prev!=NO_EVT) { nodes[l->prev].next=l->next; }
+    else { queue[cur_slot]=l->next; }
+    delete_node(n);
     return 1;
   } else return 0;
 }
 
 // move the current slot forward, wrapping if necessary
-void Scheduler::advance_cur_slot() {
+void SlotScheduler::advance_cur_slot() {
   cur_slot++;
   if(cur_slot >= num_slots) {
     cur_slot=0;
@@ -102,12 +142,12 @@ void Scheduler::advance_cur_slot() {
 }
 
 // interface functions
-void Scheduler::set_bound(double time) {
+void SlotScheduler::set_bound(double time) {
   bound_time = time;
   bound_slot = ((int)((time-working_min)/slot_cycle_time*num_slots))%num_slots;
   //printf("Bounds set to time %f and slot %d\n",bound_time,bound_slot);
 }
-int Scheduler::pop_next_event(Event *evt) {
+int SlotScheduler::pop_next_event(Event *evt) {
   int i=0;
   scratch=evt; // set return location
   while(1) {
@@ -124,38 +164,219 @@ int Scheduler::pop_next_event(Event *evt) {
 }
 
 
-// Test for correct behavior:
+/*****************************************************************************
+ *  CALENDAR SCHEDULER                                                       *
+ *****************************************************************************/
+#define MIN_BUCKETS 16
+#define WIDTH_SAMPLE 25 // events whose spacing sets the width on resize
+
+// Start with a bucket per user, a cycle wide in all
+CalendarScheduler::CalendarScheduler(int num_users, double cycle_time) {
+  free_nodes = NO_EVT; num_events = 0;
+  int n = std::max(num_users,MIN_BUCKETS);
+  heads.assign(n,NO_EVT); tails.assign(n,NO_EVT);
+  width = cycle_time/n; if(width<=0) width = 1;
+  bound_time = 0;
+  move_to(0);
+}
+
+int CalendarScheduler::bucket_of(double time) {
+  double day = floor(time/width);
+  return (int)fmod(day,(double)heads.size());
+}
+
+void CalendarScheduler::move_to(double time) {
+  cur_day = floor(time/width);
+  cur_bucket = (int)fmod(cur_day,(double)heads.size());
+}
+
+// put node n into its bucket, after any events at the same time
+void CalendarScheduler::insert(int n) {
+  double time = nodes[n].e.true_time;
+  int b = bucket_of(time);
+  int l = tails[b];
+  while(l!=NO_EVT && nodes[l].e.true_time>time) l=nodes[l].prev;
+  nodes[n].prev = l;
+  if(l==NO_EVT) { nodes[n].next=heads[b]; heads[b]=n; }
+  else { nodes[n].next=nodes[l].next; nodes[l].next=n; }
+  if(nodes[n].next==NO_EVT) tails[b]=n; else nodes[nodes[n].next].prev=n;
+}
+
+void CalendarScheduler::schedule_event(void* target, double true_time,
+                                       double internal_time, int type,
+                                       int uid) {
+  int n;
+  if(free_nodes!=NO_EVT) { n=free_nodes; free_nodes=nodes[n].next; }
+  else { n=nodes.size(); nodes.push_back(CalendarNode()); }
+  Event &e = nodes[n].e;
+  e.target = target; e.true_time=true_time; e.internal_time=internal_time;
+  e.type=type; e.uid=uid;
+  insert(n);
+  // an event before the search position moves the search back
+  if(floor(true_time/width) < cur_day) move_to(true_time);
+  if(++num_events > 2*(int)heads.size()) resize(2*heads.size());
+}
+
+// Walk the days of the year from the current bucket; if a whole year
+// has nothing, fall back on the earliest head of all buckets
+int CalendarScheduler::find_next() {
+  if(!num_events) return NO_EVT;
+  int nb = heads.size();
+  for(int i=0;i<nb;i++) {
+    int n = heads[cur_bucket];
+    if(n!=NO_EVT && floor(nodes[n].e.true_time/width)<=cur_day) return n;
+    if(++cur_bucket==nb) cur_bucket=0;
+    cur_day += 1;
+  }
+  int best = NO_EVT;
+  for(int b=0;b<nb;b++) {
+    int n = heads[b];
+    if(n!=NO_EVT && (best==NO_EVT || 
+                     nodes[n].e.true_time<nodes[best].e.true_time)) best=n;
+  }
+  move_to(nodes[best].e.true_time);
+  return best;
+}
+
+void CalendarScheduler::set_bound(double time) { bound_time = time; }
+
+int CalendarScheduler::pop_next_event(Event *evt) {
+  int n = find_next();
+  if(n==NO_EVT || nodes[n].e.true_time>bound_time) return 0;
+  *evt = nodes[n].e;
+  int b = cur_bucket; // n is the head of the current bucket
+  heads[b] = nodes[n].next;
+  if(heads[b]==NO_EVT) tails[b]=NO_EVT; else nodes[heads[b]].prev=NO_EVT;
+  nodes[n].next = free_nodes; free_nodes = n;
+  if(--num_events < (int)heads.size()/2 && (int)heads.size()>MIN_BUCKETS)
+    resize(heads.size()/2);
+  return 1;
+}
+
+// Rebuild with num_buckets buckets, with a width of three times the
+// average spacing of the next events (ignoring unusually large gaps)
+void CalendarScheduler::resize(int num_buckets) {
+  double now = cur_day*width;
+  std::vector<int> all; all.reserve(num_events);
+  for(size_t b=0;b<heads.size();b++)
+    for(int n=heads[b];n!=NO_EVT;n=nodes[n].next) all.push_back(n);
+  // bucket lists are in order, and a stable sort keeps same-time events so
+  std::vector<std::pair<double,int> > order;
+  for(size_t i=0;i<all.size();i++)
+    order.push_back(std::make_pair(nodes[all[i]].e.true_time,(int)i));
+  std::sort(order.begin(),order.end());
+  int m = std::min((int)order.size(),WIDTH_SAMPLE);
+  double total = 0; int gaps = 0;
+  for(int i=1;i<m;i++) total += order[i].first-order[i-1].first;
+  if(m>1 && total>0) {
+    double mean = total/(m-1), sum = 0;
+    for(int i=1;i<m;i++) {
+      double gap = order[i].first-order[i-1].first;
+      if(gap>0 && gap<=2*mean) { sum += gap; gaps++; }
+    }
+    if(gaps) width = 3*sum/gaps;
+  }
+  heads.assign(num_buckets,NO_EVT); tails.assign(num_buckets,NO_EVT);
+  for(size_t i=0;i<order.size();i++) insert(all[order[i].second]);
+  move_to(order.empty() ? now : order[0].first);
+}
+
+/*****************************************************************************
+ *  HEAP SCHEDULER                                                           *
+ *****************************************************************************/
+#define HEAP_ARITY 4
+
+static inline bool key_before(const HeapKey &a, const HeapKey &b) {
+  return a.time<b.time || (a.time==b.time && (int)(a.order-b.order)<0);
+}
+
+HeapScheduler::HeapScheduler(int num_users) {
+  heap.reserve(2*num_users); events.reserve(2*num_users);
+  next_order = 0; bound_time = 0;
+}
+
+void HeapScheduler::schedule_event(void* target, double true_time,
+                                   double internal_time, int type, int uid) {
+  int n;
+  if(!free_events.empty()) { n=free_events.back(); free_events.pop_back(); }
+  else { n=events.size(); events.push_back(Event()); }
+  Event &e = events[n];
+  e.target = target; e.true_time=true_time; e.internal_time=internal_time;
+  e.type=type; e.uid=uid;
+  HeapKey k; k.time=true_time; k.order=next_order++; k.event=n;
+  // sift up
+  int i = heap.size(); heap.push_back(k);
+  while(i>0) {
+    int parent = (i-1)/HEAP_ARITY;
+    if(!key_before(k,heap[parent])) break;
+    heap[i] = heap[parent]; i = parent;
+  }
+  heap[i] = k;
+}
+
+void HeapScheduler::set_bound(double time) { bound_time = time; }
+
+int HeapScheduler::pop_next_event(Event *evt) {
+  if(heap.empty() || heap[0].time>bound_time) return 0;
+  int n = heap[0].event;
+  *evt = events[n]; free_events.push_back(n);
+  // sift the last key down from the root
+  HeapKey k = heap.back(); heap.pop_back();
+  int size = heap.size(), i = 0;
+  if(!size) return 1;
+  while(1) {
+    int first = i*HEAP_ARITY+1;
+    if(first>=size) break;
+    int best = first, last = std::min(first+HEAP_ARITY,size);
+    for(int c=first+1;c<last;c++) if(key_before(heap[c],heap[best])) best=c;
+    if(!key_before(heap[best],k)) break;
+    heap[i] = heap[best]; i = best;
+  }
+  heap[i] = k;
+  return 1;
+}
+
+/*****************************************************************************
+ *  TESTING                                                                  *
+ *****************************************************************************/
+// Test for correct behavior, for each kind of scheduler:
 // Events should return in order: 4 0 2 1 3 _ _ 5 6 _
 void Scheduler::test() {
-  printf("Starting scheduler...\n");
-  Scheduler *sch = new Scheduler(10, 1.0);
-  printf("Loading events...\n");
-  sch->schedule_event((void*)2000, 0.3    ,0.1,3000,4000);
-  sch->schedule_event((void*)2001, 0.6002 ,0.2,3001,4001);
-  sch->schedule_event((void*)2002, 0.6001 ,0.3,3002,4002);
-  sch->schedule_event((void*)2003, 0.6003 ,0.4,3003,4003);
-  sch->schedule_event((void*)2004, 0.1    ,0.5,3004,4004);
-  sch->schedule_event((void*)2005, 5.3    ,0.6,3005,4005);
-  sch->schedule_event((void*)2006, 6.1    ,0.7,3006,4006);
-  printf("Extracting events...\n");
-  Event e;
-  int i;
-  for(i=0;i<10;i++) {
-    sch->set_bound((i+1)*0.7);
-    int got = sch->pop_next_event(&e);
-    if(got) {
-      printf("[%p, %f, %f %d %d]\n",e.target,e.true_time,e.internal_time,
-             e.type,e.uid);
-    } else {
-      printf("Pop returned no event through slot %d after %f\n",
-             sch->cur_slot,sch->working_min);
+  const char* names[] = {"slots", "calendar", "heap"};
+  for(int k=0;k<3;k++) {
+    printf("Starting %s scheduler...\n",names[k]);
+    Scheduler *sch = Scheduler::create(names[k], 10, 1.0);
+    printf("Loading events...\n");
+    sch->schedule_event((void*)2000, 0.3    ,0.1,3000,4000);
+    sch->schedule_event((void*)2001, 0.6002 ,0.2,3001,4001);
+    sch->schedule_event((void*)2002, 0.6001 ,0.3,3002,4002);
+    sch->schedule_event((void*)2003, 0.6003 ,0.4,3003,4003);
+    sch->schedule_event((void*)2004, 0.1    ,0.5,3004,4004);
+    sch->schedule_event((void*)2005, 5.3    ,0.6,3005,4005);
+    sch->schedule_event((void*)2006, 6.1    ,0.7,3006,4006);
+    SlotScheduler* slots = dynamic_cast<SlotScheduler*>(sch);
+    for(int s=0;slots && s<slots->num_slots;s++)
+      if(!slots->test_validity(s)) printf("Slot %d is out of order!\n",s);
+    printf("Extracting events...\n");
+    Event e;
+    int i;
+    for(i=0;i<10;i++) {
+      sch->set_bound((i+1)*0.7);
+      int got = sch->pop_next_event(&e);
+      if(got) {
+        printf("[%p, %f, %f %d %d]\n",e.target,e.true_time,e.internal_time,
+               e.type,e.uid);
+      } else {
+        printf("Pop returned no event before %f\n",(i+1)*0.7);
+      }
     }
+    delete sch;
   }
   printf("Done.\n");
 }
 
 /*
 int main(int argc, char *argv[]) {
-  Scheduler::test();
+  SlotScheduler::test();
 }
 */
@@ -1,4 +1,4 @@
-/* Special-purpose priority queue variant
+/* Special-purpose priority queue variants
 Copyright (C) 2005-2008, Jonathan Bachrach, Jacob Beal, and contributors 
 listed in the AUTHORS file in the MIT Proto distribution's top directory.
 
@@ -8,15 +8,11 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include <stdlib.h>
 #include <math.h>
+#include <vector>
 
 #ifndef __SCHEDULER__
 #define __SCHEDULER__
 
-// The scheduler is a priority queue designed for simulations where
-// most devices are evolving cyclically at a fairly similar rate.
-// It performs well when devices execution is well-spread through time and
-// poorly when they are closely synchronized.
-
 struct Event {
   void* target;
   double true_time;
@@ -25,20 +21,67 @@ struct Event {
   int uid;
 };
 
+// A Scheduler is the priority queue of device events.  There are several
+// implementations, chosen with -scheduler NAME:
+//  slots:    (default) one list per time-slot of a device cycle
+//  calendar: a calendar queue, whose buckets resize to the event density
+//  heap:     a 4-ary heap
+// All of them return events in time order, and events at the same time in
+// the order they were scheduled.
+class Scheduler {
+ public:
+  virtual ~Scheduler() {}
+  // returns NULL if there is no scheduler called name
+  static Scheduler* create(const char* name, int num_users, double cycle_time);
+  static void test(); // a regression test fn
+
+  virtual void schedule_event(void* target, double true_time,
+                              double internal_time, int type, int uid)=0;
+  // The bound is a governor intended to prevent the system from going too
+  // far ahead in a burst of pulls.  It is not intended for tight control
+  // of time evolution; events may not return when they are close to the
+  // bound (within 2*cycle_time/num_users seconds for slots)
+  virtual void set_bound(double time)=0;
+  // tests whether there's an event before the bound.  If so, removes the
+  // event from the queue, puts its contents in evt, and returns true
+  virtual int pop_next_event(Event *evt)=0;
+  // There is no remove method: when a target dies, its events are
+  // left in the queue and should be discarded when they appear.
+  // This is because there are generally few events per target.
+  // UID is included to allow reuse of target memory for different targets.
+};
+
+/*****************************************************************************
+ *  SLOT SCHEDULER                                                           *
+ *****************************************************************************/
+// The slot scheduler is designed for simulations where
+// most devices are evolving cyclically at a fairly similar rate.
+// It performs well when devices execution is well-spread through time and
+// poorly when they are closely synchronized.
+
 /*****   DATA STRUCTURE   *****/
-// At 20 bytes per event, the total memory needed is about 28*N
-// which is about 3MB for 100K nodes, and is acceptable.
+// Events are kept in lists threaded through one array of nodes, linked
+// by index, so that scheduling an event does not touch the heap.  Unused
+// nodes are chained together through next.  The array starts with room
+// for two events per user, and doubles when it runs out.
+// At 40 bytes per event, the total memory needed is about 80*N
+// which is about 8MB for 100K nodes, and is acceptable.
+#define NO_EVT (-1)
 struct evtList {
-  struct evtList* prev;
-  struct evtList* next;
+  int prev;
+  int next;
   Event e;
 };
 
-class Scheduler {
+class SlotScheduler : public Scheduler {
+  friend class Scheduler;          // for test()
   int num_slots;                   // number of total slots
   int cur_slot;                    // pointer to start looking for next event
   double slot_cycle_time;          // time covered by the set of timeslots
-  evtList **queue;                 // one cycle worth of timeslots
+  int *queue;                      // one cycle worth of timeslots
+  evtList *nodes;                  // storage for all events
+  int num_nodes;                   // size of nodes
+  int free_nodes;                  // first unused node, or NO_EVT
   double working_min, working_max; // bounds of current cycle
   Event* scratch;                  // for simplifying a return problem
   int bound_slot;                  // slot where searching may stop
@@ -46,29 +89,88 @@ class Scheduler {
   int cycle_safety;                // infinite loop preventer
   
   // internal routines
+  int new_node();
+  void delete_node(int n);
   Event* insert_evt(int slot, double time);
   int get_next_from_cur_slot();
   void advance_cur_slot();
     
  public:
-  Scheduler(int num_users, double cycle_time);
-  ~Scheduler();
-  static void test(); // a regression test fn
+  SlotScheduler(int num_users, double cycle_time);
+  ~SlotScheduler();
+  int test_validity(int slot); // 1 if the slot's list is ordered
+
+  void schedule_event(void* target, double true_time, double internal_time,
+                      int type, int uid);
+  void set_bound(double time);
+  int pop_next_event(Event *evt);
+};
+
+/*****************************************************************************
+ *  CALENDAR SCHEDULER                                                       *
+ *****************************************************************************/
+// A calendar queue (R. Brown, CACM 1988) hashes events by time into a
+// "year" of day-wide buckets, each a sorted list.  The number of buckets
+// follows the number of events, and on every resize the day width is
+// taken from the spacing of the events about to come out, so insertion
+// and removal take about constant time at any density.  Synchronized
+// events, which all land in one bucket, are appended at its tail.
+struct CalendarNode {
+  int prev, next;
+  Event e;
+};
+
+class CalendarScheduler : public Scheduler {
+  std::vector<CalendarNode> nodes; // storage for all events
+  int free_nodes;                  // first unused node, or NO_EVT
+  std::vector<int> heads, tails;   // the sorted list of each bucket
+  int num_events;
+  double width;                    // time covered by one bucket
+  int cur_bucket;                  // where the search for the next event starts
+  double cur_day;                  // which day cur_bucket stands for
+  double bound_time;
+
+  int bucket_of(double time);
+  void move_to(double time);       // start searching at time
+  void insert(int n);
+  int find_next();                 // first event in time order, or NO_EVT
+  void resize(int num_buckets);
+  
+ public:
+  CalendarScheduler(int num_users, double cycle_time);
+
+  void schedule_event(void* target, double true_time, double internal_time,
+                      int type, int uid);
+  void set_bound(double time);
+  int pop_next_event(Event *evt);
+};
+
+/*****************************************************************************
+ *  HEAP SCHEDULER                                                           *
+ *****************************************************************************/
+// A 4-ary heap of small keys (time, order of scheduling, event), which
+// keeps four children in about one cache line; the events themselves
+// stay put in a separate array.
+struct HeapKey {
+  double time;
+  unsigned int order;              // breaks ties in scheduling order
+  int event;
+};
+
+class HeapScheduler : public Scheduler {
+  std::vector<HeapKey> heap;
+  std::vector<Event> events;       // storage for all events
+  std::vector<int> free_events;
+  unsigned int next_order;
+  double bound_time;
+  
+ public:
+  HeapScheduler(int num_users);
 
   void schedule_event(void* target, double true_time, double internal_time,
                       int type, int uid);
-  // The bound is a governor intended to prevent the system from going too
-  // far ahead in a burst of pulls.  It is not intended for tight control
-  // of time evolution; events may not return when they are close to the
-  // bound (within 2*cycle_time/num_users seconds)
   void set_bound(double time);
-  // tests whether there's an event in the next cycle.  If so, removes the
-  // event from the queue, puts its contents in evt, and returns true
   int pop_next_event(Event *evt);
-  // There is no remove method: when a target dies, its events are
-  // left in the queue and should be discarded when they appear.
-  // This is because there are generally few events per target.
-  // UID is included to allow reuse of target memory for different targets.
 };
 
 #endif // __SCHEDULER__
@@ -15,15 +15,24 @@ using namespace std;
 /*****************************************************************************
  *  SIMULATED HARDWARE                                                       *
  *****************************************************************************/
-// globals managed by set_vm_context
-SimulatedHardware* hardware=NULL;
-Device* device=NULL;
-Machine* machine=NULL;
+// globals managed by set_vm_context and LegacyContext
+THREAD_LOCAL SimulatedHardware* hardware=NULL;
+THREAD_LOCAL Device* device=NULL;
+THREAD_LOCAL Machine* machine=NULL;
 
 Device* current_device() { return device; }
 SimulatedHardware* current_hardware() { return hardware; }
 Machine* current_machine() { return machine; }
 
+LegacyContext::LegacyContext(const VMContext& context) {
+  old_hardware = hardware; old_device = device; old_machine = machine;
+  hardware = context.hardware; device = context.device;
+  machine = context.device ? context.device->vm : NULL;
+}
+LegacyContext::~LegacyContext() {
+  hardware = old_hardware; device = old_device; machine = old_machine;
+}
+
 SimulatedHardware::SimulatedHardware() {
 //    std::cout << "SimulatedHardware base ptr: " << &base << std::endl;
   for(int i=0;i<NUM_HARDWARE_FNS;i++) patch_table[i]=&base;
@@ -58,13 +67,13 @@ int SimulatedHardware::registerOpcode(OpHandlerBase* opHandler) {
   return opHandler->opcode;
 }
 
-void SimulatedHardware::dispatchOpcode(uint8_t op) {
+void SimulatedHardware::dispatchOpcode(const VMContext& context, uint8_t op) {
   int ix = op - PLATFORM_OPCODE_OFFSET;
   if (ix < 0 || ix >= opHandlerCount) {
     // TODO Out-of-range should throw exception or something
     return;
   }
-  (*opHandlers[ix])(machine);
+  (*opHandlers[ix])(context.device->vm,context);
 }
 
 void SimulatedHardware::appendDefops(string& defops) {
@@ -91,7 +100,8 @@ void SimulatedHardware::dumpPatchTable()
   }
 }
 
-// This function sets the globals that connect it to a simulated device.
+// This function sets the globals that connect it to a simulated device,
+// for plugins that still use them instead of the VM's context.
 void SimulatedHardware::set_vm_context(Device* d) {
   hardware = this;
   device = d;
@@ -118,39 +128,62 @@ int is_script_debug_val = 0;
 
 void reinitHardware(void) { return; }
 
-void mov (Tuple val)
-{ hardware->patch_table[MOV_FN]->mov(val); }
-void flex (Number val) 
-{ hardware->patch_table[FLEX_FN]->flex(val); }
-void set_probe (Data d, uint8_t p) 
-{ hardware->patch_table[SET_PROBE_FN]->set_probe(d,p); }
-
-void set_dt (Number dt)
-{ hardware->patch_table[SET_DT_FN]->set_dt(dt);}
-
-Number read_radio_range () 
-{ return hardware->patch_table[READ_RADIO_RANGE_FN]->read_radio_range(); }
-Number read_bearing () 
-{ return hardware->patch_table[READ_BEARING_FN]->read_bearing(); }
-Number read_speed () 
-{ return hardware->patch_table[READ_SPEED_FN]->read_speed(); }
-
-int radio_send_export (uint8_t version, Array<Data> const & data) {
-  return hardware->patch_table[RADIO_SEND_EXPORT_FN]->
-    radio_send_export(version,data); 
+// The kernel passes the context of the VM making the call
+void mov (const VMContext& c, Tuple val)
+{ c.hardware->patch_table[MOV_FN]->mov(c,val); }
+void flex (const VMContext& c, Number val) 
+{ c.hardware->patch_table[FLEX_FN]->flex(c,val); }
+void set_probe (const VMContext& c, Data d, uint8_t p) 
+{ c.hardware->patch_table[SET_PROBE_FN]->set_probe(c,d,p); }
+
+void set_dt (const VMContext& c, Number dt)
+{ c.hardware->patch_table[SET_DT_FN]->set_dt(c,dt);}
+
+Number read_radio_range (const VMContext& c) 
+{ return c.hardware->patch_table[READ_RADIO_RANGE_FN]->read_radio_range(c); }
+Number read_bearing (const VMContext& c) 
+{ return c.hardware->patch_table[READ_BEARING_FN]->read_bearing(c); }
+Number read_speed (const VMContext& c) 
+{ return c.hardware->patch_table[READ_SPEED_FN]->read_speed(c); }
+
+int radio_send_export (const VMContext& c, uint8_t version,
+                       Imports const & data) {
+  return c.hardware->patch_table[RADIO_SEND_EXPORT_FN]->
+    radio_send_export(c,version,data); 
 }
-int radio_send_script_pkt (uint8_t version, uint16_t n, uint8_t pkt_num, 
-                           uint8_t *script) {
-return hardware->patch_table[RADIO_SEND_SCRIPT_PKT_FN]->
-  radio_send_script_pkt(version,n,pkt_num,script);
+int radio_send_script_pkt (const VMContext& c, uint8_t version, uint16_t n,
+                           uint8_t pkt_num, uint8_t *script) {
+return c.hardware->patch_table[RADIO_SEND_SCRIPT_PKT_FN]->
+  radio_send_script_pkt(c,version,n,pkt_num,script);
 }
-int radio_send_digest (uint8_t version, uint16_t script_len, uint8_t *digest) {
-  return hardware->patch_table[RADIO_SEND_DIGEST_FN]->
-    radio_send_digest(version,script_len,digest);
+int radio_send_digest (const VMContext& c, uint8_t version,
+                       uint16_t script_len, uint8_t *digest) {
+  return c.hardware->patch_table[RADIO_SEND_DIGEST_FN]->
+    radio_send_digest(c,version,script_len,digest);
 }
 
-extern void my_platform_operation(uint8_t op); 
-void platform_operation(uint8_t op) { my_platform_operation(op); }
+// Older callers rely on the globals set by set_vm_context
+static VMContext global_context() {
+  VMContext c; c.hardware = hardware; c.device = device; return c;
+}
+void mov (Tuple val) { mov(global_context(),val); }
+void flex (Number val) { flex(global_context(),val); }
+void set_probe (Data d, uint8_t p) { set_probe(global_context(),d,p); }
+void set_dt (Number dt) { set_dt(global_context(),dt); }
+Number read_radio_range () { return read_radio_range(global_context()); }
+Number read_bearing () { return read_bearing(global_context()); }
+Number read_speed () { return read_speed(global_context()); }
+int radio_send_export (uint8_t version, Imports const & data)
+{ return radio_send_export(global_context(),version,data); }
+int radio_send_script_pkt (uint8_t version, uint16_t n, uint8_t pkt_num, 
+                           uint8_t *script)
+{ return radio_send_script_pkt(global_context(),version,n,pkt_num,script); }
+int radio_send_digest (uint8_t version, uint16_t script_len, uint8_t *digest)
+{ return radio_send_digest(global_context(),version,script_len,digest); }
+
+extern void my_platform_operation(const VMContext& context, uint8_t op); 
+void platform_operation(const VMContext& context, uint8_t op)
+{ my_platform_operation(context,op); }
 
 /*****************************************************************************
  *  MEMORY MANAGEMENT                                                        *
@@ -20,8 +20,22 @@ void post_data_to(char * str, Data data);
 void post_stripped_data_to(char * str, Data data);
 void post_data(Data data);
 
+// LegacyContext binds the global hardware, device, and machine (below) to
+// a VMContext for as long as it exists.  This keeps plugins written
+// before the context was passed explicitly working.
+class LegacyContext {
+  SimulatedHardware* old_hardware; Device* old_device; Machine* old_machine;
+ public:
+  LegacyContext(const VMContext& context);
+  ~LegacyContext();
+};
+
 // HardwarePatch is a class that Layers should extend in order to make
 // their dynamics available to the kernel.
+// The functions that can be patched into a SimulatedHardware (see
+// HardwareFunction) are called with the context of the calling VM.  By
+// default, they call the older context-free versions within a
+// LegacyContext, so patches should override the versions taking a context.
 class HardwarePatch {
 public:
   void hardware_error(const char* name) {
@@ -83,7 +97,7 @@ public:
                                Number incr, Number min, Number max) 
   { hardware_error("read_slider"); return 0; }
   
-  virtual int radio_send_export (uint8_t version, Array<Data> const & data)
+  virtual int radio_send_export (uint8_t version, Imports const & data)
   { hardware_error("radio_send_export"); return 0; }
   virtual int radio_send_script_pkt (uint8_t version, uint16_t n, 
                                       uint8_t pkt_num, uint8_t *script) 
@@ -91,6 +105,32 @@ public:
   virtual int radio_send_digest (uint8_t version, uint16_t script_len, 
                                  uint8_t *digest) 
   { hardware_error("radio_send_digest"); return 0; }
+
+  // patchable functions, called with the context of the calling VM
+  virtual void mov (const VMContext& c, Tuple val)
+  { LegacyContext l(c); mov(val); }
+  virtual void flex (const VMContext& c, Number val)
+  { LegacyContext l(c); flex(val); }
+  virtual void set_probe (const VMContext& c, Data d, uint8_t p)
+  { LegacyContext l(c); set_probe(d,p); }
+  virtual Number set_dt (const VMContext& c, Number dt)
+  { LegacyContext l(c); return set_dt(dt); }
+  virtual Number read_radio_range (const VMContext& c)
+  { LegacyContext l(c); return read_radio_range(); }
+  virtual Number read_bearing (const VMContext& c)
+  { LegacyContext l(c); return read_bearing(); }
+  virtual Number read_speed (const VMContext& c)
+  { LegacyContext l(c); return read_speed(); }
+  virtual int radio_send_export (const VMContext& c, uint8_t version,
+                                 Imports const & data)
+  { LegacyContext l(c); return radio_send_export(version,data); }
+  virtual int radio_send_script_pkt (const VMContext& c, uint8_t version,
+                                     uint16_t n, uint8_t pkt_num,
+                                     uint8_t *script)
+  { LegacyContext l(c); return radio_send_script_pkt(version,n,pkt_num,script); }
+  virtual int radio_send_digest (const VMContext& c, uint8_t version,
+                                 uint16_t script_len, uint8_t *digest)
+  { LegacyContext l(c); return radio_send_digest(version,script_len,digest); }
 };
 
 // A list of all the functions that can be supplied with a HardwarePatch,
@@ -108,25 +148,42 @@ enum HardwareFunction {
   NUM_HARDWARE_FNS
 };
 
+// An OpHandler implements a platform opcode with a member function of a
+// Layer, which is given the machine executing it and that machine's context.
+// Functions taking only the machine are still accepted: they are called
+// within a LegacyContext.  Likewise, handlers that override only the older
+// operator()(Machine*) are still called, through the default below.
 class OpHandlerBase {
  public:
+  virtual ~OpHandlerBase() {}
   virtual void operator()(Machine* machine){}
+  virtual void operator()(Machine* machine, const VMContext& context)
+  { LegacyContext l(context); (*this)(machine); }
   int opcode;
   const char* defop;
 };
 
 template <class Tclass> class OpHandler : public OpHandlerBase {
  private:
-  void (Tclass::*fnp)(Machine* machine);
+  void (Tclass::*fnp)(Machine* machine, const VMContext& context);
+  void (Tclass::*legacy_fnp)(Machine* machine);
   Tclass* pThis;
  public:
+  OpHandler(Tclass* _pThis,
+            void (Tclass::*_fnp)(Machine* machine, const VMContext& context),
+            const char* _defop) {
+    fnp = _fnp; legacy_fnp = NULL;
+    pThis = _pThis;
+    defop = _defop;
+  }
   OpHandler(Tclass* _pThis, void (Tclass::*_fnp)(Machine* machine), const char* _defop) {
-    fnp = _fnp;
+    fnp = NULL; legacy_fnp = _fnp;
     pThis = _pThis;
     defop = _defop;
   }
-  virtual void operator()(Machine* machine) {
-    (*pThis.*fnp)(machine);
+  virtual void operator()(Machine* machine, const VMContext& context) {
+    if(fnp) { (*pThis.*fnp)(machine,context); }
+    else { LegacyContext l(context); (*pThis.*legacy_fnp)(machine); }
   }
 };
 
@@ -147,18 +204,20 @@ public:
   vector<const char*> requiredOpcodes;
   SimulatedHardware();
   void patch(HardwarePatch* p, HardwareFunction fn); // instantiate a fn
-  void set_vm_context(Device* d); // prepare globals for kernel execution
+  void set_vm_context(Device* d); // prepare globals for older plugins
   void dumpPatchTable();
   int registerOpcode(OpHandlerBase* opHandler);
-  void dispatchOpcode(uint8_t op);
+  void dispatchOpcode(const VMContext& context, uint8_t op);
   void appendDefops(string& defops);
 };
 
-// globals that carry the VM context for kernel hardware calls
-// HardwarePatch classes can count on them being set to correct values
-extern SimulatedHardware* hardware;
-extern Device* device;
-extern Machine* machine;
+// globals that carried the VM context for kernel hardware calls before
+// it was passed explicitly.  They are kept set for older plugins: to the
+// device being run, and within a LegacyContext.
+// Each thread has its own, so devices can be run in parallel (see -threads).
+extern THREAD_LOCAL SimulatedHardware* hardware;
+extern THREAD_LOCAL Device* device;
+extern THREAD_LOCAL Machine* machine;
 
 Device* current_device();
 SimulatedHardware* current_hardware();
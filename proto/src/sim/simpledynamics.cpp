@@ -7,7 +7,10 @@ the GNU General Public License, with a linking exception, as described
 in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "config.h"
+#include <string.h>
+#include <limits>
 #include "simpledynamics.h"
+#include "dumpfile.h"
 #include "visualizer.h"
 
 /*****************************************************************************
@@ -101,7 +104,10 @@ static flo w[3] = {0,0,0}; // null angular velocity vector
 const flo* SimpleBody::orientation() {return q; }
 const flo* SimpleBody::ang_velocity() { return w; }
 
-SimpleBody::~SimpleBody() { parent->bodies.remove(parloc); }
+SimpleBody::~SimpleBody() {
+  set_velocity(0,0,0); // a free slot must not move
+  parent->bodies.remove(parloc);
+}
 
 void SimpleBody::preupdate() { set_velocity(0,0,0); }
 
@@ -112,7 +118,7 @@ void SimpleBody::visualize() {
   if(!parent->is_show_bot) return; // don't display unless should be shown
   palette->use_color(SimpleDynamics::SIMPLE_BODY);
   glPushMatrix();
-  glScalef(radius, radius, radius);
+  glScalef(radius(), radius(), radius());
   if (parent->is_mobile) {
     glLineWidth(2);
     if (parent->parent->volume->dimensions()==3) {
@@ -129,7 +135,7 @@ void SimpleBody::visualize() {
     if (parent->is_show_heading) {
       glBegin(GL_LINES);
       glVertex2f(0, 0);
-      Vek vec(v); 
+      Vek vec(velocity()); 
       flo l=vek_len(&vec);
       if(l>0) vek_mul(&vec,1/l); // normalize vel
       glVertex3f(vec.x, vec.y, vec.z);
@@ -147,7 +153,7 @@ void SimpleBody::visualize() {
 void SimpleBody::render_selection() {
 #ifdef WANT_GLUT
   flo x, y;
-  glScalef(radius, radius, radius);
+  glScalef(radius(), radius(), radius());
   if (parent->parent->volume->dimensions()==3) {
     glPushMatrix();
     glRotatef(90.0, 1.0, 0.0, 0.0);
@@ -163,6 +169,7 @@ void SimpleBody::render_selection() {
 }
 
 void SimpleBody::dump_state(FILE* out, int verbosity) {
+  const flo *p = position(), *v = velocity(); flo radius = this->radius();
   if(verbosity==0) {
     if(parent->dumpmask & 0x01) fprintf(out," %.2f",p[0]);
     if(parent->dumpmask & 0x02) fprintf(out," %.2f",p[1]);
@@ -179,6 +186,17 @@ void SimpleBody::dump_state(FILE* out, int verbosity) {
   }
 }
 
+void SimpleBody::dump_values(DumpWriter* out) {
+  const flo *p = position(), *v = velocity(); flo radius = this->radius();
+  if(parent->dumpmask & 0x01) out->put(p[0],2);
+  if(parent->dumpmask & 0x02) out->put(p[1],2);
+  if(parent->dumpmask & 0x04) out->put(p[2],2);
+  if(parent->dumpmask & 0x08) out->put(v[0],2);
+  if(parent->dumpmask & 0x10) out->put(v[1],2);
+  if(parent->dumpmask & 0x20) out->put(v[2],2);
+  if(parent->dumpmask & 0x40) out->put(radius,2);
+}
+
 /*****************************************************************************
  *  BOUNDARIES                                                               *
  *****************************************************************************/
@@ -244,6 +262,11 @@ SimpleDynamics::SimpleDynamics(Args* args, SpatialComputer* parent, int n)
   parent->hardware.registerOpcode(new OpHandler<SimpleDynamics>(this, &SimpleDynamics::radius_set_op, "radius-set scalar scalar"));
   parent->hardware.registerOpcode(new OpHandler<SimpleDynamics>(this, &SimpleDynamics::radius_get_op, "radius scalar"));
   parent->hardware.registerOpcode(new OpHandler<SimpleDynamics>(this, &SimpleDynamics::wall_bump_op, "wall-bump scalar"));
+  blocks.reserve(n/BODY_BLOCK+1);
+}
+
+SimpleDynamics::~SimpleDynamics() {
+  for(size_t i=0;i<blocks.size();i++) delete blocks[i];
 }
 
 Color* SimpleDynamics::SIMPLE_BODY;
@@ -253,16 +276,16 @@ void SimpleDynamics::register_colors() {
 #endif
 }
 
-void SimpleDynamics::radius_set_op(Machine* machine) {
-  radius_set(machine->stack.peek(0).asNumber());
+void SimpleDynamics::radius_set_op(Machine* machine, const VMContext& context) {
+  radius_set(context.device,machine->stack.peek(0).asNumber());
 }
 
-void SimpleDynamics::radius_get_op(Machine* machine) {
-  machine->stack.push(radius_get());
+void SimpleDynamics::radius_get_op(Machine* machine, const VMContext& context) {
+  machine->stack.push(radius_get(context.device));
 }
 
-void SimpleDynamics::wall_bump_op(Machine* machine) {
-  bool bump = ((SimpleBody*)device->body)->wall_touch;
+void SimpleDynamics::wall_bump_op(Machine* machine, const VMContext& context) {
+  bool bump = ((SimpleBody*)context.device->body)->wall_touch();
   machine->stack.push(bump);
 }
 
@@ -291,8 +314,12 @@ void SimpleDynamics::visualize() {
 }
 
 Body* SimpleDynamics::new_body(Device* d, flo x, flo y, flo z) {
-  SimpleBody* b = new SimpleBody(this,d,x,y,z,body_radius);
-  b->parloc = bodies.add(b);
+  SimpleBody* b = new SimpleBody(this,d);
+  int i = b->parloc = bodies.add(b);
+  while(blocks.size()*BODY_BLOCK<=(size_t)i) // a new slot, beyond the blocks so far
+    blocks.push_back(new Block()); // zeroed
+  b->set_position(x,y,z); b->set_velocity(0,0,0);
+  b->radius() = body_radius; block(i)->touch[i%BODY_BLOCK] = false;
   return b;
 }
 
@@ -315,46 +342,138 @@ void SimpleDynamics::dump_header(FILE* out) {
 // Note: although the old sim-bot physics spoke of force, they act only at
 //  the level of velocity.  
 
-// in simple dynamics, just step based on velocity and position
+// Evolution runs as a single kernel, sweeping once over each block of
+// bodies: each body's step is worked out and added to its position
+// without being stored in between.  With GCC, each body's x,y,z,0 is one
+// group of SIMD lanes; otherwise the lanes are stepped through one at a
+// time.  Either way they compute exactly what stepping one body at a time
+// would.
 #define K_BOUND   0.75  // restoring force from walls
+
+#ifdef __GNUC__
+typedef flo Lanes __attribute__((vector_size(4*sizeof(flo)),
+                                 aligned(sizeof(flo)), may_alias));
+// the wall force is rounded from doubles, so it is worked out in these
+typedef double WideLanes __attribute__((vector_size(4*sizeof(double))));
+typedef int32_t Mask __attribute__((vector_size(4*sizeof(int32_t))));
+static inline Lanes splat(flo x) { Lanes v = {x,x,x,x}; return v; }
+static inline Lanes& lanes_at(flo* a, int i)
+{ return *reinterpret_cast<Lanes*>(&a[4*i]); }
+static inline const Lanes& lanes_at(const flo* a, int i)
+{ return *reinterpret_cast<const Lanes*>(&a[4*i]); }
+#endif
+
+// Each body's step is its velocity, perturbed by actuation error and
+// limited in speed, times dt; bodies beyond a wall are pushed back
+// (lo and hi are the west, south and bottom walls and the east, north
+// and top walls, or NULL without walls).  The step is then added to the
+// position, noting which bodies moved; returns how many did.
+static int evolve_kernel(int n, flo* pos, const flo* vel, const flo* noise,
+                          flo act_err, flo speed_lim, SECONDS dt,
+                          const flo* lo, const flo* hi, bool is_2d,
+                          bool is_hard_floor, uint8_t* touch,
+                          uint8_t* moved) {
+  flo lim_sqr = speed_lim*speed_lim, fdt = dt;
+  int n_moved = 0;
+#ifdef __GNUC__
+  // the w lane is never beyond a wall, and its step stays 0
+  const flo inf = std::numeric_limits<flo>::infinity();
+  Lanes lov = splat(-inf), hiv = splat(inf), xyz = {1,1,1,0}, z = {0,0,1,0};
+  if(lo) for(int j=0;j<3;j++) { lov[j] = lo[j]; hiv[j] = hi[j]; }
+  WideLanes k_bound = {K_BOUND,K_BOUND,K_BOUND,K_BOUND}, dtv = {dt,dt,dt,dt};
+#endif
+  for(int i=0;i<n;i++) {
+#ifdef __GNUC__
+    Lanes s = lanes_at(vel,i), sqr = s*s;
+    flo len = 0; len += sqr[0]; len += sqr[1]; len += sqr[2];
+    flo k = (len > lim_sqr) ? speed_lim/sqrt(len) : 1; // limit velocity
+    if(noise) {
+      const flo* e = &noise[3*i]; flo a = len*act_err;
+      Lanes ev = {e[0],e[1],e[2],0};
+      s = (s + splat(a)*ev)*splat(k)*splat(fdt);
+      s = (xyz != 0) ? s : splat(0);
+    } else {
+      s = s*splat(k)*splat(fdt);
+    }
+    touch[i] = false;
+    if(lo) {
+      Lanes pv = lanes_at(pos,i);
+      Lanes over = pv-hiv, under = pv-lov; // the -d of each wall's test
+      Mask beyond = (over > 0) | (under < 0);
+      if(beyond[0] | beyond[1] | beyond[2]) { // rare, so worked out apart
+        WideLanes wover = __builtin_convertvector(over,WideLanes);
+        WideLanes wunder = __builtin_convertvector(under,WideLanes);
+        Lanes push_hi = __builtin_convertvector(wover*k_bound*dtv,Lanes);
+        Lanes push_lo = __builtin_convertvector(-wunder*k_bound*dtv,Lanes);
+        s = (over > 0) ? s-push_hi : s;
+        s = (under < 0) ? s+push_lo : s;
+        touch[i] = true;
+      }
+    }
+    Mask nonzero = (s != 0);
+    moved[i] = (nonzero[0] | nonzero[1] | nonzero[2]) != 0;
+    Lanes p = lanes_at(pos,i) + s;
+    if(is_2d) { p = (z != 0) ? splat(0) : p; }
+    // Hard floor at z=0: if the calculated pos has z < 0, reset to 0
+    else if(is_hard_floor && p[2]<0) { p[2]=0; moved[i]=true; }
+    lanes_at(pos,i) = p;
+#else
+    const flo* v = &vel[4*i]; flo* p = &pos[4*i];
+    flo len = 0; len += v[0]*v[0]; len += v[1]*v[1]; len += v[2]*v[2];
+    flo k = (len > lim_sqr) ? speed_lim/sqrt(len) : 1; // limit velocity
+    flo s[4];
+    if(noise) {
+      const flo* e = &noise[3*i]; flo a = len*act_err;
+      for(int j=0;j<3;j++) s[j] = (v[j] + a*e[j])*k*fdt;
+      s[3] = 0;
+    } else {
+      for(int j=0;j<4;j++) s[j] = v[j]*k*fdt;
+    }
+    bool t = false;
+    if(lo) {
+      for(int j=0;j<3;j++) {
+        flo d = -(p[j]-hi[j]);
+        if(d < 0.0) { s[j] -= (flo)(-d * K_BOUND * dt); t = true; }
+        d = p[j]-lo[j];
+        if(d < 0.0) { s[j] += (flo)(-d * K_BOUND * dt); t = true; }
+      }
+    }
+    touch[i] = t;
+    moved[i] = (s[0]!=0) | (s[1]!=0) | (s[2]!=0);
+    for(int j=0;j<4;j++) p[j] += s[j];
+    if(is_2d) { p[2]=0; }
+    // Hard floor at z=0: if the calculated pos has z < 0, reset to 0
+    else if(is_hard_floor && p[2]<0) { p[2]=0; moved[i]=true; }
+#endif
+    n_moved += moved[i];
+  }
+  return n_moved;
+}
+
+// in simple dynamics, just step based on velocity and position
 bool SimpleDynamics::evolve(SECONDS dt) {
   if(!is_mobile) return false;
-  for(int i=0;i<bodies.max_id();i++) {
-    Body* b = (Body*)bodies.get(i);
-    if(b) { 
-      // device moves itself
-      Vek dp(b->velocity());
-      flo len = vek_dot(&dp,&dp);
-      if(act_err) {
-        dp.x += len*act_err*urnd(-0.5,0.5); 
-        dp.y += len*act_err*urnd(-0.5,0.5); 
-        dp.z += len*act_err*urnd(-0.5,0.5);
-      }
-      if (len > speed_lim*speed_lim) vek_mul(&dp,speed_lim/sqrt(len)); // limit velocity
-      vek_mul(&dp,dt);
-      // device is moved by walls
-      ((SimpleBody*)b)->wall_touch = false;
-      if (is_walls) {
-	for (int j=0; j<N_WALLS; j++) {
-	  Vek vec(b->position());
-	  vek_sub(&vec, &walls[j]);
-	  flo d = vek_dot(&vec, wall_normals[j]);
-	  if (d < 0.0) {
-	    vek_cpy(&vec, wall_normals[j]);
-	    vek_mul(&vec, -d * K_BOUND * dt);
-	    vek_add(&dp, &vec);
-            ((SimpleBody*)b)->wall_touch = true;
-	  }
-	}
+  int n = bodies.max_id();
+  if(!n) return true;
+  if(act_err) { // draw errors for the live bodies, in order of parloc
+    act_noise.resize(3*n);
+    for(int i=0;i<n;i++)
+      if(bodies.get(i)) rng.fill(&act_noise[3*i],3,-0.5,0.5);
+  }
+  flo lo[3] = { walls[3].x, walls[1].y, walls[5].z }; // W, S, bottom
+  flo hi[3] = { walls[2].x, walls[0].y, walls[4].z }; // E, N, top
+  for(int first=0;first<n;first+=BODY_BLOCK) {
+    Block* k = block(first); int m = std::min(n-first,BODY_BLOCK);
+    int left = evolve_kernel(m,k->pos,k->vel,act_err?&act_noise[3*first]:NULL,act_err,
+                  speed_lim,dt,is_walls?lo:NULL,hi,
+                  parent->volume->dimensions()==2,is_hard_floor,k->touch,
+                  k->moved);
+    // hand the moved-mask to the bodies, stopping after the last that moved
+    for(int i=0;left && i<m;i++) {
+      if(k->moved[i]) {
+        Body* b = (Body*)bodies.get(first+i); if(b) b->moved = true;
+        left--;
       }
-      // adjust the position
-      Vek pos(b->position());
-      b->moved = (dp.x||dp.y||dp.z);
-      vek_add(&pos,&dp);
-      if(parent->volume->dimensions()==2) { pos.z=0; }
-      // Hard floor at z=0: if the calculated pos has z < 0, reset to 0
-      else if(is_hard_floor && pos.z<0) { pos.z=0; b->moved=true; }
-      b->set_position(pos.x,pos.y,pos.z);
     }
   }
   return true;
@@ -362,14 +481,14 @@ bool SimpleDynamics::evolve(SECONDS dt) {
 
 
 // There is no subtlety here: mov just sets velocity directly
-void SimpleDynamics::mov(Tuple v) {
+void SimpleDynamics::mov(const VMContext& c, Tuple v) {
   flo x = v[0].asNumber();
   flo y = v[1].asNumber();
   flo z = v.size() > 2 ? v[2].asNumber() : 0;
-  device->body->set_velocity(x,y,z);
+  c.device->body->set_velocity(x,y,z);
 }
 // sensing & actuation of body radius
-Number SimpleDynamics::radius_set (Number val)
-{ return ((SimpleBody*)device->body)->radius = val; }
-Number SimpleDynamics::radius_get () 
-{ return ((SimpleBody*)device->body)->radius; }
+Number SimpleDynamics::radius_set (Device* d, Number val)
+{ return ((SimpleBody*)d->body)->radius() = val; }
+Number SimpleDynamics::radius_get (Device* d) 
+{ return ((SimpleBody*)d->body)->radius(); }
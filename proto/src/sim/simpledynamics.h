@@ -13,6 +13,8 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 class SimpleDynamics;
 
+#define BODY_BLOCK 1024 // bodies whose state is allocated together
+
 /* These math-related declarations are a kludgey holdover and need neatening */
 #define N_WALLS 6
 struct Vek {
@@ -26,36 +28,38 @@ typedef Vek Point;
 /*****************************************************************************
  *  SIMPLE BODY                                                              *
  *****************************************************************************/
+// A SimpleBody is only a handle: its state lives in its SimpleDynamics,
+// in arrays shared with all the other bodies.
 class SimpleBody : public Body {
   friend class SimpleDynamics;
  protected:
-  SimpleDynamics* parent; int parloc; // back pointers
-  flo p[3],v[3]; // position, velocity, force
-  flo radius; // bodies are spherical
-  bool wall_touch; // is the device currently being affected by a wall?
+  SimpleDynamics* parent; int parloc; // back pointers; parloc indexes state
   
  public:
-  const flo* position() { return p; }
-  const flo* velocity() { return v; }
-  void set_position(flo x, flo y, flo z) { p[0]=x; p[1]=y; p[2]=z; }
-  void set_velocity(flo dx, flo dy, flo dz)  { v[0]=dx; v[1]=dy; v[2]=dz; }
+  // position() and velocity() point into a block of the SimpleDynamics,
+  // which stays in place for as long as the body exists
+  inline const flo* position();
+  inline const flo* velocity();
+  inline void set_position(flo x, flo y, flo z);
+  inline void set_velocity(flo dx, flo dy, flo dz);
   // simple bodies don't have an orientation or angular velocity
   const flo* orientation();
   const flo* ang_velocity();
   void set_orientation(const flo *q) {}
   void set_ang_velocity(flo dx, flo dy, flo dz) {}
-  flo display_radius() { return radius; }
+  inline flo display_radius();
+  inline flo& radius(); // bodies are spherical
+  inline bool wall_touch(); // is the body currently affected by a wall?
   
-  SimpleBody(SimpleDynamics *parent, Device* container, flo x, flo y, 
-             flo z, flo r) : Body(container) { 
+  SimpleBody(SimpleDynamics *parent, Device* container) : Body(container) { 
     this->parent=parent; moved=false; 
-    set_position(x,y,z); set_velocity(0,0,0); radius=r; wall_touch = false;
   }
   ~SimpleBody();
   void preupdate();
   void visualize();
   void render_selection();
   void dump_state(FILE* out, int verbosity); // print state to file
+  void dump_values(DumpWriter* out); // the same, for binary dumps
 };
 
 /*****************************************************************************
@@ -68,7 +72,22 @@ class SimpleDynamics : public BodyDynamics, HardwarePatch {
   Population bodies;
   flo body_radius;
   flo act_err; // fraction by which actuation varies
+  std::vector<flo> act_noise; // per-step actuation errors, 3 per body
   Point walls[N_WALLS];
+  // The state of each body is kept at its parloc in these arrays, so that
+  // evolve can sweep through many bodies at once.  Positions and
+  // velocities take 4 floats (x, y, z and an unused 0): each body's then
+  // fits one SIMD register, and position() can still point at its x,y,z.
+  // The arrays are cut into blocks that are never moved once allocated,
+  // so adding bodies (e.g. by cloning) leaves the others' state in place.
+  struct Block {
+    flo pos[4*BODY_BLOCK], vel[4*BODY_BLOCK];
+    flo radii[BODY_BLOCK];
+    uint8_t touch[BODY_BLOCK];  // is a wall affecting the body?
+    uint8_t moved[BODY_BLOCK];  // did the body move in this evolve?
+  };
+  std::vector<Block*> blocks;
+  inline Block* block(int parloc) { return blocks[parloc/BODY_BLOCK]; }
 
  public:
   bool is_show_heading; // heading direction tick
@@ -80,14 +99,16 @@ class SimpleDynamics : public BodyDynamics, HardwarePatch {
   uint32_t dumpmask;
   
   SimpleDynamics(Args* args, SpatialComputer* parent,int n);
+  ~SimpleDynamics();
   bool evolve(SECONDS dt);
   bool handle_key(KeyEvent* key);
   void visualize();
   Body* new_body(Device* d, flo x, flo y, flo z);
   void dump_header(FILE* out); // list log-file fields
+  bool is_thread_safe() { return true; }
 
   // hardware emulation
-  void mov(Tuple val);
+  void mov(const VMContext& c, Tuple val);
 
   // returns a list of function  that it patches/ provides impementation for
   static vector<HardwareFunction> getImplementedHardwareFunctions();
@@ -95,15 +116,34 @@ class SimpleDynamics : public BodyDynamics, HardwarePatch {
   static Color* SIMPLE_BODY;
   virtual void register_colors();
  private:
-  void radius_set_op(Machine* machine);
-  void radius_get_op(Machine* machine);
-  Number radius_set (Number val);
-  Number radius_get ();
-  void wall_bump_op(Machine* machine);
+  void radius_set_op(Machine* machine, const VMContext& context);
+  void radius_get_op(Machine* machine, const VMContext& context);
+  Number radius_set (Device* d, Number val);
+  Number radius_get (Device* d);
+  void wall_bump_op(Machine* machine, const VMContext& context);
   
   // not yet implemented:
   //Tuple read_ranger (VOID);
   //Number read_bump (VOID);
 };
 
+const flo* SimpleBody::position()
+{ return &parent->block(parloc)->pos[4*(parloc%BODY_BLOCK)]; }
+const flo* SimpleBody::velocity()
+{ return &parent->block(parloc)->vel[4*(parloc%BODY_BLOCK)]; }
+void SimpleBody::set_position(flo x, flo y, flo z) {
+  flo* p = &parent->block(parloc)->pos[4*(parloc%BODY_BLOCK)];
+  p[0]=x; p[1]=y; p[2]=z;
+}
+void SimpleBody::set_velocity(flo dx, flo dy, flo dz) {
+  flo* v = &parent->block(parloc)->vel[4*(parloc%BODY_BLOCK)];
+  v[0]=dx; v[1]=dy; v[2]=dz;
+}
+flo SimpleBody::display_radius()
+{ return parent->block(parloc)->radii[parloc%BODY_BLOCK]; }
+flo& SimpleBody::radius()
+{ return parent->block(parloc)->radii[parloc%BODY_BLOCK]; }
+bool SimpleBody::wall_touch()
+{ return parent->block(parloc)->touch[parloc%BODY_BLOCK]; }
+
 #endif //__SIMPLEDYNAMICS__
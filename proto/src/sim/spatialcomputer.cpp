@@ -14,20 +14,20 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #include <sys/types.h>
 #include <machine.hpp>
 #include "spatialcomputer.h"
+#include "dumpfile.h"
+#include "vmtrace.h"
 #include "visualizer.h"
 #include "plugin_manager.h"
+#include "proto_native.h"
 #include "DefaultsPlugin.h"
 
-extern map<string,uint8_t> OPCODE_MAP;
-
 /*****************************************************************************
  *  DEVICE                                                                   *
  *****************************************************************************/
-int Device::top_uid=0; // originally, the device UIDs start at zero
-
 Device::Device(SpatialComputer* parent, METERS *loc, DeviceTimer *timer) { 
-  uid=top_uid++; this->timer = timer; this->parent = parent;
+  uid=parent->next_uid++; this->timer = timer; this->parent = parent;
   run_time=0;  // should be reset at script-load
+  broadcasts=0;
   body = parent->physics->new_body(this,loc[0],loc[1],loc[2]);
   // integrate w. layers, which may add devicelayers to the device
   num_layers = parent->dynamics.max_id();
@@ -36,6 +36,9 @@ Device::Device(SpatialComputer* parent, METERS *loc, DeviceTimer *timer) {
     { Layer* l = (Layer*)parent->dynamics.get(i); if(l) l->add_device(this); }
   //vm = allocate_machine(); // unusable until script is loaded
   vm = new Machine();
+  rng = parent->device_stream(uid);
+  vm->random.seed((Int)rng.next());
+  vm->context.hardware = &parent->hardware; vm->context.device = this;
   is_selected=false; is_debug=false;
   if (parent->print_stack_id == uid) {
 	  is_print_stack = true;
@@ -47,6 +50,10 @@ Device::Device(SpatialComputer* parent, METERS *loc, DeviceTimer *timer) {
   } else {
 	  is_print_env_stack = false;
   }
+  trace = (parent->trace_vm_id == uid) ?
+    new VMTrace(uid,parent->trace_vm_length,parent->trace_vm_file,
+                instruction_names) : NULL;
+  is_settled=false; ran_volatile=false; settled_hood_size=0;
 }
 
 // copy all state
@@ -82,6 +89,7 @@ Device::~Device() {
   free(layers);
   //deallocate_machine(&vm);
   delete vm;
+  if(trace) delete trace; // writes it out
 }
 
 // dump function should produce matlab-readable data at verbosity 0
@@ -160,35 +168,160 @@ void Device::dump_state(FILE* out, int verbosity) {
   if(verbosity==0) fprintf(out,"\n"); // terminate line
 }
 
+// is d a number or a tuple of them? if so, collect all its numbers
+static bool flatten_numbers(Data d, vector<double>& out) {
+  if(d.type()==Data::Type_number) { out.push_back(d.asNumber()); return true; }
+  if(d.type()!=Data::Type_tuple) return false;
+  for(size_t i=0;i<d.asTuple().size();i++)
+    if(!flatten_numbers(d.asTuple()[i],out)) return false;
+  return true;
+}
+
+// the same fields as dump_state(out,0), for binary dumps
+void Device::dump_values(DumpWriter* out) {
+  out->begin_device();
+  out->put(uid,0); out->put(1.0f/*ticks*/,2); out->put(vm->startTime(),2);
+  if(parent->physics->can_dump) body->dump_values(out);
+  for(int i=0;i<num_layers;i++) {
+    DeviceLayer* d = (DeviceLayer*)layers[i]; 
+    Layer* l = (Layer*)parent->dynamics.get(i);
+    if(d && l->can_dump) d->dump_values(out);
+  }
+  if(parent->is_dump_value) {
+    vector<double> nums;
+    if(flatten_numbers(vm->threads[0].result,nums)) {
+      out->put_value(nums.empty() ? NULL : &nums[0],nums.size());
+    } else {
+      char buf[1000];
+      post_stripped_data_to(buf, vm->threads[0].result);
+      out->put_value_text(buf);
+    }
+  }
+  if(parent->is_dump_network) {
+    out->put_neighbor_count(vm->hood.size());
+    for(NeighbourHood::iterator i=vm->hood.begin(); i != vm->hood.end(); i++)
+      out->put_neighbor((*i).id);
+  }
+}
+
 void Device::load_script(uint8_t const * script, int len) {
   //new_machine(vm, uid, 0, 0, 0, 1, script, len);
   vm->id = uid;
+  // copy the computer's installed script if we can, unless the
+  // installation is to be traced
+  Machine* image = parent->script_image;
+  if(image && (uint8_t const *)image->currentScript()==script && !trace &&
+     !is_print_stack && !is_print_env_stack) {
+    vm->install(*image); return;
+  }
   vm->install(Script(script,len));
   int iStep = 0;
-  while(!vm->finished()) {
-	 	if (is_print_stack || is_print_env_stack) {
-	    	Int8 opcode = *(vm->instruction_pointer);
-	    	cout << "OpCode: " << (int)opcode;
-	    	Instruction i = instructions[opcode];
-	   		map<string,uint8_t>::iterator it;
-	   		for ( it=OPCODE_MAP.begin() ; it != OPCODE_MAP.end(); it++ ) {
-	   			if ((*it).second == opcode) {
-	   				cout << " " << (*it).first;
-    				break;
-	   			}
-	   		}
-	 	}
-	 	if (is_print_stack) {
-	 		cout << " Stack (" << iStep << "): ";
-	 		vm->print_stack(&vm->stack);
-	    }
-	 	if (is_print_env_stack) {
-	   	  cout << " Environment Stack (" << iStep << "): ";
-	   	  vm->print_stack(&vm->environment);
-	   	}
-     	iStep++;
-	    vm->step();
+  run_vm(&iStep);
+}
+
+// The tracer for -print-stack and -print-env-stack, which prints each
+// instruction and the stacks before it (and feeds any -trace-vm too)
+struct StackPrinter {
+  Device* d; int step;
+  StackPrinter(Device* d, int step) { this->d=d; this->step=step; }
+  void operator()(Machine& m) {
+    Int8 opcode = *m.instruction_pointer;
+    cout << "OpCode: " << (int)opcode;
+    if(instruction_names[opcode]) cout << " " << instruction_names[opcode];
+    if (d->is_print_stack) {
+      cout << " Stack (" << step << "): ";
+      m.print_stack(&m.stack);
+    }
+    if (d->is_print_env_stack) {
+      cout << " Environment Stack (" << step << "): ";
+      m.print_stack(&m.environment);
+    }
+    step++;
+    if(d->trace) (*d->trace)(m);
+  }
+};
+
+// The tracer for -native, which runs the native block starting at the
+// next instruction in its place, unless one of the block's inputs is not
+// a number (then the bytecode runs, and computes the same thing)
+struct NativeRunner {
+  const uint8_t* script; const ProtoNativeBlock* const* blocks;
+  NativeRunner(const uint8_t* script, const ProtoNativeBlock* const* blocks)
+    { this->script=script; this->blocks=blocks; }
+  void operator()(Machine& m) {
+    const ProtoNativeBlock* b;
+    while((b = blocks[(Int8 const *)m.instruction_pointer - script]) && run(m,b))
+      m.instruction_pointer = Address(script + b->end);
+  }
+  bool run(Machine& m, const ProtoNativeBlock* b) {
+    Number in[PROTO_NATIVE_MAX_IO], out[PROTO_NATIVE_MAX_IO];
+    for(int i=0;i<b->n_in;i++) {
+      uint32_t input = b->inputs[i]; Index index = PROTO_NATIVE_INDEX(input);
+      const Data& d =
+        (PROTO_NATIVE_KIND(input)==PROTO_NATIVE_STACK) ? m.stack.peek(index) :
+        (PROTO_NATIVE_KIND(input)==PROTO_NATIVE_ENV) ?
+        m.environment.peek(index) : m.globals[index];
+      if(d.type()!=Data::Type_number) return false;
+      in[i] = d.asNumber();
+    }
+    b->run(in,out);
+    m.stack.pop(b->n_pop);
+    for(int i=0;i<b->n_out;i++) m.stack.push(out[i]);
+    for(int i=0;i<b->n_let;i++) m.environment.push(out[b->n_out+i]);
+    return true;
+  }
+};
+
+// The tracer for -quiescent, which notes whether a run executes any of
+// the instructions that read time, randomness or sensors (running the
+// -native blocks on its way, if there are any)
+struct VolatileWatcher {
+  const bool* ops; NativeRunner* native; bool seen;
+  VolatileWatcher(const bool* ops, NativeRunner* native)
+    { this->ops=ops; this->native=native; seen=false; }
+  void operator()(Machine& m) {
+    if(native) (*native)(m);
+    if(ops[(uint8_t)*m.instruction_pointer]) seen=true;
+  }
+};
+
+// Each way of tracing is its own instantiation of the VM's run loop, so
+// the devices that are not traced run without any tracing checks.
+void Device::run_vm(int* print_step) {
+  if(trace) trace->begin_run();
+  bool native = parent->native_script &&
+    (uint8_t const *)vm->currentScript()==parent->native_script;
+  if(is_print_stack || is_print_env_stack) {
+    StackPrinter printer(this,*print_step);
+    vm->run_to_completion(printer);
+    *print_step = printer.step;
+    ran_volatile = true; // not watched, so never skipped
+  } else if(trace) {
+    vm->run_to_completion(*trace);
+    ran_volatile = true;
+  } else if(parent->is_quiescent) {
+    VolatileWatcher watcher(parent->volatile_ops,NULL);
+    if(native) {
+      NativeRunner runner(parent->native_script,&parent->native_blocks[0]);
+      watcher.native = &runner;
+      vm->run_to_completion(watcher);
+    } else {
+      vm->run_to_completion(watcher);
     }
+    if(watcher.seen) ran_volatile = true;
+  } else if(native) {
+    NativeRunner runner(parent->native_script,&parent->native_blocks[0]);
+    vm->run_to_completion(runner);
+  } else {
+    vm->run_to_completion();
+  }
+}
+
+bool Device::inputs_changed() {
+  if((int)vm->hood.size()!=settled_hood_size) return true;
+  for(NeighbourHood::iterator i=vm->hood.begin(); i!=vm->hood.end(); i++)
+    if(i->is_changed) return true;
+  return false;
 }
 
 // a convenient combined function
@@ -199,12 +332,13 @@ bool Device::debug() { return is_debug && parent->is_debug; }
 void Device::text_scale() {
 #ifdef WANT_GLUT
   flo d = body->display_radius(); glScalef(d,d,d); // scale text to body
-  d = vis_context->display_mag; glScalef(d,d,d); // then magnify as specified
+  d = parent->display_mag; glScalef(d,d,d); // then magnify as specified
   glScalef(TEXT_SCALE,TEXT_SCALE,TEXT_SCALE);
 #endif // WANT_GLUT
 }
 
-extern void radio_send_export(uint8_t version, Array<Data> const & data);
+extern int radio_send_export(const VMContext& context, uint8_t version,
+                             Imports const & data);
 
 void Device::internal_event(SECONDS time, DeviceEvent type) {
   int iStep = 0;
@@ -225,36 +359,31 @@ void Device::internal_event(SECONDS time, DeviceEvent type) {
       }
     }
 
-    // double-delay kludge option: just run the VM a second time
-    for(int vmrun=0;vmrun<=(2*parent->is_double_delay_kludge);vmrun++) {
-      vm->run(time);
-      while(!vm->finished()) {
-    	if (is_print_stack || is_print_env_stack) {
-          Int8 opcode = *(vm->instruction_pointer);
-          cout << "OpCode: " << (int)opcode;
-          Instruction i = instructions[opcode];
-          map<string,uint8_t>::iterator it;
-          for ( it=OPCODE_MAP.begin() ; it != OPCODE_MAP.end(); it++ ) {
-            if ((*it).second == opcode) {
-              cout << " " << (*it).first;
-              break;
-            }
-          }
-
-          if (is_print_stack) {
-            cout << " Stack (" << iStep << "): ";
-            vm->print_stack(&vm->stack);
-          }
-          if (is_print_env_stack) {
-            cout << " Environment Stack (" << iStep << "): ";
-            vm->print_stack(&vm->environment);
-          }
-          iStep++;
+    // With -quiescent, a run is skipped when the last one left the state
+    // as it found it, read no time, randomness or sensors, and nothing in
+    // the hood has changed since: it could only compute the same again.
+    if(parent->is_quiescent && is_settled && !inputs_changed()) {
+      vm->skip_run(time);
+    } else {
+      vector<Data> before;
+      if(parent->is_quiescent) {
+        for(NeighbourHood::iterator i=vm->hood.begin(); i!=vm->hood.end(); i++)
+          i->is_changed = false;
+        settled_hood_size = vm->hood.size(); ran_volatile = false;
+        for(size_t i=0;i<vm->state.size();i++) before.push_back(vm->state[i].data);
+      }
+      // double-delay kludge option: just run the VM a second time
+      for(int vmrun=0;vmrun<=(2*parent->is_double_delay_kludge);vmrun++) {
+        vm->run(time);
+        run_vm(&iStep);
+        if (is_print_stack || is_print_env_stack) {
+      	cout << endl;
         }
-    	vm->step();
       }
-      if (is_print_stack || is_print_env_stack) {
-    	cout << endl;
+      if(parent->is_quiescent) {
+        is_settled = !ran_volatile && vm->threads.size()==1;
+        for(size_t i=0;is_settled && i<vm->state.size();i++)
+          is_settled = vm->state[i].data.identical(before[i]);
       }
     }
 
@@ -263,11 +392,12 @@ void Device::internal_event(SECONDS time, DeviceEvent type) {
       { DeviceLayer* d = (DeviceLayer*)layers[i]; if(d) d->update(); }
     break;
   case BROADCAST:
+    broadcasts++;
     //export_machine();
     /*if(script_export_needed() || (((int)vm->ticks) % 10)==0) {
       export_script(); // send script every 10 rounds, or as needed
     }*/
-    radio_send_export(0,vm->thisMachine().imports);
+    radio_send_export(vm->context,0,vm->thisMachine().imports);
     break;
   }
 }
@@ -302,7 +432,7 @@ void Device::visualize() {
     glPopMatrix();
   }
 
-  if (vis_context->is_show_vec) {
+  if (parent->is_show_vec) {
     Data dst = vm->threads[0].result;
     glPushMatrix();
     glLineWidth(4);
@@ -333,13 +463,13 @@ void Device::visualize() {
   
   text_scale(); // prepare to draw text
   char buf[1024];
-  if (vis_context->is_show_id) {
+  if (parent->is_show_id) {
     palette->use_color(SpatialComputer::DEVICE_ID);
     sprintf(buf, "%2d", uid);
     draw_text(1, 1, buf);
   }
 
-  if(vis_context->is_show_val) {
+  if(parent->is_show_val) {
     Data dst = vm->threads[0].result;
     glPushMatrix();
     //glTranslatef(0, 0, 0);
@@ -349,7 +479,7 @@ void Device::visualize() {
     glPopMatrix();
   }
   
-  if(vis_context->is_show_version) {
+  if(parent->is_show_version) {
     glPushMatrix();
     palette->use_color(SpatialComputer::DEVICE_ID);
     //sprintf(buf, "%2d:%s", vm->scripts[vm->cur_script].version,
@@ -448,13 +578,44 @@ void SpatialComputer::register_colors() {
 #endif
 }
 
-SpatialComputer::SpatialComputer(Args* args, bool own_dump) {
+// The instructions whose results can change from one run to the next
+// without anything in the hood changing: time, randomness, the device's
+// own sensors and actuators, the radio range (which the R/E keys change),
+// and all platform operations
+static void mark_volatile_ops(bool* ops) {
+  const char* names[] = { "DT", "RND", "NBR_LAG", "SPEED", "BEARING",
+                          "MOV", "FLEX", "HOOD_RADIUS", "AREA",
+                          "INFINITESIMAL", "DENSITY", NULL };
+  for(int op=0;op<256;op++) {
+    ops[op] = (op>=PLATFORM_OPCODE_OFFSET);
+    for(int j=0;names[j] && instruction_names[op];j++)
+      if(!strcmp(names[j],instruction_names[op])) ops[op]=true;
+  }
+}
+
+SpatialComputer::SpatialComputer(Args* args, bool own_dump,
+                                 unsigned int seed) {
   ensure_colors_registered("SpatialComputer");
-  sim_time=0;
+  // each computer has its own randomness, keyed by its seed (-seed)
+  rng.seed(seed); n_layer_streams=0;
+  RandomStream::Scope randomness(&rng);
+  sim_time=0; next_uid=0; // originally, the device UIDs start at zero
+  script_image=NULL; native_script=NULL;
   is_double_delay_kludge = !(args->extract_switch("--no-double-delay-kludge"));
 
   print_stack_id = (args->extract_switch("-print-stack"))?args->pop_number() : -1;
   print_env_stack_id = (args->extract_switch("-print-env-stack"))?args->pop_number() : -1;
+  trace_vm_id = -1; trace_vm_file = NULL;
+  if(args->extract_switch("-trace-vm")) {
+    trace_vm_id = (int)args->pop_number(); trace_vm_file = args->pop_next();
+  }
+  trace_vm_length = (args->extract_switch("-trace-vm-length")) ?
+    (int)args->pop_number() : 65536;
+  int n_threads = (args->extract_switch("-threads"))?(int)args->pop_number():1;
+  is_quiescent = args->extract_switch("-quiescent");
+  mark_volatile_ops(volatile_ops);
+  const char* scheduler_name =
+    (args->extract_switch("-scheduler"))?args->pop_next():"slots";
 
   int n=(args->extract_switch("-n"))?(int)args->pop_number():100; // # devices
   // load dumping variables
@@ -471,7 +632,9 @@ SpatialComputer::SpatialComputer(Args* args, bool own_dump) {
   is_show_snaps = !args->extract_switch("-no-dump-snaps");
   dump_start = args->extract_switch("-dump-after") ? args->pop_number() : 0;
   dump_period = args->extract_switch("-dump-period") ? args->pop_number() : 1;
+  is_dump_binary = args->extract_switch("-dump-binary");
   is_own_dump_file=own_dump; // create dump files unless told otherwise
+  dump_file=NULL; dump_writer=NULL;
   if(own_dump) {
     dump_dir = args->extract_switch("-dump-dir") ? args->pop_next() : "dumps";
     dump_stem = args->extract_switch("-dump-stem") ? args->pop_next() : "dump";
@@ -481,7 +644,9 @@ SpatialComputer::SpatialComputer(Args* args, bool own_dump) {
   get_volume(args, n);
   initialize_plugins(args, n);
 
-  scheduler = new Scheduler(n, time_model->cycle_time());
+  start_workers(n_threads);
+  scheduler = Scheduler::create(scheduler_name, n, time_model->cycle_time());
+  if(scheduler==NULL) uerror("Unknown scheduler '%s'",scheduler_name);
   // create the actual devices
   METERS loc[3];
   for(int i=0;i<n;i++) {
@@ -510,6 +675,12 @@ SpatialComputer::~SpatialComputer() {
   for(int i=0;i<devices.max_id();i++)
     { Device* d = (Device*)devices.get(i); if(d) delete d; }
   // delete everything else in arbitrary order
+  delete script_image;
+  if(workers) delete workers;
+  if(dump_writer) {
+    delete dump_writer;
+    if(is_own_dump_file) fclose(dump_file);
+  }
   delete scheduler; delete volume; delete time_model; delete distribution;
   for(int i=0;i<dynamics.max_id();i++) 
     { Layer* ec = (Layer*)dynamics.get(i); if(ec) delete ec; }
@@ -616,8 +787,37 @@ void SpatialComputer::initialize_plugins(Args* args, int n) {
 /*****************************************************************************
  *  SPATIAL COMPUTER: OPERATION                                              *
  *****************************************************************************/
+// An installation script normally just sets up the VM and defines the
+// globals, so rather than run it on every device, it is run once on a
+// machine of our own, which the devices (and later, their clones) copy.
+// Scripts whose installation can differ between devices are run on each.
+struct ScriptImageCheck {
+  bool is_shareable;
+  ScriptImageCheck() { is_shareable=true; }
+  void operator()(Machine& m) {
+    Int8 op = *m.instruction_pointer;
+    if(instructions[op] && op!=Instructions::MID_OP && op!=Instructions::RND_OP)
+      return;
+    // stop before running anything device-specific (e.g. a platform op)
+    static const Int8 exit_op = Instructions::EXIT_OP;
+    is_shareable=false; m.instruction_pointer = Address(&exit_op);
+  }
+};
+
+void SpatialComputer::make_script_image(uint8_t* script, int len) {
+  delete script_image;
+  script_image = new Machine();
+  script_image->context.hardware = &hardware;
+  script_image->install(Script(script,len));
+  ScriptImageCheck check;
+  script_image->run_to_completion(check);
+  if(!check.is_shareable) { delete script_image; script_image=NULL; }
+}
+
 // for the initial loading only
 void SpatialComputer::load_script(uint8_t* script, int len) {
+  RandomStream::Scope randomness(&rng);
+  make_script_image(script,len);
   for(int i=0;i<devices.max_id();i++) { 
     Device* d = (Device*)devices.get(i); 
     if(d) {
@@ -626,6 +826,22 @@ void SpatialComputer::load_script(uint8_t* script, int len) {
     }
   }
 }
+bool SpatialComputer::load_native(const char* library, uint8_t* script,
+                                  int len) {
+  const ProtoNativeProgram* program = (const ProtoNativeProgram*)
+    plugins.get_library_symbol(library,PROTO_NATIVE_SYMBOL);
+  if(program==NULL) return false;
+  if(program->version!=PROTO_NATIVE_VERSION || program->script_size!=(uint32_t)len) {
+    post("Native code in %s does not fit the script; not using it\n",library);
+    return false;
+  }
+  native_blocks.assign(len,NULL);
+  for(uint32_t i=0;i<program->n_blocks;i++)
+    native_blocks[program->blocks[i].start] = &program->blocks[i];
+  native_script = script;
+  return true;
+}
+
 // install a script by injecting it as packets w. the next version
 void SpatialComputer::load_script_at_selection(uint8_t* script, int len) {
 	/*
@@ -646,6 +862,7 @@ void SpatialComputer::load_script_at_selection(uint8_t* script, int len) {
 }
 
 bool SpatialComputer::handle_key(KeyEvent* key) {
+  RandomStream::Scope randomness(&rng);
   // is this a key recognized internally?
   if(key->normal && !key->ctrl) {
     switch(key->key) {
@@ -727,28 +944,37 @@ void SpatialComputer::drag_selection(flo* delta) {
     delta[2]=0;
   }
   if(delta[0]==0 && delta[1]==0 && delta[2]==0) return;
+  moved_batch.clear();
   for(int i=0;i<selection.max_id();i++) { // move each selected device
     int n = (long)selection.get(i);
     Device* d = (Device*)devices.get(n); 
     if(d) { 
       const flo* p = d->body->position(); // calc new position
       d->body->set_position(p[0]+delta[0],p[1]+delta[1],p[2]+delta[2]);
-      for(int j=0;j<dynamics.max_id();j++) // move the device
-        { Layer* dyn = (Layer*)dynamics.get(j); if(dyn) dyn->device_moved(d); }
+      moved_batch.push_back(d);
     }
   }
+  if(moved_batch.empty()) return;
+  for(size_t j=0;j<dynamics.max_id();j++) { // tell layers, as evolve does
+    Layer* dyn = (Layer*)dynamics.get(j);
+    if(dyn) dyn->devices_moved(&moved_batch[0],moved_batch.size());
+  }
 }
 
 bool SpatialComputer::evolve(SECONDS limit) {
+  RandomStream::Scope randomness(&rng);
   SECONDS dt = limit-sim_time;
   // evolve world
   physics->evolve(dt);
+  moved_batch.clear();
   for(int i=0;i<devices.max_id();i++) { // tell layers about moving devices
     Device* d = (Device*)devices.get(i);
-    if(d && d->body->moved) {
-      for(int j=0;j<dynamics.max_id();j++) 
-        { Layer* dyn = (Layer*)dynamics.get(j); if(dyn) dyn->device_moved(d); }
-      d->body->moved=false;
+    if(d && d->body->moved) { moved_batch.push_back(d); d->body->moved=false; }
+  }
+  if(!moved_batch.empty()) {
+    for(size_t j=0;j<dynamics.max_id();j++) {
+      Layer* dyn = (Layer*)dynamics.get(j);
+      if(dyn) dyn->devices_moved(&moved_batch[0],moved_batch.size());
     }
   }
   // evolve other layers
@@ -758,21 +984,15 @@ bool SpatialComputer::evolve(SECONDS limit) {
   }
   // evolve devices
   Event e; scheduler->set_bound(limit);
-  while(scheduler->pop_next_event(&e)) {
+  if(workers) evolve_devices_parallel(limit);
+  else while(scheduler->pop_next_event(&e)) {
     int id = (long)e.target;
     Device* d = (Device*)devices.get(id);
     if(d && d->uid==e.uid) {
       sim_time=e.true_time; // set time to new value
-      hardware.set_vm_context(d); // align kernel/sim patch for this device
+      hardware.set_vm_context(d); // for plugins that use the old globals
       d->internal_event(e.internal_time,(DeviceEvent)e.type);
-      if(e.type==COMPUTE) {
-        d->run_time = e.internal_time;
-        SECONDS tt, it;  // true and internal time
-        d->timer->next_compute(&tt,&it); tt+=sim_time; it+=d->run_time;
-	scheduler->schedule_event((void*)id,tt,it,COMPUTE,d->uid);
-        d->timer->next_transmit(&tt,&it); tt+=sim_time; it+=d->run_time;
-        scheduler->schedule_event((void*)id,tt,it,BROADCAST,d->uid);
-      }
+      if(e.type==COMPUTE) { d->run_time = e.internal_time; schedule_next(d); }
     }
   }
   sim_time=limit;
@@ -818,6 +1038,140 @@ bool SpatialComputer::evolve(SECONDS limit) {
   return true;
 }
 
+// schedule the compute and broadcast following a computation at run_time;
+// the compute waits for the next thread that is due, which may be more or
+// less than a round away when threads have their own period (set-dt).
+// A device sleeping for more than a round keeps broadcasting its exports
+// every round, so it stays in neighbors' hoods.
+// With late, a compute before now is not scheduled but put into late, in
+// time order, for the caller to run.
+void SpatialComputer::schedule_next(Device* d, vector<Event>* late,
+                                    SECONDS now) {
+  void* target = (void*)(long)d->backptr;
+  SECONDS tt, it;  // true and internal time
+  d->timer->next_compute(&tt,&it);
+  SECONDS round_tt = tt, round_it = it;
+  Time wait = d->vm->next_run(d->run_time,it);
+  if(it>0 && wait != (Time)it) { tt *= wait/it; it = wait; }
+  SECONDS wake = tt;
+  tt+=sim_time; it+=d->run_time;
+  if(late && tt<now) {
+    Event e = { target, tt, it, COMPUTE, d->uid };
+    vector<Event>::iterator p = late->end();
+    while(p!=late->begin() && (p-1)->true_time > tt) p--;
+    late->insert(p,e);
+  } else {
+    scheduler->schedule_event(target,tt,it,COMPUTE,d->uid);
+  }
+  d->timer->next_transmit(&tt,&it);
+  do {
+    scheduler->schedule_event(target,sim_time+tt,d->run_time+it,BROADCAST,
+                              d->uid);
+    tt+=round_tt; it+=round_it;
+  } while(tt < wake);
+}
+
+/*****************************************************************************
+ *  PARALLEL EVOLUTION                                                       *
+ *****************************************************************************/
+// With -threads, computations are collected into a batch for as long as
+// they cannot observe each other: until a broadcast comes up, or until
+// the first event that a computation in the batch will schedule.  A
+// computation only changes its own device, so running the batch in
+// parallel gives the same results as running it in order, independent of
+// the number of threads.  Broadcasts are delivered in order, serially.
+// A set-dt may bring the next computation of a device before the end of
+// the batch, where the scheduler has already passed: such computations are
+// run serially after the batch, each in its place in time.
+
+void SpatialComputer::start_workers(int n_threads) {
+  workers = NULL;
+  if(n_threads<=1) return;
+#ifndef THREAD_SAFE_VM
+  post("WARNING: running serially: built without --enable-threads\n");
+  return;
+#endif
+  const char* unsafe = NULL;
+  if(!physics->is_thread_safe()) unsafe = "physics";
+  for(size_t i=0;i<dynamics.max_id();i++) {
+    Layer* l = (Layer*)dynamics.get(i);
+    if(l && !l->is_thread_safe()) unsafe = "layers";
+  }
+  if(print_stack_id>=0 || print_env_stack_id>=0) unsafe = "stack printing";
+  if(unsafe) {
+    post("WARNING: running serially: %s not safe for -threads\n",unsafe);
+    return;
+  }
+  workers = new WorkerPool(n_threads);
+}
+
+struct ComputeJob { SpatialComputer* cpu; Event* events; };
+static void run_compute(void* context, int i) {
+  ComputeJob* job = (ComputeJob*)context;
+  Event* e = &job->events[i];
+  Device* d = (Device*)job->cpu->devices.get((long)e->target);
+  job->cpu->hardware.set_vm_context(d); // the old globals are per thread
+  d->internal_event(e->internal_time,COMPUTE);
+}
+
+// now is as far as the scheduler has got: follow-ups before it are late
+void SpatialComputer::flush_compute_batch(SECONDS now) {
+  if(compute_batch.empty()) return;
+  ComputeJob job = { this, &compute_batch[0] };
+  workers->run(run_compute,&job,compute_batch.size());
+  vector<Event> late;
+  for(size_t i=0;i<=compute_batch.size();i++) { // follow-ups, in event order
+    bool end = (i==compute_batch.size());
+    while(!late.empty() &&
+          (end || late[0].true_time < compute_batch[i].true_time)) {
+      Event e = late[0]; late.erase(late.begin());
+      Device* d = (Device*)devices.get((long)e.target);
+      sim_time = e.true_time;
+      hardware.set_vm_context(d);
+      d->internal_event(e.internal_time,COMPUTE);
+      d->run_time = e.internal_time;
+      schedule_next(d,&late,now);
+    }
+    if(end) break;
+    Event* e = &compute_batch[i];
+    Device* d = (Device*)devices.get((long)e->target);
+    sim_time = e->true_time; d->run_time = e->internal_time;
+    schedule_next(d,&late,now);
+  }
+  compute_batch.clear();
+}
+
+void SpatialComputer::evolve_devices_parallel(SECONDS limit) {
+  Event e;
+  // lowering the bound to the first follow-up keeps the scheduler from
+  // moving past it before the batch is run and the follow-up exists
+  SECONDS horizon = limit;
+  while(true) {
+    if(!scheduler->pop_next_event(&e)) {
+      if(compute_batch.empty()) break;
+      flush_compute_batch(horizon);
+      horizon = limit; scheduler->set_bound(limit);
+      continue;
+    }
+    int id = (long)e.target;
+    Device* d = (Device*)devices.get(id);
+    if(!d || d->uid!=e.uid) continue;
+    if(e.type==COMPUTE) {
+      SECONDS tt, ct, it;
+      d->timer->next_transmit(&tt,&it); d->timer->next_compute(&ct,&it);
+      SECONDS next = e.true_time + min(tt,ct);
+      if(next < horizon) { horizon = next; scheduler->set_bound(horizon); }
+      compute_batch.push_back(e);
+    } else {
+      flush_compute_batch(e.true_time);
+      if(horizon < limit) { horizon = limit; scheduler->set_bound(limit); }
+      sim_time=e.true_time;
+      hardware.set_vm_context(d);
+      d->internal_event(e.internal_time,(DeviceEvent)e.type);
+    }
+  }
+}
+
 /*****************************************************************************
  *  DUMPING FACILITY                                                         *
  *****************************************************************************/
@@ -844,7 +1198,36 @@ void SpatialComputer::dump_header(FILE* out) {
   fprintf(out,"\n");
 }
 
+// binary frames all go to one file, opened at the first dump
+void SpatialComputer::dump_binary_frame(SECONDS time) {
+  if(!dump_writer) {
+    if(is_own_dump_file) {
+      char buf[1000];
+#ifdef _WIN32  
+      mkdir(dump_dir);
+#else
+      mkdir(dump_dir, ACCESSPERMS);
+#endif
+      sprintf(buf,"%s/%s.pdump",dump_dir,dump_stem);
+      dump_file = fopen(buf,"wb");
+      if(dump_file==NULL) { post("Unable to open dump file '%s'\n",buf); return; }
+    } else if(dump_file==NULL) {
+      post("Can't dump: no output file supplied\n"); return;
+    }
+    dump_writer = new DumpWriter(dump_file);
+  }
+  dump_header(dump_writer->begin_scratch());
+  dump_writer->begin_frame(time,dump_writer->end_scratch(),
+                           (is_dump_value ? DUMP_HAS_VALUE : 0) |
+                           (is_dump_network ? DUMP_HAS_NETWORK : 0));
+  for(size_t i=0;i<devices.max_id();i++)
+    { Device* d = (Device*)devices.get(i); if(d) d->dump_values(dump_writer); }
+  dump_writer->end_frame();
+  just_dumped = true; // prime drawing to flash
+}
+
 void SpatialComputer::dump_frame(SECONDS time, bool time_in_name) {
+  if(is_dump_binary) { dump_binary_frame(time); return; }
   if(is_own_dump_file) { // manage the file ourselves
     char buf[1000];
 #ifdef _WIN32  
@@ -20,11 +20,13 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 #include "sim-hardware.h"
 #include "utils.h"
 #include "scheduler.h"
+#include "workerpool.h"
 
 #include "kernelversion.h"
 
 // prototype classes
-class Device; class SpatialComputer;
+class Device; class SpatialComputer; class DumpWriter; class VMTrace;
+struct ProtoNativeBlock;
 
 /*****************************************************************************
  *  TIME AND SPACE DISTRIBUTIONS                                             *
@@ -64,6 +66,7 @@ class Layer : public EventConsumer {
   int id;          // what number layer this is, for lookup during callbacks
   bool can_dump;   // -ND[layer] is expected to turn off dumping for a layer
   SpatialComputer* parent;
+  RandomStream rng; // this layer's own randomness
   Layer(SpatialComputer* p);
   virtual ~Layer() {} // make sure that destruction is passed to subclasses
   virtual bool handle_key(KeyEvent* key) {return false;}
@@ -71,8 +74,16 @@ class Layer : public EventConsumer {
   virtual bool evolve(SECONDS dt) { return false; }
   virtual void add_device(Device* d)=0;    // may add a DeviceLayer to Device
   virtual void device_moved(Device* d) {}  // adjust for device motion
+  // adjust for all the devices moved by a physics step; by default, one
+  // at a time (layers may instead rebuild in bulk)
+  virtual void devices_moved(Device** moved, int n)
+    { for(int i=0;i<n;i++) device_moved(moved[i]); }
   // removal, updates handled through DeviceLayer
   virtual void dump_header(FILE* out) {} // field names in ""s for a data file
+  // can devices be computed in parallel (-threads) with this layer present?
+  // Only if its hardware functions and DeviceLayer pre/updates touch
+  // nothing but the device they are called for.
+  virtual bool is_thread_safe() { return false; }
 };
 
 // this is the device-specific instantiation of a layer
@@ -87,6 +98,8 @@ class DeviceLayer : public EventConsumer {
   virtual bool handle_key(KeyEvent* event) { return false; }
   virtual void copy_state(DeviceLayer* src)=0; // to be called during cloning
   virtual void dump_state(FILE* out, int verbosity) {}; // print state to file
+  // binary dumps: the numbers of dump_state(out,0), by default parsed back
+  virtual void dump_values(DumpWriter* out);
 };
 
 // The Body/BodyDynamics is a layer that is stored and managed
@@ -125,7 +138,6 @@ class BodyDynamics : public Layer {
 enum DeviceEvent { COMPUTE, BROADCAST };
 
 class Device : public EventConsumer {
-  static int top_uid;               // uids are generated in rising sequence
  public:
   int uid, backptr;                 // internal (& ext.) identifier for device
   SECONDS run_time;                 // how much internal time has elapsed?
@@ -136,10 +148,16 @@ class Device : public EventConsumer {
   //MACHINE* vm;                    // the Proto kernel
   Machine * vm;                     // the DelftProto Virtual Machine
   SpatialComputer* parent;          // upward track for the device
+  RandomStream rng;                 // this device's own randomness
+  int broadcasts;                   // exports sent, numbering radio errors
   bool is_selected;                 // is this device currently selected?
   bool is_debug;                    // is this device currently a debug focus?
   bool is_print_stack;              // are we printing the stack of this device to cout after each instruction?
   bool is_print_env_stack;          // are we printing the env stack
+  VMTrace* trace;                   // records instructions run, for -trace-vm
+  bool is_settled;                  // -quiescent: would a run repeat the last?
+  bool ran_volatile;                // did the last run read time or sensors?
+  int settled_hood_size;            // # neighbors when the last run started
   
   Device(SpatialComputer* parent, METERS *loc, DeviceTimer *timer);
   ~Device();
@@ -147,10 +165,13 @@ class Device : public EventConsumer {
   void internal_event(SECONDS time, DeviceEvent type); // broadcast or compute
   void text_scale();                // scale to display text about device
   void load_script(uint8_t const * script, int len);
+  void run_vm(int* print_step);     // run the VM's script to its end
+  bool inputs_changed();            // has the hood changed since the last run?
   bool handle_key(KeyEvent* key);
   virtual void visualize();
   virtual void render_selection(); // render for selection
   virtual void dump_state(FILE* out, int verbosity);
+  virtual void dump_values(DumpWriter* out); // dump_state(out,0), in binary
   bool debug();
 };
 
@@ -171,6 +192,8 @@ class SpatialComputer : public EventConsumer {
   bool is_show_val, is_show_vec, is_show_id, is_show_version;
   bool is_debug, is_dump_default, is_dump_hood, is_dump_value, is_dump_network; 
   int print_stack_id, print_env_stack_id; // id of device to print stack of
+  int trace_vm_id, trace_vm_length; // device to trace, # records to keep
+  const char* trace_vm_file;        // where its trace is written
   flo display_mag; // magnifier for body display
   Population selection;     // the list of devices currently selected
   // dumping variables
@@ -179,6 +202,8 @@ class SpatialComputer : public EventConsumer {
   const char* dump_dir;  // directory where dumps will go
   const char* dump_stem; // start of the dump file name
   FILE* dump_file;
+  bool is_dump_binary;   // append frames to one .pdump file instead?
+  DumpWriter* dump_writer; // writes the .pdump file, once it is opened
   // Are we using the kludge to remove double-delays?
   bool is_double_delay_kludge;
   
@@ -194,15 +219,28 @@ class SpatialComputer : public EventConsumer {
   Scheduler* scheduler;     // "priority queue" for device events
   SimulatedHardware hardware; // patch connecting VMs and dynamics
   int version;              // what software version is currently running
+  int next_uid;             // device uids are generated in rising sequence
+  Machine* script_image;    // the script installed once, for devices to copy
+  const uint8_t* native_script; // script that -native code was loaded for
+  std::vector<const ProtoNativeBlock*> native_blocks; // by offset, or NULL
+  RandomStream rng;         // randomness, from the seed: see device/layer_stream
+  int n_layer_streams;      // how many layers have been given streams
 
   std::queue<int> death_q;  // nodes requesting to suicide
   std::queue<CloneReq*> clone_q;  // nodes requesting to reproduce
+  WorkerPool* workers;      // runs computations in parallel, NULL if serial
+  std::vector<Event> compute_batch; // COMPUTE events waiting for workers
+  std::vector<Device*> moved_batch; // bodies moved by the last physics step
+  bool is_quiescent;        // skip runs that can only repeat the last one?
+  bool volatile_ops[256];   // opcodes reading time, randomness or sensors
 
  public:
-  SpatialComputer(Args* args, bool own_dump);
+  SpatialComputer(Args* args, bool own_dump, unsigned int seed);
   ~SpatialComputer();
   void load_script(uint8_t* script, int len);
   void load_script_at_selection(uint8_t* script, int len);
+  // run the blocks compiled into library (by -native) in place of script's
+  bool load_native(const char* library, uint8_t* script, int len);
   // EventConsumer routines
   bool handle_key(KeyEvent* key);
   bool handle_mouse(MouseEvent* mouse);
@@ -217,8 +255,12 @@ class SpatialComputer : public EventConsumer {
   void dump_state(FILE* out); // print log info for all devices
   void dump_selection(FILE* out, int verbosity);
   void dump_frame(SECONDS time, bool time_in_name);
+  void dump_binary_frame(SECONDS time); // append a frame to the .pdump file
   // configuration routines
   bool is_3d() { return volume->dimensions()>2; }
+  // independent random streams for each device and layer
+  RandomStream device_stream(int uid) { return rng.substream(0).substream(uid); }
+  RandomStream layer_stream() { return rng.substream(1).substream(n_layer_streams++); }
   void appendDefops(std::string& s);
 
   virtual void register_colors();
@@ -230,10 +272,16 @@ class SpatialComputer : public EventConsumer {
   void get_volume(Args* args, int n); // shared dist constructor
   int addLayer(Layer* layer); // add a layer to dynamics & set callback vars
   int addLayer(const char* layer,Args* args,int n);// add layer from plugin
+  void start_workers(int n_threads); // set up -threads, if possible
+  void make_script_image(uint8_t* script, int len);
+  void evolve_devices_parallel(SECONDS limit);
+  void flush_compute_batch(SECONDS now); // run computations in compute_batch
+  // schedule the events after a computation
+  void schedule_next(Device* d, std::vector<Event>* late=NULL, SECONDS now=0);
 };
 
 // global variable set to the spatial computer during visualize(),
-// to avoid passing it around continually
+// for layers that want it (devices draw with their own parent)
 extern SpatialComputer* vis_context;
 
 typedef Layer* (*layer_getter) (Args *args, SpatialComputer *cpu, int n);
@@ -0,0 +1,152 @@
+/* Hashed spatial grid, for finding the devices near a point
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#include "config.h"
+#include <math.h>
+#include "spatialhash.h"
+#include "spatialcomputer.h"
+
+#define MAX_CELL_COORD 1000000000 // cells farther out than this are merged
+
+SpatialHash::SpatialHash(METERS cell_size, bool is_3d) {
+  this->cell_size = cell_size; this->is_3d = is_3d;
+  size = occupied = 0;
+  table.assign(64,-1); mask = table.size()-1;
+}
+
+// which cell holds a coordinate (clamped, so huge or NaN ones are safe)
+static int cell_coord(flo x, METERS cell_size) {
+  flo c = floor(x/cell_size);
+  if(!(c > -MAX_CELL_COORD)) return -MAX_CELL_COORD; // includes NaN
+  if(c > MAX_CELL_COORD) return MAX_CELL_COORD;
+  return (int)c;
+}
+
+void SpatialHash::key_of(const flo* p, int* key) {
+  key[0] = cell_coord(p[0],cell_size); key[1] = cell_coord(p[1],cell_size);
+  key[2] = is_3d ? cell_coord(p[2],cell_size) : 0;
+}
+
+uint32_t SpatialHash::hash(const int* key) {
+  uint32_t h = (uint32_t)key[0]*73856093u ^ (uint32_t)key[1]*19349663u ^
+    (uint32_t)key[2]*83492791u;
+  h ^= h>>16; h *= 0x85ebca6bu; h ^= h>>13; h *= 0xc2b2ae35u; h ^= h>>16;
+  return h;
+}
+
+static bool same_key(const int* a, const int* b)
+  { return a[0]==b[0] && a[1]==b[1] && a[2]==b[2]; }
+
+int SpatialHash::find(const int* key) {
+  for(int i = hash(key)&mask; table[i]>=0; i = (i+1)&mask)
+    if(same_key(cells[table[i]].key,key)) return table[i];
+  return -1;
+}
+
+int SpatialHash::intern(const int* key) {
+  int c = find(key);
+  if(c>=0) return c;
+  if(2*(occupied+1) > (int)table.size()) grow_table(); // keep probes short
+  if(free_cells.empty()) {
+    c = cells.size(); cells.push_back(Cell());
+  } else {
+    c = free_cells.back(); free_cells.pop_back();
+  }
+  for(int i=0;i<3;i++) cells[c].key[i] = key[i];
+  int i = hash(key)&mask;
+  while(table[i]>=0) i = (i+1)&mask;
+  table[i] = c; occupied++;
+  return c;
+}
+
+// Remove a cell from the table, shifting back any entries that probed
+// past it, so that lookups never need tombstones.
+void SpatialHash::release(int cell) {
+  int i = hash(cells[cell].key)&mask;
+  while(table[i]!=cell) i = (i+1)&mask;
+  table[i] = -1; occupied--; free_cells.push_back(cell);
+  for(int j = (i+1)&mask; table[j]>=0; j = (j+1)&mask) {
+    int k = hash(cells[table[j]].key)&mask; // where j's entry wants to be
+    bool movable = (i<=j) ? (k<=i || k>j) : (k<=i && k>j);
+    if(movable) { table[i] = table[j]; table[j] = -1; i = j; }
+  }
+}
+
+void SpatialHash::grow_table() {
+  std::vector<int> old; old.swap(table);
+  table.assign(old.size()*2,-1); mask = table.size()-1;
+  for(size_t j=0;j<old.size();j++) {
+    if(old[j]<0) continue;
+    int i = hash(cells[old[j]].key)&mask;
+    while(table[i]>=0) i = (i+1)&mask;
+    table[i] = old[j];
+  }
+}
+
+void SpatialHash::add(Device* d, SpatialHandle* h) {
+  int key[3]; key_of(d->body->position(),key);
+  h->cell = intern(key);
+  std::vector<Member>& m = cells[h->cell].members;
+  h->loc = m.size();
+  Member mem = {d,h}; m.push_back(mem);
+  size++;
+}
+
+void SpatialHash::remove(SpatialHandle* h) {
+  std::vector<Member>& m = cells[h->cell].members;
+  if(h->loc>=(int)m.size() || m[h->loc].h!=h) debug("Bad spatial hash handle!\n");
+  m[h->loc] = m.back(); m[h->loc].h->loc = h->loc; m.pop_back();
+  if(m.empty()) release(h->cell);
+  h->cell = h->loc = -1;
+  size--;
+}
+
+bool SpatialHash::move(Device* d, SpatialHandle* h) {
+  int key[3]; key_of(d->body->position(),key);
+  if(same_key(cells[h->cell].key,key)) return false;
+  remove(h); add(d,h);
+  return true;
+}
+
+void SpatialHash::resize(METERS cell_size) {
+  std::vector<Member> all; all.reserve(size);
+  for(size_t c=0;c<cells.size();c++)
+    all.insert(all.end(),cells[c].members.begin(),cells[c].members.end());
+  cells.clear(); free_cells.clear();
+  table.assign(table.size(),-1); size = occupied = 0;
+  this->cell_size = cell_size;
+  for(size_t i=0;i<all.size();i++) add(all[i].d,all[i].h);
+}
+
+void SpatialHash::find_cells(const flo* p, METERS radius,
+                             std::vector<int>* out) {
+  out->clear();
+  int lo[3], hi[3];
+  for(int i=0;i<3;i++) {
+    lo[i] = cell_coord(p[i]-radius,cell_size);
+    hi[i] = cell_coord(p[i]+radius,cell_size);
+  }
+  if(!is_3d) lo[2] = hi[2] = 0;
+  double span = (double)(hi[0]-lo[0]+1)*(hi[1]-lo[1]+1)*(hi[2]-lo[2]+1);
+  if(span > occupied) { // cheaper to check every occupied cell
+    for(size_t i=0;i<table.size();i++) {
+      if(table[i]<0) continue;
+      const int* k = cells[table[i]].key;
+      if(k[0]>=lo[0] && k[0]<=hi[0] && k[1]>=lo[1] && k[1]<=hi[1] &&
+         k[2]>=lo[2] && k[2]<=hi[2]) out->push_back(table[i]);
+    }
+    return;
+  }
+  int key[3];
+  for(key[2]=lo[2];key[2]<=hi[2];key[2]++)
+    for(key[0]=lo[0];key[0]<=hi[0];key[0]++)
+      for(key[1]=lo[1];key[1]<=hi[1];key[1]++) {
+        int c = find(key);
+        if(c>=0) out->push_back(c);
+      }
+}
@@ -0,0 +1,64 @@
+/* Hashed spatial grid, for finding the devices near a point
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#ifndef __SPATIALHASH__
+#define __SPATIALHASH__
+
+#include <stdint.h>
+#include <vector>
+#include "utils.h"
+
+class Device;
+
+// Where a member is filed in a SpatialHash; kept by the member's owner
+// (e.g. a radio's device layer) and updated by the hash as it moves.
+struct SpatialHandle {
+  int cell, loc; // -1 while not filed
+  SpatialHandle() : cell(-1), loc(-1) {}
+};
+
+// A grid of cubes (squares, in 2D) of side cell_size, covering all of
+// space: only the cells that hold devices exist, found by hashing their
+// integer coordinates.  Devices may wander arbitrarily far, and memory
+// grows with the number of occupied cells, not the area they span.  Any
+// radio (or other layer) that needs the devices near a point can keep
+// one; the cell size only affects speed, so it can be changed at will.
+class SpatialHash {
+ public:
+  struct Member { Device* d; SpatialHandle* h; };
+  METERS cell_size;
+
+  SpatialHash(METERS cell_size, bool is_3d);
+  void add(Device* d, SpatialHandle* h);
+  void remove(SpatialHandle* h);
+  bool move(Device* d, SpatialHandle* h); // true if it changed cells
+  void resize(METERS cell_size); // refile every member
+  // all occupied cells that may hold points within radius of p; this
+  // only reads the hash, so threads may search it at the same time
+  void find_cells(const flo* p, METERS radius, std::vector<int>* out);
+  const std::vector<Member>& members(int cell) { return cells[cell].members; }
+  int num_members() { return size; }
+  int max_cell() { return cells.size(); } // all cell ids are less
+
+ private:
+  struct Cell { int key[3]; std::vector<Member> members; };
+  bool is_3d;
+  int size;
+  std::vector<Cell> cells;   // indexed by cell id
+  std::vector<int> free_cells; // ids of emptied cells, for reuse
+  std::vector<int> table;    // open addressing: cell id or -1
+  int mask, occupied;        // table.size()-1, number of cells in table
+  void key_of(const flo* p, int* key);
+  uint32_t hash(const int* key);
+  int find(const int* key); // cell id, or -1
+  int intern(const int* key); // find, or make the cell
+  void release(int cell); // drop an emptied cell from the table
+  void grow_table();
+};
+
+#endif // __SPATIALHASH__
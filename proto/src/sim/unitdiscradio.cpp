@@ -13,7 +13,8 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 /*****************************************************************************
  *  UNIT DISC RADIO                                                          *
  *****************************************************************************/
-UnitDiscRadio::UnitDiscRadio(Args* args, SpatialComputer* p, int n) : RadioSim(args, p) {
+UnitDiscRadio::UnitDiscRadio(Args* args, SpatialComputer* p, int n)
+  : RadioSim(args, p), grid(1,p->is_3d()) {
   ensure_colors_registered("UnitDiscRadio");
   if(args->extract_switch("-ns")) { // set range from neighborhood size
     flo ns = args->pop_number(); // note: counts *self* as a neighbor
@@ -32,6 +33,11 @@ UnitDiscRadio::UnitDiscRadio(Args* args, SpatialComputer* p, int n) : RadioSim(a
     range = (args->extract_switch("-r"))?args->pop_number():15.0;
   }
   r_sqr = range*range; // cache the square for distance calcs
+  // track possible neighbors a little beyond range, so small moves are cheap
+  skin = (args->extract_switch("-radio-skin"))?args->pop_number():range/10;
+  rebuild_fraction = (args->extract_switch("-radio-rebuild")) ?
+    args->pop_number() : 0.5;
+  search_mark = 0;
   // display options
   is_show_logical_nbrs = args->extract_switch("-lc");
   is_show_radio = args->extract_switch("-show-radio");
@@ -44,40 +50,30 @@ UnitDiscRadio::UnitDiscRadio(Args* args, SpatialComputer* p, int n) : RadioSim(a
   p->hardware.patch(this,RADIO_SEND_SCRIPT_PKT_FN);
   p->hardware.patch(this,RADIO_SEND_DIGEST_FN);
 
-  // make internal space representation, starting with grid size
-  create_cell_representation();
-}
-
-void UnitDiscRadio::create_cell_representation() {
-  SpatialComputer* p = parent;
-  // make internal space representation, starting with grid size
-  cell_rows = (int)ceil((p->volume->r-p->volume->l)/range)+2;
-  cell_cols = (int)ceil((p->volume->t-p->volume->b)/range)+2;
-  cell_lvls = (p->volume->dimensions()==2)?1:
-    (int)ceil((((Rect3*)p->volume)->c-(((Rect3*)p->volume)->f))/range)+2;
-  // pre-calculate bounds
-  cell_left = p->volume->l-range; cell_bottom = p->volume->b-range;
-  cell_floor = (p->volume->dimensions()==2)?1:
-    ((Rect3*)p->volume)->f-range;
-  lvl_size = cell_rows*cell_cols; num_cells = lvl_size*cell_lvls;
-  // make and populate the cell table
-  cells = (Population**)calloc(num_cells,sizeof(Population*));
-  for(int i=0;i<num_cells;i++) cells[i] = new Population();
+  grid.resize(range+skin);
 }
 
+// Only range+skin must be searched, so the cells can be any size: they
+// are resized only when the reach has changed by more than half, and
+// range changes never pay more than a pass over the devices.
 void UnitDiscRadio::change_radio_range(float newrange) {
+  METERS old_reach = range+skin;
   range = newrange; r_sqr = range*range;
-  // Get rid of old cell representation
-  for(int i=0;i<num_cells;i++) { delete cells[i]; }
-  free(cells); 
-  // Replace with new representation
-  create_cell_representation();
-  // Fill new cells with all devices
-  for(int i=0;i<parent->devices.size();i++) {
+  METERS reach = range+skin;
+  if(reach > 1.5*grid.cell_size || reach < 0.5*grid.cell_size)
+    grid.resize(reach);
+  // if the reach has grown, candidates must be searched for again;
+  // otherwise the old ones are a superset, and only ranges change
+  for(size_t i=0;i<parent->devices.max_id();i++) {
     Device* d = (Device*)parent->devices.get(i); if(d==NULL) continue;
-    UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
-    int c = udd->cell_id = device_cell(d);
-    udd->cell_loc = cells[c]->add(d);
+    if(reach > old_reach) connect_device(d);
+    else update_pairs((UnitDiscDevice*)d->layers[id]);
+  }
+  if(is_fast_prune_hood) {
+    for(size_t i=0;i<parent->devices.max_id();i++) {
+      Device* d = (Device*)parent->devices.get(i);
+      if(d) prune_hood(d);
+    }
   }
 }
 
@@ -102,11 +98,6 @@ vector<HardwareFunction> UnitDiscRadio::getImplementedHardwareFunctions()
     return hardwareFunctions;
 }
 
-UnitDiscRadio::~UnitDiscRadio() {
-  for(int i=0;i<num_cells;i++) delete cells[i]; // populations assumed empty
-  free(cells);
-}
-
 bool UnitDiscRadio::handle_key(KeyEvent* key) {
   if(key->normal) {
     if(key->ctrl) {
@@ -125,120 +116,135 @@ bool UnitDiscRadio::handle_key(KeyEvent* key) {
   return RadioSim::handle_key(key);
 }
 
-// calculate which internal storage cell contains a device
-int UnitDiscRadio::device_cell(Device* d) {
-  const flo* p = d->body->position();
-  int row = (int)floor((p[0]-cell_left)/range);
-  int col = (int)floor((p[1]-cell_bottom)/range);
-  row = BOUND(row,0,cell_rows-1); col = BOUND(col,0,cell_cols-1);
-  int n = row*cell_cols + col;
-  if(cell_lvls>1) { // 3D
-    int lvl = (int)floor((p[2]-cell_floor)/range);
-    lvl = BOUND(lvl,0,cell_lvls-1);
-    n += lvl_size*lvl;
-  }
-  return n;
-}
-
 // squared distance between two points
 flo range3sqr(const flo* a, const flo* b) {
   flo dx = a[0]-b[0], dy = a[1]-b[1], dz = a[2]-b[2];
   return dx*dx + dy*dy + dz*dz;
 }
 
-struct NbrRecord {
-  UnitDiscDevice* nbr;
-  int backptr; // location of corresponding record in neighbor
-  METERS dp[3]; // difference in position
-  NbrRecord(UnitDiscDevice* nbr, const METERS* p, const METERS* np) {
-    this->nbr = nbr; backptr = -1;
-    for(int i=0;i<3;i++) dp[i]=np[i]-p[i];
+UnitDiscRadio::~UnitDiscRadio() {
+  for(size_t i=0;i<record_pool.size();i++) delete record_pool[i];
+}
+
+// records are recycled, since moving devices gain and lose them often
+NbrRecord* UnitDiscRadio::new_record(UnitDiscDevice* nbr) {
+  NbrRecord* nr;
+  if(record_pool.empty()) {
+    nr = new NbrRecord();
+  } else {
+    nr = record_pool.back(); record_pool.pop_back();
+  }
+  nr->nbr = nbr; nr->backptr = -1; nr->in_range = false;
+  return nr;
+}
+
+// make a and b candidates of one another; update_pair fills in the rest
+void UnitDiscRadio::add_pair(UnitDiscDevice* a, UnitDiscDevice* b) {
+  NbrRecord* nnr = new_record(a);
+  NbrRecord* nr = new_record(b);
+  nr->backptr = b->neighbors.add(nnr);
+  nnr->backptr = a->neighbors.add(nr);
+}
+
+void UnitDiscRadio::remove_pair(UnitDiscDevice* udd, int i) {
+  NbrRecord* nr = (NbrRecord*)udd->neighbors.remove(i);
+  NbrRecord* nnr = (NbrRecord*)nr->nbr->neighbors.remove(nr->backptr);
+  if(nnr->backptr!=i) debug("Bad nbr backptr: %d!=%d\n",i,nnr->backptr);
+  if(nnr->nbr != udd) debug("Bad local backptr\n");
+  if(nr->in_range) {
+    udd->num_in_range--; nr->nbr->num_in_range--;
+    udd->is_hood_lost = nr->nbr->is_hood_lost = true;
   }
-};
+  record_pool.push_back(nr); record_pool.push_back(nnr);
+}
+
+// bring both records of a pair up to date with the devices' positions
+void UnitDiscRadio::update_pair(UnitDiscDevice* udd, NbrRecord* nr) {
+  UnitDiscDevice* nbr = nr->nbr;
+  NbrRecord* nnr = (NbrRecord*)nbr->neighbors.get(nr->backptr);
+  const flo* p = udd->container->body->position();
+  const flo* np = nbr->container->body->position();
+  for(int i=0;i<3;i++) { nr->dp[i]=np[i]-p[i]; nnr->dp[i]=p[i]-np[i]; }
+  bool in_range = range3sqr(p,np)<r_sqr;
+  if(in_range != nr->in_range) {
+    nr->in_range = nnr->in_range = in_range;
+    int change = in_range ? 1 : -1;
+    udd->num_in_range += change; nbr->num_in_range += change;
+    if(!in_range) udd->is_hood_lost = nbr->is_hood_lost = true;
+  }
+}
 
-// handle the actual connections of a device into a cell
-void UnitDiscRadio::connect_to_cell(Device* d,int cell_id) {
-  if(cell_id<0 || cell_id>=num_cells) return; // bounds check
-  Population* c = cells[cell_id];
+void UnitDiscRadio::update_pairs(UnitDiscDevice* udd) {
+  for(size_t i=0;i<udd->neighbors.max_id();i++) {
+    NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
+    if(nr) update_pair(udd,nr);
+  }
+}
+
+// Search the grid around a device for its candidates, keeping the
+// records of those it already has.
+void UnitDiscRadio::connect_device(Device* d) {
   UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
   const flo* p = d->body->position();
+  METERS reach = range+skin;
+  flo c_sqr = reach*reach;
   bool debug = is_debug_radio && d->debug();
-  for(int i=0;i<c->max_id();i++) {
-    Device* nbrd = (Device*)c->get(i);
-    if(nbrd) {
+  search_mark++; udd->mark = search_mark;
+  for(size_t i=0;i<udd->neighbors.max_id();i++) {
+    NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
+    if(nr) {
+      if(range3sqr(p,nr->nbr->container->body->position())<c_sqr)
+        nr->nbr->mark = search_mark;
+      else
+        remove_pair(udd,i);
+    }
+  }
+  if(debug) post("Pos=[%f,%f,%f], in cell %d, check:",
+                 p[0],p[1],p[2],udd->cell.cell);
+  grid.find_cells(p,reach,&near_cells);
+  for(size_t c=0;c<near_cells.size();c++) {
+    const vector<SpatialHash::Member>& cell = grid.members(near_cells[c]);
+    if(debug) post("cell %d\n",near_cells[c]);
+    for(size_t i=0;i<cell.size();i++) {
+      Device* nbrd = cell[i].d;
+      UnitDiscDevice* nbr = (UnitDiscDevice*)nbrd->layers[id];
+      if(nbr->mark==search_mark) continue; // self, or already a candidate
       const flo* nbrp = nbrd->body->position();
       if(debug) post("Nbr? %d (dist=%f)\n",nbrd->uid,sqrt(range3sqr(p,nbrp)));
-      if(range3sqr(p,nbrp)<r_sqr) { // connect if close enough
-        UnitDiscDevice* nbr = (UnitDiscDevice*)nbrd->layers[id];
-        const flo* np = nbrd->body->position();
-        NbrRecord* nnr = new NbrRecord(udd,np,p);
-        NbrRecord* nr = new NbrRecord(nbr,p,np);
-        nr->backptr = nbr->neighbors.add(nnr);
-        nnr->backptr = udd->neighbors.add(nr);
-        if(debug) post("Accepted nbr %d\n",nbrd->uid);
+      if(range3sqr(p,nbrp)<c_sqr) { // connect if close enough
+        nbr->mark = search_mark;
+        add_pair(udd,nbr);
+        if(debug) post("Accepted candidate %d\n",nbrd->uid);
       } else {
         if(debug) post("Rejected possible nbr %d\n",nbrd->uid);
       }
     }
   }
-}
-// connect a device to its 2D-adjacent cells
-// Note that this will check for connections wrapping around the edge
-// of the world, but that should not greatly increase cost unless many
-// nodes are outside the original boundaries
-void UnitDiscRadio::connect_device2(Device* d, int base) { 
-  bool debug = is_debug_radio && d->debug();
-  const flo* p = d->body->position();
-  if(debug) post("id=%d Pos=[%f,%f,%f], in cell %d [of %d x %d x %d] , check:",
-                 base,cell_rows,cell_cols,cell_lvls,d->uid,p[0],p[1],p[2]);
-  for(int i=-cell_cols;i<=cell_cols;i+=cell_cols)
-    for(int j=-1;j<=1;j++) {
-      if(debug) post("cell %d\n",base+i+j);
-      connect_to_cell(d,base+i+j);
-    }
+  update_pairs(udd);
+  for(int i=0;i<3;i++) udd->search_pos[i] = p[i];
   if(debug) {
     post("Final nbr collection:");
-    UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
-    for(int i=0;i<udd->neighbors.max_id();i++) {
+    for(size_t i=0;i<udd->neighbors.max_id();i++) {
       NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
-      if(nr) { post(" %d",nr->nbr->container->uid); }
+      if(nr && nr->in_range) { post(" %d",nr->nbr->container->uid); }
     }
     post("\n");
   }
 }
-
-void UnitDiscRadio::connect_device(Device* d) {
-  UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
-  int c = udd->cell_id = device_cell(d);
-  // find neighbors
-  connect_device2(d,c);
-  if(cell_lvls>1) { // 3D
-    if(c-lvl_size>=0) connect_device2(d,c-lvl_size);
-    if(c+lvl_size<num_cells) connect_device2(d,c+lvl_size);
-  }
-  // insert into cell
-  udd->cell_loc = cells[c]->add(d);
-}
 void UnitDiscRadio::disconnect_device(Device *d) {
   UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
   // disconnect from each neighbor
-  for(int i=0;i<udd->neighbors.max_id();i++) {
-    NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
-    if(nr) { 
-      NbrRecord* nnr = (NbrRecord*)nr->nbr->neighbors.remove(nr->backptr);
-      if(nnr->backptr!=i) debug("Bad nbr backptr: %d!=%d\n",i,nnr->backptr);
-      if(nnr->nbr != udd) debug("Bad local backptr\n");
-      delete nnr; delete nr;
-    }
-  }
+  for(size_t i=0;i<udd->neighbors.max_id();i++)
+    if(udd->neighbors.get(i)) remove_pair(udd,i);
   // purge local lists & remove from cell
   udd->neighbors.clear();
-  Device* removed = (Device*)cells[udd->cell_id]->remove(udd->cell_loc);
-  if(removed!=d) { debug("Bad back cell reference!\n"); }
+  grid.remove(&udd->cell);
 }
 
 void UnitDiscRadio::add_device(Device* d) {
-  d->layers[id] = new UnitDiscDevice(this,d);
+  UnitDiscDevice* udd = new UnitDiscDevice(this,d);
+  d->layers[id] = udd;
+  grid.add(d,&udd->cell);
   connect_device(d);
 }
 /*
@@ -263,29 +269,147 @@ inline int find_nbr_index (Machine *m, uint16_t src_id) {
   return -1;
 }
 */
-void UnitDiscRadio::device_moved(Device* d) {
-  // now do the actual neighborhood update
-  disconnect_device(d); connect_device(d);
-  if(is_fast_prune_hood) { // delete the VM hood entries that are lost
-    for(NeighbourHood::iterator i = d->vm->hood.begin(); i != d->vm->hood.end(); i++){
-      i->in_range = false;
+bool UnitDiscRadio::needs_search(UnitDiscDevice* udd) {
+  const flo* p = udd->container->body->position();
+  return range3sqr(p,udd->search_pos) > skin*skin/16;
+}
+
+void UnitDiscRadio::device_moved(Device* d) { devices_moved(&d,1); }
+
+// Devices are updated one at a time, each hood pruned right after its
+// device is, unless so many must search that it is cheaper to rebuild all
+// neighbors at once; then the hoods are pruned after the rebuild.
+void UnitDiscRadio::devices_moved(Device** moved, int n) {
+  int n_search = 0;
+  for(int i=0;i<n;i++) { // searches must see every device in its new cell
+    UnitDiscDevice* udd = (UnitDiscDevice*)moved[i]->layers[id];
+    grid.move(moved[i],&udd->cell);
+    if(needs_search(udd)) n_search++;
+  }
+  if(n_search>0 && n_search >= rebuild_fraction*grid.num_members()) {
+    rebuild_neighbors();
+    if(is_fast_prune_hood) for(int i=0;i<n;i++) prune_hood(moved[i]);
+  } else {
+    for(int i=0;i<n;i++) {
+      UnitDiscDevice* udd = (UnitDiscDevice*)moved[i]->layers[id];
+      if(needs_search(udd)) connect_device(moved[i]);
+      else update_pairs(udd); // no device but the candidates can be in range
+      if(is_fast_prune_hood) prune_hood(moved[i]);
     }
-    d->vm->thisMachine().in_range = true;
+  }
+}
+
+/*****************************************************************************
+ *  BULK REBUILD                                                             *
+ *****************************************************************************/
+// When most devices must search, every device's candidates are found
+// afresh instead.  The devices are counting-sorted by cell, so that each
+// cell's positions lie together in memory, and searched in chunks, in
+// parallel when there are -threads.  Only merging the results into the
+// records, which touches pairs of devices, is serial.  The neighbors
+// that result are the same as searching one device at a time.
+#define REBUILD_CHUNK 256 // devices per parallel job
+
+void UnitDiscRadio::rebuild_neighbors() {
+  // number the devices and sort them by cell
+  bulk_devices.clear();
+  for(size_t i=0;i<parent->devices.max_id();i++) {
+    Device* d = (Device*)parent->devices.get(i); if(d==NULL) continue;
     UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
-    for(int i=0;i<udd->neighbors.max_id();i++) {
-      NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
-      if(nr) {
-        MachineId nid = nr->nbr->container->uid;
-        NeighbourHood::iterator nbr = d->vm->hood.find(nid);
-        if (nbr != d->vm->hood.end()) nbr->in_range = true;
+    udd->bulk_index = bulk_devices.size(); bulk_devices.push_back(udd);
+  }
+  int n = bulk_devices.size(), n_cells = grid.max_cell();
+  cell_start.assign(n_cells+1,0);
+  for(int i=0;i<n;i++) cell_start[bulk_devices[i]->cell.cell+1]++;
+  for(int c=0;c<n_cells;c++) cell_start[c+1] += cell_start[c];
+  sorted.resize(n); sorted_pos.resize(3*n);
+  vector<int> next(cell_start.begin(),cell_start.end()-1);
+  for(int i=0;i<n;i++) {
+    int k = next[bulk_devices[i]->cell.cell]++;
+    const flo* p = bulk_devices[i]->container->body->position();
+    sorted[k] = i;
+    for(int j=0;j<3;j++) sorted_pos[3*k+j] = p[j];
+  }
+  // search, in parallel if possible
+  int n_chunks = (n+REBUILD_CHUNK-1)/REBUILD_CHUNK;
+  chunk_cands.resize(n_chunks); chunk_ends.resize(n_chunks);
+  if(parent->workers) parent->workers->run(candidates_job,this,n_chunks);
+  else for(int c=0;c<n_chunks;c++) find_candidates(c);
+  // merge each device's candidates into its records
+  for(int c=0;c<n_chunks;c++) {
+    vector<int>& cands = chunk_cands[c]; vector<int>& ends = chunk_ends[c];
+    for(int i=c*REBUILD_CHUNK, k=0, e=0; e<(int)ends.size(); i++, e++) {
+      UnitDiscDevice* udd = bulk_devices[i];
+      int listed = ++search_mark, seen = ++search_mark;
+      for(int j=k;j<ends[e];j++) bulk_devices[cands[j]]->mark = listed;
+      for(size_t r=0;r<udd->neighbors.max_id();r++) {
+        NbrRecord* nr = (NbrRecord*)udd->neighbors.get(r);
+        if(!nr) continue;
+        if(nr->nbr->mark==listed) nr->nbr->mark = seen; // keep
+        else remove_pair(udd,r);
       }
-    }
-    for(NeighbourHood::iterator i = d->vm->hood.begin(); i != d->vm->hood.end(); ){
-      if (i->in_range) {
-        i++;
-      } else {
-        i = d->vm->hood.remove(i);
+      for(;k<ends[e];k++) {
+        UnitDiscDevice* nbr = bulk_devices[cands[k]];
+        if(nbr->mark==listed) { nbr->mark = seen; add_pair(udd,nbr); }
+      }
+      // each pair is brought up to date by its lower-numbered device
+      for(size_t r=0;r<udd->neighbors.max_id();r++) {
+        NbrRecord* nr = (NbrRecord*)udd->neighbors.get(r);
+        if(nr && nr->nbr->bulk_index > i) update_pair(udd,nr);
       }
+      const flo* p = udd->container->body->position();
+      for(int j=0;j<3;j++) udd->search_pos[j] = p[j];
+    }
+  }
+}
+
+void UnitDiscRadio::candidates_job(void* radio, int chunk)
+{ ((UnitDiscRadio*)radio)->find_candidates(chunk); }
+
+// find the candidates of one chunk of devices, reading only shared state
+void UnitDiscRadio::find_candidates(int chunk) {
+  vector<int>& cands = chunk_cands[chunk]; vector<int>& ends = chunk_ends[chunk];
+  cands.clear(); ends.clear();
+  METERS reach = range+skin;
+  flo c_sqr = reach*reach;
+  vector<int> near;
+  int last = min((chunk+1)*REBUILD_CHUNK,(int)bulk_devices.size());
+  for(int i=chunk*REBUILD_CHUNK;i<last;i++) {
+    const flo* p = bulk_devices[i]->container->body->position();
+    grid.find_cells(p,reach,&near);
+    for(size_t c=0;c<near.size();c++) {
+      for(int k=cell_start[near[c]];k<cell_start[near[c]+1];k++)
+        if(sorted[k]!=i && range3sqr(p,&sorted_pos[3*k])<c_sqr)
+          cands.push_back(sorted[k]);
+    }
+    ends.push_back(cands.size());
+  }
+}
+
+// delete the VM hood entries that are lost
+void UnitDiscRadio::prune_hood(Device* d) {
+  UnitDiscDevice* udd = (UnitDiscDevice*)d->layers[id];
+  // only entries of neighbors that have left range need deleting, unless
+  // something else (e.g. another radio) has added more
+  if(!udd->is_hood_lost && d->vm->hood.size() <= (Size)udd->num_in_range+1) return;
+  udd->is_hood_lost = false;
+  for(NeighbourHood::iterator i = d->vm->hood.begin(); i != d->vm->hood.end(); i++){
+    i->in_range = false;
+  }
+  d->vm->thisMachine().in_range = true;
+  for(size_t i=0;i<udd->neighbors.max_id();i++) {
+    NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
+    if(nr && nr->in_range) {
+      MachineId nid = nr->nbr->container->uid;
+      NeighbourHood::iterator nbr = d->vm->hood.find(nid);
+      if (nbr != d->vm->hood.end()) nbr->in_range = true;
+    }
+  }
+  for(NeighbourHood::iterator i = d->vm->hood.begin(); i != d->vm->hood.end(); ){
+    if (i->in_range) {
+      i++;
+    } else {
+      i = d->vm->hood.remove(i);
     }
   }
 }
@@ -293,28 +417,25 @@ void UnitDiscRadio::device_moved(Device* d) {
 /*****************************************************************************
  *  HARDWARE EMULATION                                                       *
  *****************************************************************************/
-Number UnitDiscRadio::read_radio_range () { return range; }
+Number UnitDiscRadio::read_radio_range (const VMContext& c) { return range; }
 
-int UnitDiscRadio::radio_send_export (uint8_t version, Array<Data> const & data) {
-  if(!try_tx())  // transmission failure
+int UnitDiscRadio::radio_send_export (const VMContext& c, uint8_t version,
+                                      Imports const & data) {
+  if(!try_tx(c.device))  // transmission failure
     return 0;
 
   // cache data
-  int src_id = device->uid;
+  int src_id = c.device->uid;
   // walk neighbors
-  UnitDiscDevice* udd = (UnitDiscDevice*)device->layers[id];
+  UnitDiscDevice* udd = (UnitDiscDevice*)c.device->layers[id];
   for(int i=0;i<udd->neighbors.max_id();i++) {
     NbrRecord* nr = (NbrRecord*)udd->neighbors.get(i);
-    if(nr && try_rx()) { // non-failing receive
+    if(nr && nr->in_range && try_rx(nr->nbr->container,c.device)) { // non-failing receive
       // hardware->set_vm_context(nr->nbr->container);
       /*radio_receive_export(src_id, version, timeout, -nr->dp[0], -nr->dp[1],
                            -nr->dp[2], n, buf);*/
       Neighbour & nbr = nr->nbr->container->vm->hood[src_id];
-      for(Size i = 0; i < data.size(); i++) nbr.imports[i] = data[i];
-      nbr.x = -nr->dp[0];
-      nbr.y = -nr->dp[1];
-      nbr.z = -nr->dp[2];
-      nbr.data_age = 0;
+      nbr.receive(data,-nr->dp[0],-nr->dp[1],-nr->dp[2]);
     }
   }
   // hardware->set_vm_context(udd->container); // restore context
@@ -361,13 +482,17 @@ int UnitDiscRadio::radio_send_digest (uint8_t version, uint16_t script_len,
  *****************************************************************************/
 
 UnitDiscDevice::UnitDiscDevice(UnitDiscRadio* parent, Device* container) 
-  : DeviceLayer(container) { this->parent = parent; }
+  : DeviceLayer(container) {
+  this->parent = parent; num_in_range = 0; mark = 0; bulk_index = -1;
+  is_hood_lost = false;
+  for(int i=0;i<3;i++) search_pos[i] = 0;
+}
 
 UnitDiscDevice::~UnitDiscDevice() {
   if(parent->is_fast_prune_hood) { // delete self from each neighbor
     for(int i=0;i<neighbors.max_id();i++) {
       NbrRecord* nr = (NbrRecord*)neighbors.get(i);
-      if(nr) {
+      if(nr && nr->in_range) {
 	Machine* nvm = nr->nbr->container->vm;
 	NeighbourHood::iterator i = nvm->hood.find(container->uid);
 	if (i != nvm->hood.end()) nvm->hood.remove(i);
@@ -384,7 +509,7 @@ void UnitDiscDevice::visualize() {
     container->text_scale(); // prepare to draw text
     char buf[20];
     glTranslatef(0, -1, 0);
-    sprintf(buf, "%2d", parent->device_cell(container));
+    sprintf(buf, "%2d", cell.cell);
     palette->use_color(UnitDiscRadio::RADIO_CELL_INFO);
     draw_text(2, 2, buf);
     glPopMatrix();
@@ -411,7 +536,7 @@ void UnitDiscDevice::visualize() {
       palette->use_color(UnitDiscRadio::NET_CONNECTION_SHARP);
       glLineWidth(1);
     } else {
-      if(parent->cell_lvls>1) {
+      if(parent->parent->is_3d()) {
         palette->scale_color(UnitDiscRadio::NET_CONNECTION_FUZZY,1,1,1,0.1);
       } else {
         palette->use_color(UnitDiscRadio::NET_CONNECTION_FUZZY);
@@ -422,7 +547,8 @@ void UnitDiscDevice::visualize() {
     glBegin(GL_LINES);
     for(int i=0;i<neighbors.max_id();i++) {
       NbrRecord* nr = (NbrRecord*)neighbors.get(i);
-      if(nr && (local_sharp || nr->nbr->container->uid > container->uid)) {
+      if(nr && nr->in_range &&
+         (local_sharp || nr->nbr->container->uid > container->uid)) {
         glVertex3f(0,0,0);
         glVertex3f(nr->dp[0],nr->dp[1],nr->dp[2]);
       }
@@ -11,16 +11,29 @@ in the file LICENSE in the MIT Proto distribution's top directory. */
 
 #include "spatialcomputer.h"
 #include "radio.h"
+#include "spatialhash.h"
+
+class UnitDiscDevice;
+
+// one device's record of a candidate neighbor (see UnitDiscRadio)
+struct NbrRecord {
+  UnitDiscDevice* nbr;
+  int backptr; // location of corresponding record in neighbor
+  bool in_range; // within range, rather than just within the skin
+  METERS dp[3]; // difference in position
+};
 
 class UnitDiscRadio : public RadioSim {
  public:
   // model options
   float range, r_sqr;        // radius of transmission (in meters) [and sq]
+  float skin;                // extra distance at which to track possible nbrs
   // display options
   bool is_show_logical_nbrs;
   bool is_show_radio;
   bool is_debug_radio;      // turn on radio debugging
   bool is_fast_prune_hood;  // prune the VM neighborhood on movement?
+  float rebuild_fraction;   // rebuild all nbrs when this many must search
   
  public:
   UnitDiscRadio(Args* args, SpatialComputer* parent, int n);
@@ -28,10 +41,13 @@ class UnitDiscRadio : public RadioSim {
   bool handle_key(KeyEvent* key);
   void add_device(Device* d);
   void device_moved(Device* d);
+  void devices_moved(Device** moved, int n);
+  bool is_thread_safe() { return true; } // sending is never parallel
 
   // hardware emulation
-  Number read_radio_range ();
-  int radio_send_export (uint8_t version, Array<Data> const & data);
+  Number read_radio_range (const VMContext& c);
+  int radio_send_export (const VMContext& c, uint8_t version,
+                         Imports const & data);
   int radio_send_script_pkt (uint8_t version, uint16_t n, 
 			     uint8_t pkt_num, uint8_t *script);
   int radio_send_digest (uint8_t version, uint16_t script_len, 
@@ -42,19 +58,34 @@ class UnitDiscRadio : public RadioSim {
 
   friend class UnitDiscDevice;
  protected:
-  // storage: gridded in range-size squares to cover screen
-  // an additional layer of cells coats the edges, covering all outside area
-  // it performs badly when devices are not well dispersed in the screen area
-  Population** cells; // collections of Device pointers
-  int cell_rows, cell_cols, cell_lvls, num_cells, lvl_size;
-  METERS cell_left, cell_bottom, cell_floor;
-  int device_cell(Device* d); // which cell is a device in?
-  void connect_to_cell(Device* d,int cell_id); // handle connections
-  void connect_device2(Device* d, int base); // iterate connection over 9 cells
-  void connect_device(Device *d); // create all connections
+  // storage: a hashed grid of (range+skin)-size cells, covering all space
+  SpatialHash grid;
+  std::vector<int> near_cells; // scratch for searching the grid
+  // Each device keeps records of every device within range+skin of it
+  // when it last searched the grid (its "candidates"), marked with
+  // whether they are within range.  A device searches again only when it
+  // has moved more than skin/4 from where it last searched: until then,
+  // no device outside its candidates can be in range.
+  vector<NbrRecord*> record_pool; // freed records, for reuse
+  int search_mark; // tags the candidates of the device now searching
+  NbrRecord* new_record(UnitDiscDevice* nbr);
+  void add_pair(UnitDiscDevice* a, UnitDiscDevice* b);
+  void remove_pair(UnitDiscDevice* udd, int i); // udd's ith record
+  void update_pair(UnitDiscDevice* udd, NbrRecord* nr); // check range
+  void update_pairs(UnitDiscDevice* udd); // check all of udd's records
+  void connect_device(Device *d); // search the grid for candidates
   void disconnect_device(Device *d); // delete all connections
-
-  void create_cell_representation();
+  void prune_hood(Device* d); // drop VM neighbors that are out of range
+  bool needs_search(UnitDiscDevice* udd); // moved too far for candidates?
+  // bulk rebuild: every device's candidates are found afresh, in parallel
+  vector<UnitDiscDevice*> bulk_devices; // all devices, by bulk_index
+  vector<int> cell_start;  // devices of cell c are sorted[cell_start[c]...]
+  vector<int> sorted;      // bulk indices, counting-sorted by cell
+  vector<flo> sorted_pos;  // their positions, 3 per device, in same order
+  vector<vector<int> > chunk_cands, chunk_ends; // search results per job
+  void rebuild_neighbors();
+  void find_candidates(int chunk); // one parallel job of the search
+  static void candidates_job(void* radio, int chunk);
   void change_radio_range(float newrange);
 
   virtual void register_colors();
@@ -65,14 +96,19 @@ class UnitDiscDevice : public DeviceLayer {
  public:
   UnitDiscRadio* parent;
   // these values are actually managed by the UnitDiscRadio
-  Population neighbors; // collection of NbrRecord* (internal definition)
-  int cell_id; // which cell the device was last in (before motion)
-  int cell_loc; // where is the device in its cell's list
+  Population neighbors; // collection of NbrRecord*
+  int num_in_range; // how many of the neighbors are within range
+  SpatialHandle cell; // where the device is filed in the grid
+  METERS search_pos[3]; // where the device last searched for neighbors
+  int mark; // equals parent->search_mark while a candidate of the searcher
+  int bulk_index; // place in parent->bulk_devices during a rebuild
+  bool is_hood_lost; // has a neighbor left range since the hood was pruned?
 
   UnitDiscDevice(UnitDiscRadio* parent, Device* container);
   ~UnitDiscDevice();
   void visualize();
   void copy_state(DeviceLayer* src) {} // to be called during cloning
+  void dump_values(DumpWriter* out) {} // nothing is dumped
 };
 
 #endif // __UNITDISCRADIO__
@@ -0,0 +1,102 @@
+/* Binary traces of the instructions executed by a device's VM
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "vmtrace.h"
+#include "utils.h"
+
+/*****************************************************************************
+ *  WRITING                                                                  *
+ *****************************************************************************/
+
+std::set<VMTrace*> VMTrace::unwritten;
+
+VMTrace::VMTrace(int uid, int capacity, const char* filename,
+                 const char* const* names) {
+  this->uid=uid; step=0; next=0; total=0;
+  this->filename=filename; this->names=names;
+  ring.resize(capacity<1 ? 1 : capacity);
+  static bool at_exit = false;
+  if(!at_exit) { atexit(write_unwritten); at_exit = true; }
+  unwritten.insert(this);
+}
+
+VMTrace::~VMTrace() { unwritten.erase(this); write(); }
+
+void VMTrace::write_unwritten() {
+  std::vector<VMTrace*> traces(unwritten.begin(),unwritten.end());
+  unwritten.clear();
+  for(size_t i=0;i<traces.size();i++) traces[i]->write();
+}
+
+bool VMTrace::write() {
+  FILE* out = fopen(filename,"wb");
+  if(out==NULL) { post("Unable to open VM trace file '%s'\n",filename); return false; }
+  uint32_t version = VMTRACE_VERSION, id = uid;
+  fwrite(VMTRACE_MAGIC,1,8,out);
+  fwrite(&version,sizeof(version),1,out); fwrite(&id,sizeof(id),1,out);
+  uint8_t lengths[256];
+  for(int i=0;i<256;i++) lengths[i] = names[i] ? strlen(names[i]) : 0;
+  fwrite(lengths,1,256,out);
+  for(int i=0;i<256;i++) fwrite(names[i],1,lengths[i],out);
+  // once the ring has wrapped, the oldest record is the next overwritten
+  uint32_t kept = (total < ring.size()) ? total : ring.size();
+  fwrite(&total,sizeof(total),1,out); fwrite(&kept,sizeof(kept),1,out);
+  if(kept==ring.size())
+    fwrite(&ring[next],sizeof(VMTraceRecord),ring.size()-next,out);
+  if(next) fwrite(&ring[0],sizeof(VMTraceRecord),next,out);
+  fclose(out);
+  post("Wrote VM trace of device %d to '%s'\n",uid,filename);
+  return true;
+}
+
+/*****************************************************************************
+ *  READING                                                                  *
+ *****************************************************************************/
+
+static void read_trace(FILE* in, void* dst, size_t size, size_t n) {
+  if(n && fread(dst,size,n,in)!=n) uerror("VM trace file is truncated");
+}
+
+VMTraceReader::VMTraceReader(FILE* in) {
+  char magic[8]; uint32_t version, id, kept; uint8_t lengths[256];
+  read_trace(in,magic,1,8);
+  if(memcmp(magic,VMTRACE_MAGIC,8)) uerror("Not a VM trace file");
+  read_trace(in,&version,sizeof(version),1);
+  if(version!=VMTRACE_VERSION)
+    uerror("Unknown VM trace version %d",(int)version);
+  read_trace(in,&id,sizeof(id),1); uid=id;
+  read_trace(in,lengths,1,256);
+  for(int i=0;i<256;i++) {
+    names[i].resize(lengths[i]);
+    if(lengths[i]) read_trace(in,&names[i][0],1,lengths[i]);
+  }
+  read_trace(in,&total,sizeof(total),1); read_trace(in,&kept,sizeof(kept),1);
+  records.resize(kept);
+  if(kept) read_trace(in,&records[0],sizeof(VMTraceRecord),kept);
+}
+
+std::string VMTraceReader::name(uint8_t opcode) {
+  if(!names[opcode].empty()) return names[opcode];
+  char buf[20]; sprintf(buf,"PLATFORM_%d",opcode); // a simulator extension
+  return buf;
+}
+
+void VMTraceReader::write_text(FILE* out) {
+  fprintf(out,"%% Device %d: %lu instructions, the last %lu kept\n",uid,
+          (unsigned long)total,(unsigned long)records.size());
+  fprintf(out,"%% \"TIME\" \"STEP\" \"IP\" \"STACK\" \"ENV\" \"OPCODE\" \"NAME\"\n");
+  for(size_t i=0;i<records.size();i++) {
+    const VMTraceRecord& r = records[i];
+    fprintf(out,"%.2f %u %u %u %u %u %s\n",r.time,(unsigned)r.step,
+            (unsigned)r.ip,(unsigned)r.stack,(unsigned)r.env,
+            (unsigned)r.opcode,name(r.opcode).c_str());
+  }
+}
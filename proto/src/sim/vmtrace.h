@@ -0,0 +1,90 @@
+/* Binary traces of the instructions executed by a device's VM
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#ifndef __VMTRACE__
+#define __VMTRACE__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+
+// With -trace-vm, a device records every instruction its VM executes in
+// a ring buffer that keeps the latest records, and writes them out when
+// the device is destroyed, or when the simulator exits.  The file
+// carries the opcode names of the VM that wrote it, so it can be printed
+// later (see trace2text) without knowing which instruction set was in
+// use.  All numbers are in the byte order of the machine that wrote the
+// file.
+//
+//   file:   "PROTOVMT" uint32(1) uint32 device uid
+//           uint8 name length[256], then the text of each name
+//           uint64 records traced, uint32 records kept, record*
+//   record: double time (when the run started), uint32 step (within the
+//           run), uint32 ip (opcode's offset in the script), uint16 data
+//           stack depth, uint16 environment depth, uint8 opcode, 3 pad
+
+#define VMTRACE_MAGIC "PROTOVMT"
+#define VMTRACE_VERSION 1
+
+struct VMTraceRecord {
+  double time;
+  uint32_t step, ip;
+  uint16_t stack, env;
+  uint8_t opcode, pad[3];
+};
+
+// The tracer that a traced device runs its VM with: Machine's
+// run_to_completion calls it before each instruction
+class VMTrace {
+ public:
+  // names are the opcode names written into the file
+  VMTrace(int uid, int capacity, const char* filename,
+          const char* const* names);
+  ~VMTrace(); // writes the file
+  void begin_run() { step = 0; } // steps are counted from each run's start
+  template<class M> void operator()(M& m) {
+    VMTraceRecord* r = &ring[next];
+    const uint8_t* ip = m.instruction_pointer;
+    r->time = m.startTime(); r->step = step++;
+    r->ip = ip - (const uint8_t*)m.currentScript();
+    r->stack = m.stack.size(); r->env = m.environment.size();
+    r->opcode = *ip; r->pad[0] = r->pad[1] = r->pad[2] = 0;
+    if(++next==ring.size()) next = 0;
+    total++;
+  }
+  // write the records, oldest first, with the names of the opcodes
+  bool write();
+
+ private:
+  int uid; uint32_t step;
+  const char* filename; const char* const* names;
+  std::vector<VMTraceRecord> ring;
+  size_t next;     // where the next record goes
+  uint64_t total;  // all records, including those overwritten
+  // the traces not yet written, for when the process exits without
+  // destroying their devices
+  static std::set<VMTrace*> unwritten;
+  static void write_unwritten();
+};
+
+// Reads a trace file back in
+class VMTraceReader {
+ public:
+  int uid;
+  uint64_t total;
+  std::string names[256]; // empty for opcodes that were not instructions
+  std::vector<VMTraceRecord> records;
+
+  VMTraceReader(FILE* in); // reads the whole file; errors are fatal
+  std::string name(uint8_t opcode); // never empty
+  void write_text(FILE* out);
+};
+
+#endif // __VMTRACE__
@@ -0,0 +1,92 @@
+/* Pool of worker threads for running devices in parallel
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors 
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#include "config.h"
+#include "workerpool.h"
+#include "memory.hpp"
+#include "utils.h"
+
+#ifdef THREAD_SAFE_VM
+
+WorkerPool::WorkerPool(int n_threads) {
+  this->n_threads = (n_threads<1) ? 1 : n_threads;
+  generation=0; working=0; shutdown=false;
+  job=NULL; context=NULL; n_jobs=0; next_job=0; collector=NULL;
+  pthread_mutex_init(&lock,NULL);
+  pthread_cond_init(&start,NULL);
+  pthread_cond_init(&done,NULL);
+  threads = new pthread_t[this->n_threads-1];
+  for(int i=0;i<this->n_threads-1;i++)
+    if(pthread_create(&threads[i],NULL,worker_main,this))
+      uerror("Could not start worker thread %d",i);
+}
+
+WorkerPool::~WorkerPool() {
+  pthread_mutex_lock(&lock);
+  shutdown=true;
+  pthread_cond_broadcast(&start);
+  pthread_mutex_unlock(&lock);
+  for(int i=0;i<n_threads-1;i++) pthread_join(threads[i],NULL);
+  delete[] threads;
+  pthread_cond_destroy(&done);
+  pthread_cond_destroy(&start);
+  pthread_mutex_destroy(&lock);
+}
+
+// take jobs until there are none left
+void WorkerPool::work() {
+  int i;
+  while((i = __sync_fetch_and_add(&next_job,1)) < n_jobs) job(context,i);
+}
+
+void* WorkerPool::worker_main(void* p) {
+  WorkerPool* pool = (WorkerPool*)p;
+  int seen = 0; // last generation worked on
+  pthread_mutex_lock(&pool->lock);
+  while(true) {
+    while(!pool->shutdown && pool->generation==seen)
+      pthread_cond_wait(&pool->start,&pool->lock);
+    if(pool->shutdown) break;
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+    pool->work();
+    pthread_mutex_lock(&pool->lock);
+    // report allocations as if the caller had made them
+    ((MemoryStatistics*)pool->collector)->take(MemoryStatistics::get());
+    if(--pool->working==0) pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+void WorkerPool::run(Job job, void* context, int n) {
+  if(n_threads==1 || n<=1) { // not worth waking anybody
+    for(int i=0;i<n;i++) job(context,i);
+    return;
+  }
+  pthread_mutex_lock(&lock);
+  this->job=job; this->context=context; n_jobs=n; next_job=0;
+  collector = &MemoryStatistics::get();
+  working = n_threads-1; generation++;
+  pthread_cond_broadcast(&start);
+  pthread_mutex_unlock(&lock);
+  work();
+  pthread_mutex_lock(&lock);
+  while(working>0) pthread_cond_wait(&done,&lock);
+  pthread_mutex_unlock(&lock);
+}
+
+#else // not built for threads: everything runs in the calling thread
+
+WorkerPool::WorkerPool(int n_threads) { this->n_threads=1; }
+WorkerPool::~WorkerPool() {}
+void WorkerPool::run(Job job, void* context, int n) {
+  for(int i=0;i<n;i++) job(context,i);
+}
+
+#endif // THREAD_SAFE_VM
@@ -0,0 +1,51 @@
+/* Pool of worker threads for running devices in parallel
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors 
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+#ifndef __WORKERPOOL__
+#define __WORKERPOOL__
+
+#include "config.h"
+#ifdef THREAD_SAFE_VM
+#include <pthread.h>
+#endif
+
+// A WorkerPool runs a numbered batch of independent jobs on a fixed set
+// of threads.  The thread calling run() takes part in the work, so a
+// pool of N threads starts N-1 of its own.  Which thread runs which job
+// is not defined: jobs must not depend on each other.
+// Unless built with --enable-threads, all jobs are run by the calling thread.
+class WorkerPool {
+ public:
+  typedef void (*Job)(void* context, int index);
+
+  WorkerPool(int n_threads);
+  ~WorkerPool();
+  int size() { return n_threads; }
+  // run job(context,i) for i = 0..n-1, returning when all are done
+  void run(Job job, void* context, int n);
+
+ private:
+  int n_threads;
+#ifdef THREAD_SAFE_VM
+  pthread_t* threads;
+  pthread_mutex_t lock;
+  pthread_cond_t start, done;
+  int generation;       // incremented for every batch
+  int working;          // number of workers still busy with the batch
+  bool shutdown;
+  // the current batch
+  Job job; void* context; int n_jobs;
+  volatile int next_job;
+  void* collector;      // MemoryStatistics of the thread calling run()
+
+  static void* worker_main(void* pool);
+  void work();
+#endif
+};
+
+#endif // __WORKERPOOL__
@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+''' protodump: loader for the binary dumps of proto -dump-binary
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory.
+'''
+
+'''
+
+Reads the .pdump files written by proto -dump-binary (the format is
+described in src/sim/dumpfile.h), and turns them back into the text of
+the .log files that proto would otherwise have written.
+
+USAGE:
+python protodump.py <file.pdump>     prints all frames as text
+'''
+
+import struct, sys
+
+MAGIC = b"PROTODMP"
+FRAME_MAGIC = b"FRAM"
+VERSION = 1
+HAS_VALUE = 0x01
+HAS_NETWORK = 0x02
+
+class DumpFormatError(Exception):
+    '''Thrown when a file is not a binary dump, or is truncated'''
+    pass
+
+class Frame:
+    '''
+    One dump of all the devices.  columns[c][d] is fixed column c (UID,
+    TICKS, TIME, then the dumped layers) of device d; values[d] is the
+    output of device d, a list of numbers or a string, and neighbors[d]
+    the list of its neighbors' ids (if they were dumped).
+    '''
+    def __init__(self):
+        self.time = 0.0
+        self.header = ""
+        self.precision = []
+        self.columns = []
+        self.values = None
+        self.neighbors = None
+
+    def n_devices(self):
+        if self.columns: return len(self.columns[0])
+        for v in (self.values, self.neighbors):
+            if v is not None: return len(v)
+        return 0
+
+    def to_text(self):
+        '''Returns the frame as its .log file would be'''
+        lines = [self.header]
+        for d in range(self.n_devices()):
+            fields = ["%.*f" % (p, c[d]) for (p, c) in zip(self.precision, self.columns)]
+            line = " ".join(fields)
+            if self.values is not None:
+                v = self.values[d]
+                line += " " + (" ".join(["%.2f" % x for x in v]) if isinstance(v, list) else v)
+            if self.neighbors is not None:
+                line += " %i" % len(self.neighbors[d])
+                line += "".join([" %i" % n for n in self.neighbors[d]])
+            lines.append(line + "\n")
+        return "".join(lines)
+
+class Reader:
+    def __init__(self, f):
+        self.f = f
+        self.order = "="
+
+    def read(self, n):
+        data = self.f.read(n)
+        if len(data) != n:
+            raise DumpFormatError("Dump file is truncated")
+        return data
+
+    def unpack(self, fmt, n = 1):
+        fmt = self.order + (fmt * n)
+        return struct.unpack(fmt, self.read(struct.calcsize(fmt)))
+
+    def next_frame(self):
+        '''Returns the next Frame, or None at the end of the file'''
+        while True:
+            magic = self.f.read(4)
+            if len(magic) == 0: return None
+            if magic == FRAME_MAGIC: break
+            # the start of a file, perhaps in the middle of concatenated ones
+            magic += self.read(4)
+            if magic != MAGIC:
+                raise DumpFormatError("Not a binary dump file")
+            version = self.read(4)
+            # the version tells us the byte order of the writer
+            for order in "<>":
+                if struct.unpack(order + "I", version)[0] == VERSION:
+                    self.order = order; break
+            else:
+                raise DumpFormatError("Unknown binary dump version")
+        frame = Frame()
+        (frame.time, header_len) = self.unpack("dI")
+        frame.header = self.read(header_len).decode("latin-1")
+        (n, cols, flags) = self.unpack("I", 3)
+        frame.precision = list(self.unpack("B", cols))
+        widths = self.unpack("B", cols)
+        for w in widths:
+            if w not in (4, 8):
+                raise DumpFormatError("Bad column width %d" % w)
+        frame.columns = [list(self.unpack("f" if w == 4 else "d", n)) for w in widths]
+        if flags & HAS_VALUE:
+            frame.values = []
+            for length in self.unpack("i", n):
+                if length >= 0:
+                    frame.values.append(list(self.unpack("d", length)))
+                else:
+                    frame.values.append(self.read(-length).decode("latin-1"))
+        if flags & HAS_NETWORK:
+            frame.neighbors = [list(self.unpack("i", c)) for c in self.unpack("i", n)]
+        return frame
+
+def read_frames(filename):
+    '''Returns a list of all the Frames in a binary dump file'''
+    f = open(filename, "rb")
+    try:
+        reader = Reader(f)
+        frames = []
+        while True:
+            frame = reader.next_frame()
+            if frame is None: return frames
+            frames.append(frame)
+    finally:
+        f.close()
+
+def to_text(filename):
+    '''
+    Returns all the frames of a binary dump file as text, one after
+    another, as in the log of a --test-mode run.
+    '''
+    return "".join([frame.to_text() for frame in read_frames(filename)])
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit("usage: python protodump.py <file.pdump>")
+    sys.stdout.write(to_text(sys.argv[1]))
@@ -22,6 +22,7 @@ python prototest.py <TestName> [one or more switches]
 '''
 
 import linecache, optparse, os, random, subprocess, sys
+import protodump
 prototest_version = "Prototest 0.75"
 #Global Variables
 verbosity = 1
@@ -167,6 +168,14 @@ class Test():
         if not dump_dir:
             current_dir = os.getcwd()
             dump_dir = os.path.join(current_dir,'dumps')
+        #A binary dump (-dump-binary) is turned into text next to it
+        binary = os.path.join(dump_dir, self.dumpfile_prefix + '.pdump')
+        if os.path.exists(binary):
+            textfile = binary + '.txt'
+            f = open(textfile, 'w')
+            f.write(protodump.to_text(binary))
+            f.close()
+            return textfile
         #Filter to find candidates for the dump file
         matches = [x for x in os.listdir(dump_dir) \
                    if x.startswith(self.dumpfile_prefix) and x.endswith('.log')]
@@ -198,6 +207,7 @@ class Test():
         protoarg = self.protoarg
         protoarg = protoarg.replace("$(PROTO)", proto_path)
         protoarg = protoarg.replace("$(P2B)", p2b_path)
+        protoarg = protoarg.replace("$(TRACE2TEXT)", trace2text_path)
         protoarg = protoarg.replace("$(DEMOS)", demos_path)
 
         try:
@@ -532,9 +542,11 @@ def main():
                       help="Path to the proto executable")
     parser.add_option("--p2b", dest="p2b",
                       help="Path to the p2b executable")
+    parser.add_option("--trace2text", dest="trace2text",
+                      help="Path to the trace2text executable")
     parser.add_option("--demos", dest="demos",
                       help="Path to the demos")
-    parser.set_defaults(verbosity=1, dumpdir="", proto="proto", p2b="p2b", demos="../../../demos")
+    parser.set_defaults(verbosity=1, dumpdir="", proto="proto", p2b="p2b", trace2text="trace2text", demos="../../../demos")
 
     #Parse Command Line Arguments
     (option, args) = parser.parse_args()
@@ -544,11 +556,13 @@ def main():
         global verbosity; global dump_dir; global recursive_dir_scan;
         global proto_path;
         global p2b_path;
+        global trace2text_path;
         global demos_path
         (verbosity, dump_dir, recursive_dir_scan) = \
             (option.verbosity, option.dump_dir, option.recursive)
         proto_path = option.proto
         p2b_path = option.p2b
+        trace2text_path = option.trace2text
         demos_path = option.demos
 
     #Build and Run Tests
@@ -0,0 +1,140 @@
+/* Checks UnitDiscRadio's neighbors against a search of every pair
+Copyright (C) 2005-2008, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// The radio keeps each device's neighbors up to date as devices move:
+// one device at a time while few have moved far (searching the hashed
+// grid only when a device has left its skin), and all at once when many
+// have.  A .test file only sees the result through the VM's hood, one
+// round late, so this moves the devices directly and checks the radio's
+// records after every step against the pairs within range, found by
+// comparing every device with every other.  The moves mix small steps
+// (records updated in place), longer ones (grid searched again, cells
+// emptied and refilled) and jumps far away (cells made and dropped), and
+// the range is changed now and then.  The same moves are checked with
+// the default -radio-rebuild, with devices only ever updated one by one,
+// and with every search done as a bulk rebuild.
+
+#include "config.h"
+#include <cstdio>
+#include <vector>
+#include "spatialcomputer.h"
+#include "unitdiscradio.h"
+#include "visualizer.h"
+
+#define N_STEPS 60 // each moving some of 300 devices
+
+// the radio layer of a computer
+static UnitDiscRadio* radio_of(SpatialComputer* c) {
+  for(size_t i=0;i<c->dynamics.max_id();i++) {
+    UnitDiscRadio* r = dynamic_cast<UnitDiscRadio*>((Layer*)c->dynamics.get(i));
+    if(r) return r;
+  }
+  return NULL;
+}
+
+// does every device have exactly the neighbors within range, with
+// consistent records on both sides?  Prints the first problem found.
+static bool check_neighbors(SpatialComputer* c, UnitDiscRadio* radio, int step) {
+  std::vector<Device*> d;
+  for(size_t i=0;i<c->devices.max_id();i++)
+    if(c->devices.get(i)) d.push_back((Device*)c->devices.get(i));
+  int n = d.size();
+  std::vector<char> in_range(n*n,0);
+  for(int i=0;i<n;i++) {
+    UnitDiscDevice* udd = (UnitDiscDevice*)d[i]->layers[radio->id];
+    int count = 0;
+    for(size_t k=0;k<udd->neighbors.max_id();k++) {
+      NbrRecord* nr = (NbrRecord*)udd->neighbors.get(k);
+      if(!nr) continue;
+      NbrRecord* back = (NbrRecord*)nr->nbr->neighbors.get(nr->backptr);
+      if(!back || back->nbr!=udd || back->backptr!=(int)k ||
+         back->in_range!=nr->in_range) {
+        printf("step %d: records of %d and %d do not match\n",step,
+               d[i]->uid,nr->nbr->container->uid);
+        return false;
+      }
+      if(nr->in_range) {
+        count++;
+        for(int j=0;j<n;j++)
+          if(d[j]==nr->nbr->container) in_range[i*n+j] = 1;
+      }
+    }
+    if(count!=udd->num_in_range) {
+      printf("step %d: device %d counts %d neighbors, has %d\n",step,
+             d[i]->uid,udd->num_in_range,count);
+      return false;
+    }
+  }
+  for(int i=0;i<n;i++) {
+    const flo* p = d[i]->body->position();
+    for(int j=0;j<n;j++) {
+      const flo* q = d[j]->body->position();
+      flo dx = p[0]-q[0], dy = p[1]-q[1], dz = p[2]-q[2];
+      bool near = i!=j && dx*dx+dy*dy+dz*dz < radio->r_sqr;
+      if(near != (bool)in_range[i*n+j]) {
+        printf("step %d: %d and %d are %s range, but %s\n",step,
+               d[i]->uid,d[j]->uid,near?"within":"out of",
+               near?"not neighbors":"neighbors");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// move some of the devices, the same way for the same step and seed
+static void move_devices(SpatialComputer* c, UnitDiscRadio* radio, int step) {
+  RandomStream rng = RandomStream(step+1);
+  std::vector<Device*> moved;
+  // every tenth step, move (nearly) all devices, so they rebuild in bulk
+  flo fraction = (step%10==9) ? 0.95 : 0.1;
+  for(size_t i=0;i<c->devices.max_id();i++) {
+    Device* d = (Device*)c->devices.get(i);
+    if(!d || rng.urnd(0,1) >= fraction) continue;
+    const flo* p = d->body->position();
+    // a step within skin/4, one of up to the range, or a jump away
+    flo kind = rng.urnd(0,1), r = radio->range;
+    flo reach = (kind<0.4) ? r/50 : (kind<0.9) ? r : 20*r;
+    flo x = p[0]+rng.urnd(-reach,reach), y = p[1]+rng.urnd(-reach,reach);
+    d->body->set_position(x,y,0);
+    moved.push_back(d);
+  }
+  if(!moved.empty()) radio->devices_moved(&moved[0],moved.size());
+  if(step%15==14) { // widen, then narrow, the range
+    KeyEvent key; key.normal = true; key.ctrl = false;
+    key.key = (step%30==14) ? 'R' : 'E';
+    for(int i=0;i<5;i++) radio->handle_key(&key);
+  }
+}
+
+static bool check(const char* rebuild) {
+  // no script is loaded, so there are no VM hoods to prune
+  const char* argv[] = { "radionbrs", "-n", "300", "-r", "10",
+                         "-radio-rebuild", rebuild, "-no-motion-pruning" };
+  Args args(sizeof(argv)/sizeof(argv[0]),(char**)argv);
+  SpatialComputer computer(&args,false,1);
+  UnitDiscRadio* radio = radio_of(&computer);
+  if(!radio) { printf("no UnitDiscRadio\n"); return false; }
+  bool ok = check_neighbors(&computer,radio,0);
+  for(int step=1; ok && step<=N_STEPS; step++) {
+    move_devices(&computer,radio,step);
+    ok = check_neighbors(&computer,radio,step);
+  }
+  printf("-radio-rebuild %s: %s\n",rebuild,ok?"ok":"FAILED");
+  return ok;
+}
+
+int main() {
+#ifdef WANT_GLUT
+  palette = Palette::default_palette; // as when running headless
+#endif // WANT_GLUT
+  bool ok = check("0.5");   // the default: one by one, in bulk when many move
+  ok = check("2") && ok;    // never in bulk
+  ok = check("0") && ok;    // always in bulk
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/* Checks the scheduling of VM threads with their own periods
+Copyright (C) 2005-2008, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// The compilers emit a single thread, so the .test files cannot check how
+// threads with their own periods share a device.  This runs a script with
+// two threads directly on the VM, the way the simulator wakes a device:
+// each run is followed by a sleep of Machine::next_run().  The threads
+// want to run every 2 and every 4 seconds and are due at the same time;
+// only one runs per round, and the other must follow one round later, not
+// a period later, or both end up running at a slower rate.
+
+#include <cstdio>
+#include <instructions.cpp>
+
+using namespace Instructions;
+
+// the script below uses no platform instructions
+void platform_operation(VMContext const & context, Int8 opcode) {}
+
+static Int8 const script[] = {
+  DEF_VM_EX_OP, 20, 0, 2, 2, 0, 0, 4, // stack, env, globals, threads, ...
+  DEF_FUN_3_OP, LIT_4_OP, SET_DT_OP, RET_OP, // thread 1: every 4 seconds
+  DEF_FUN_3_OP, LIT_2_OP, SET_DT_OP, RET_OP, // thread 0: every 2 seconds
+  ACTIVATE_OP, 0, ACTIVATE_OP, 1,
+  EXIT_OP
+};
+
+int main() {
+  Machine machine;
+  machine.install(Script(script, sizeof(script)));
+  machine.run_to_completion();
+  Time const round = 0.25, end = 60, period[2] = { 2, 4 };
+  for (int i = 0; i < 2; i++) { // as if both had run, in step, one period ago
+    machine.threads[i].desired_period = period[i];
+    machine.threads[i].last_time = -period[i];
+  }
+  int runs[2] = {0, 0};
+  for (Time now = 0; now < end; now += machine.next_run(now, round)) {
+    Time last[2] = { machine.threads[0].last_time, machine.threads[1].last_time };
+    machine.run(now);
+    machine.run_to_completion();
+    for (int i = 0; i < 2; i++) if (machine.threads[i].last_time != last[i]) runs[i]++;
+  }
+  bool ok = true;
+  for (int i = 0; i < 2; i++) {
+    int expected = end / period[i]; // one run per period
+    printf("thread %d (period %g): %d runs in %g s, expected %d\n", i,
+           machine.threads[i].desired_period, runs[i], end, expected);
+    if (runs[i] != expected) ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+/* Prints VM traces as text
+Copyright (C) 2005-2010, Jonathan Bachrach, Jacob Beal, and contributors
+listed in the AUTHORS file in the MIT Proto distribution's top directory.
+
+This file is part of MIT Proto, and is distributed under the terms of
+the GNU General Public License, with a linking exception, as described
+in the file LICENSE in the MIT Proto distribution's top directory. */
+
+// usage: trace2text FILE.vmtrace
+// Prints the instructions recorded by -trace-vm, oldest first, one per
+// line: the time of the run, the step within it, the opcode's offset in
+// the script, the depths of the data and environment stacks before the
+// instruction, and the opcode with its name.
+
+#include "config.h"
+#include <stdio.h>
+#include "utils.h"
+#include "vmtrace.h"
+
+int main(int argc, char *argv[]) {
+  if(argc!=2) uerror("usage: trace2text FILE.vmtrace");
+  FILE* in = fopen(argv[1],"rb");
+  if(in==NULL) uerror("Unable to open VM trace file '%s'",argv[1]);
+  VMTraceReader reader(in);
+  fclose(in);
+  reader.write_text(stdout);
+  return 0;
+}
@@ -14,6 +14,7 @@
 #ifndef __DATA_HPP
 #define __DATA_HPP
 
+#include <cstring>
 #include "memory.hpp"
 #include "types.hpp"
 #include "tuple.hpp"
@@ -73,6 +74,8 @@ class Data {
 		
 		/// Copy a Data object.
 		inline Data & operator = (Data const & data) {
+			if (data.value_type == Type_number) { reset(data.value.number); return *this; }
+			if (&data == this) return *this;
 			switch(data.type()){
 				case Type_undefined: reset();                 break;
 				case Type_number   : reset(data.asNumber ()); break;
@@ -84,10 +87,47 @@ class Data {
 		}
 		
 		/// Get a copy of a Data object.
-		inline Data(Data const & data) : value_type(Type_undefined) {
-			*this = data;
+		inline Data(Data const & data) : value_type(data.value_type) {
+			switch(value_type){
+				case Type_undefined:                                           break;
+				case Type_number   : value.number = data.value.number;         break;
+				case Type_tuple    : new (&value) Tuple    (data.asTuple  ()); break;
+				case Type_address  : new (&value) Address  (data.asAddress()); break;
+				case Type_field    : new (&value) FieldData(data.asField  ()); break;
+			}
 		}
 		
+		/// Take over the value of another Data object, which is left undefined.
+		/**
+		 * Unlike assignment, a Tuple or FieldData changes owner without its reference count being touched.
+		 */
+		inline void take(Data & data) {
+			if (&data == this) return;
+			reset();
+			value_type = data.value_type;
+			value = data.value;
+			data.value_type = Type_undefined;
+		}
+		
+		/// Exchange values with another Data object.
+		inline void swap(Data & data) {
+			Type  other_type  = data.value_type; data.value_type = value_type; value_type = other_type;
+			Value other_value = data.value     ; data.value      = value     ; value      = other_value;
+		}
+		
+#if __cplusplus >= 201103L
+		/// Move a Data object.
+		inline Data(Data && data) : value_type(data.value_type), value(data.value) {
+			data.value_type = Type_undefined;
+		}
+		
+		/// Move a Data object.
+		inline Data & operator = (Data && data) {
+			take(data);
+			return *this;
+		}
+#endif
+		
 		/// Check whether the value is set (true) or not (false).
 		inline bool isSet() const {
 			return value_type != Type_undefined;
@@ -114,13 +154,10 @@ class Data {
 		/// Reset the value to 'undefined' (ie. 'not set').
 		inline void reset() {
 #ifdef GC_COMP
-		    switch(value_type){
-			  case Type_undefined:                 break;
-			  case Type_number   : resetNumber (); break;
-			  case Type_tuple    : resetTuple  (); break;
-			  case Type_address  : resetAddress(); break;
-			  case Type_field    : resetField  (); break;
-		    }
+		    // only Tuples and FieldData own anything
+		    if      (value_type == Type_tuple) resetTuple();
+		    else if (value_type == Type_field) resetField();
+		    else value_type = Type_undefined;
 #endif
 		}
 		
@@ -141,6 +178,28 @@ class Data {
 			return *this;
 		}
 		
+		/// Check whether another Data object holds the same value (true) or not (false).
+		/**
+		 * Numbers are compared bit for bit, and Tuples element by element.
+		 * Fields are never considered the same, so the answer may be a false negative, but never a false positive.
+		 */
+		inline bool identical(Data const & data) const {
+			if (value_type != data.value_type) return false;
+			switch(value_type){
+				case Type_undefined: return true;
+				case Type_number   : return std::memcmp(&value.number, &data.value.number, sizeof(Number)) == 0;
+				case Type_address  : return asAddress() == data.asAddress();
+				case Type_tuple    : {
+					Tuple const & a = asTuple();
+					Tuple const & b = data.asTuple();
+					if (a.size() != b.size()) return false;
+					for(Index i = 0; i < a.size(); i++) if (!a[i].identical(b[i])) return false;
+					return true;
+				}
+				default: return false;
+			}
+		}
+		
 		/// Deconstruct the data.
 		inline ~Data() {
 			reset();
@@ -157,6 +216,20 @@ class Data {
 		
 };
 
+inline void FieldData::push(MachineId const & source, Data const & value) {
+  // a field made by a kernel shares only the ids of its operand: take them apart before adding to them
+  if (ids.instances() != instances()) ids = ids.copy();
+  if (isNumeric()) {
+    if (value.type() == Data::Type_number) { ids.push(source); numbers.push(value.asNumber()); return; }
+    spill();
+  }
+  ids.push(source); values.push(value);
+}
+
+inline Data FieldData::const_iterator::value() const {
+  return source->isNumeric() ? Data(source->numbers[index]) : source->values[index];
+}
+
 template<>
 class Stack<Data> : public BasicStack<Data> {
 	
@@ -214,17 +287,35 @@ public:
     contents[++top] = element;
   }
 
-  // Assumption that all stack elements are reset/scratch
-  inline void push(Number const number) {
+  /// Push a Number, Tuple, Address or FieldData, constructed in place.
+  /**
+   * No temporary Data is made, so a Tuple's reference count is only raised once.
+   */
+  template<typename Value>
+  inline void emplace(Value const & value) {
     if(full()) cerr << "Stack overflow: full with " << size() << " elements\n";
-    top++;
-    contents[top].value_type = Data::Type_number;
-    contents[top].value.number = number;
+    contents[++top].reset(value);
   }
   
+  inline void push(Number    const   number ) { emplace(number ); } ///< Push a Number.
+  inline void push(Tuple     const & tuple  ) { emplace(tuple  ); } ///< Push a Tuple.
+  inline void push(Address   const & address) { emplace(address); } ///< Push an Address.
+  inline void push(FieldData const & field  ) { emplace(field  ); } ///< Push a FieldData.
+
+  /// Push the value of \p element, which is left undefined.
+  inline void pushFrom(Data & element) {
+    if(full()) cerr << "Stack overflow: full with " << size() << " elements\n";
+    contents[++top].take(element);
+  }
+#if __cplusplus >= 201103L
+  /// Push a temporary element, by moving it.
+  inline void push(Data && element) { pushFrom(element); }
+#endif
+  
   inline void set_top(Data const & element) {
     contents[top] = element;
   }
+  /// Replace the Number on top of the stack with another.
   inline void replaceNumber(Number const number) {
     // ensure we are replacing a number
     assert(contents[top].value_type == Data::Type_number);
@@ -239,10 +330,33 @@ public:
 //   }
   
   /// Pop an element from the stack.
+  /**
+   * The element stays valid until the next push.
+   */
   inline Data& pop() {
     return contents[top--];
   }
   
+  /// Pop an element from the stack into \p element, without copying it.
+  inline void popInto(Data & element) {
+    element.take(contents[top--]);
+  }
+  
+  /// Check whether the top \p elements elements are all Numbers.
+  /**
+   * Instructions check this to take their Number fast path, which needs no type switches or reference counting.
+   */
+  inline bool topNumbers(Size elements) const {
+    for(Size i = 0; i < elements; i++)
+      if(contents[top-i].value_type != Data::Type_number) return false;
+    return true;
+  }
+  
+  /// Get the Number on top of the stack (which must be a Number).
+  inline Number peekNumber() const {
+    return contents[top].value.number;
+  }
+  
   /// Remove multiple elements from the stack.
   inline void pop(Size elements) {
     top -= elements; // memory leak spot
@@ -27,12 +27,23 @@ class Machine;
  * \brief Essentially a SharedVector of MachineId,Data pairs.
  * 
  * One of the types that can be stored in Data.
+ * 
+ * A field whose values are all Numbers keeps them in a contiguous array instead,
+ * so the math instructions can run over it without a round trip through the machine per element.
+ * It switches to holding Data when a value of another type is pushed.
  */
 
 class FieldData {
 protected:
   SharedVector<MachineId> ids;
-  SharedVector<Data> values;
+  SharedVector<Data> values;    // empty while the field only holds Numbers
+  SharedVector<Number> numbers; // the values of a Number field
+
+  /// Construct a Number field, sharing its ids with another field.
+  inline FieldData(SharedVector<MachineId> const & ids, SharedVector<Number> const & numbers) : ids(ids), numbers(numbers) {}
+
+  // Move the Numbers into values, before a value of another type is pushed.
+  void spill();
 
 public:
   class const_iterator {
@@ -48,7 +59,7 @@ public:
     inline const_iterator & operator ++ () { index++; return *this;}
     inline const_iterator & operator ++ (int) { index++; return *this;}
     inline MachineId const & id() const { return source->ids[index]; }
-    inline Data const &   value(); // defined in instructions/hood.cpp
+    inline Data value() const; // defined in data.hpp
   };
 
   // 1 and 2 input pointwise applications of instructions:
@@ -61,17 +72,31 @@ public:
   inline FieldData() {};
   
   /// Allocate a new field with the specified initial capacity.
-  inline explicit FieldData(Size capacity) : ids(capacity), values(capacity) {}
+  inline explicit FieldData(Size capacity) : ids(capacity), numbers(capacity) {}
   
   /// Construct another instance of this field
   /**
    * \note The contents will be shared. Use copy() to get a copy.
    */
-  inline FieldData(FieldData const & source) : ids(source.ids), values(source.values) {}
+  inline FieldData(FieldData const & source) : ids(source.ids), values(source.values), numbers(source.numbers) {}
   
   /// Add a pair to the back of the field.
-  inline void push(MachineId const & source, Data const & value) {
-    ids.push(source); values.push(value);
+  inline void push(MachineId const & source, Data const & value); // defined in data.hpp
+  
+  /// Make sure the field can hold at least the given number of pairs without reallocating.
+  inline void reserve(Size capacity) {
+    ids.reserve(capacity);
+    if (isNumeric()) numbers.reserve(capacity); else values.reserve(capacity);
+  }
+  
+  /// Check whether all values are Numbers, kept in numberValues().
+  inline bool isNumeric() const {
+    return values.empty();
+  }
+  
+  /// The values of a Number field (see isNumeric()).
+  inline Number const * numberValues() const {
+    return numbers;
   }
   
   /// Get the contents from another field.
@@ -82,7 +107,7 @@ public:
    * \endcode
    */
   inline FieldData & operator = (FieldData const & source) {
-    ids = source.ids; values = source.values;
+    ids = source.ids; values = source.values; numbers = source.numbers;
     return *this;
   }
   
@@ -92,13 +117,13 @@ public:
    */
   inline FieldData copy() const {
     FieldData f = FieldData(size());
-    f.ids = ids.copy(); f.values = values.copy();
+    f.ids = ids.copy(); f.values = values.copy(); f.numbers = numbers.copy();
     return f;
   }
   
   /// The number of elements in this field
   inline Size size() const {
-    return values.size();
+    return ids.size();
   }
   
   /// Check whether the field is empty (true) or not (false).
@@ -108,12 +133,12 @@ public:
   
   /// The field current capacity.
   inline Size capacity() const {
-    return values.capacity();
+    return ids.capacity();
   }
   
   /// The number of instances with the same shared contents including this one.
   inline Counter instances() const {
-    return values.instances();
+    return isNumeric() ? numbers.instances() : values.instances();
   }
   
   /// Deconstruct the field.
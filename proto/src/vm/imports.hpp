@@ -0,0 +1,106 @@
+/*   ____       _  __ _   ____            _
+ *  |  _ \  ___| |/ _| |_|  _ \ _ __ ___ | |_ ___
+ *  | | | |/ _ \ | |_| __| |_) | '__/ _ \| __/ _ \
+ *  | |_| |  __/ |  _| |_|  __/| | ( (_) | |( (_) )
+ *  |____/ \___|_|_|  \__|_|   |_|  \___/ \__\___/
+ *
+ * This file is part of DelftProto.
+ * See COPYING for license details.
+ */
+
+/// \file
+/// Provides the Imports class.
+
+#ifndef __IMPORTS_HPP
+#define __IMPORTS_HPP
+
+#include "types.hpp"
+#include "data.hpp"
+#include "sharedvector.hpp"
+
+/// The imports of a Neighbour: an immutable snapshot of the exports of a machine.
+/**
+ * Assigning Imports shares the snapshot instead of copying the Data in it,
+ * so delivering the exports of a machine to a neighbour takes constant time,
+ * no matter how many exports there are.
+ *
+ * The machine itself writes its exports with set(). When the snapshot it is writing to
+ * has been delivered to neighbours, it first switches to a private buffer holding the same values,
+ * so the neighbours keep seeing the exports as they were when they were sent.
+ * Two buffers are kept for this: the one being written and the one last sent.
+ * Once every neighbour has received a newer snapshot (or dropped the machine from its hood),
+ * the old buffer is reused, so a machine that keeps sending normally stops allocating.
+ */
+class Imports {
+
+	protected:
+		typedef SharedVector<Data> Snapshot;
+
+		/// The current values, possibly shared with neighbours.
+		Snapshot snapshot;
+
+		/// The other buffer, which is reused once it is no longer shared.
+		Snapshot spare;
+
+		/// Make the snapshot private to this instance, keeping its values.
+		inline void detach() {
+			if (spare.instances() == 1 && spare.size() == snapshot.size()){
+				Data * target = spare;
+				Data const * source = static_cast<Snapshot const &>(snapshot);
+				for(Index i = 0; i < snapshot.size(); i++) target[i] = source[i];
+				Snapshot sent = snapshot;
+				snapshot = spare;
+				spare = sent;
+			} else {
+				spare = snapshot;
+				snapshot = spare.copy();
+			}
+		}
+
+	public:
+		/// Create the given number of imports, all of them unset.
+		explicit Imports(Size size = 0) : snapshot(size) {
+			for(Index i = 0; i < size; i++) snapshot.push(Data());
+		}
+
+		/// Share the snapshot of another instance.
+		Imports(Imports const & imports) : snapshot(imports.snapshot) {}
+
+		/// Replace the values by the snapshot of another instance, without copying them.
+		inline Imports & operator = (Imports const & imports) {
+			if (!shares(imports)) snapshot = imports.snapshot;
+			return *this;
+		}
+
+		/// Change a value.
+		/**
+		 * Instances sharing the previous snapshot are not affected.
+		 * Writing a value that is identical to the current one keeps the snapshot shared.
+		 */
+		inline void set(Index index, Data const & value) {
+			if (snapshot.instances() > 1){
+				if ((*this)[index].identical(value)) return;
+				detach();
+			}
+			static_cast<Data *>(snapshot)[index] = value;
+		}
+		
+		/// Check whether another instance shares the snapshot of this one (true) or not (false).
+		/**
+		 * Since a snapshot is not changed while it is shared, sharing it means having the same values.
+		 */
+		inline bool shares(Imports const & imports) const {
+			return static_cast<Data const *>(imports.snapshot) == static_cast<Data const *>(snapshot);
+		}
+
+		/// Constant access to the values.
+		inline Data const & operator [] (Index index) const {
+			return static_cast<Snapshot const &>(snapshot)[index];
+		}
+
+		/// The number of imports.
+		inline Size size() const { return snapshot.size(); }
+
+};
+
+#endif
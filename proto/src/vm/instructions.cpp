@@ -12,7 +12,8 @@
  * \brief Provides the \ref Instructions "Instruction" implementations.
  * 
  * This file includes the source files in the folder <tt>instructions/</tt>,
- * and then defines the \ref instructions lookup table,
+ * and then defines the \ref instructions lookup table (with the names of the
+ * instructions, and the Machine's dispatch table built from it),
  * to make sure the all the used template functions are instantiated.
  */
 
@@ -38,4 +39,22 @@ Instruction instructions[256] = {
 #	undef INSTRUCTION
 #	undef INSTRUCTION_N
 };
+
+char const * instruction_names[256] = {
+#	define INSTRUCTION(name) #name,
+#	define INSTRUCTION_N(name,n) #name "_" #n,
+#	include <delftproto.instructions>
+#	undef INSTRUCTION
+#	undef INSTRUCTION_N
+};
+
+Instruction Machine::dispatch[256];
+
+static bool fill_dispatch() {
+	for (int i = 0; i < 256; i++)
+		Machine::dispatch[i] = instructions[i] ? instructions[i] : Machine::dispatch_unknown;
+	return true;
+}
+
+static bool dispatch_filled = fill_dispatch();
 /** \endcond */
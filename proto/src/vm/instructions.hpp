@@ -52,6 +52,9 @@ typedef void (*Instruction)(Machine &);
 /// Lookup table for all instructions by their opcode.
 extern Instruction instructions[256];
 
+/// The names of all instructions by their opcode (0 for opcodes that are not instructions).
+extern char const * instruction_names[256];
+
 /** \cond */
 
 namespace Instructions {
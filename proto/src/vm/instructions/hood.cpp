@@ -11,9 +11,187 @@
 /// \file
 /// Provides the hood instructions
 
+#include <math.hpp>
 #include <machine.hpp>
 #include <instructions.hpp>
 
+namespace {
+	
+	/// \name Number field kernels
+	/// The math instructions over Number fields run as these loops over their contiguous values, instead of once per element.
+	/// Each kernel gives the same result for every element as the instruction does on a pair of Numbers.
+	/// \{
+	
+#ifdef __GNUC__
+	// A group of Numbers that the kernels handle at once, with SIMD instructions where the target has them.
+	typedef Number Lanes __attribute__((vector_size(4 * sizeof(Number)), aligned(sizeof(Number)), may_alias));
+	Size const lanes = 4;
+#endif
+	
+	template<typename T> inline T splat(Number x) { return x; }
+#ifdef __GNUC__
+	template<> inline Lanes splat<Lanes>(Number x) { Lanes v = {x, x, x, x}; return v; }
+#endif
+	
+	struct AddKernel { template<typename T> static inline T apply(T a, T b) { return a + b; } };
+	struct SubKernel { template<typename T> static inline T apply(T a, T b) { return a - b; } };
+	struct MulKernel { template<typename T> static inline T apply(T a, T b) { return a * b; } };
+	struct DivKernel { template<typename T> static inline T apply(T a, T b) { return a / b; } };
+	struct MinKernel { template<typename T> static inline T apply(T a, T b) { return a < b ? a : b; } };
+	struct MaxKernel { template<typename T> static inline T apply(T a, T b) { return a > b ? a : b; } };
+	struct EqKernel  { template<typename T> static inline T apply(T a, T b) { return a == b ? splat<T>(1) : splat<T>(0); } };
+	struct NeqKernel { template<typename T> static inline T apply(T a, T b) { return a != b ? splat<T>(1) : splat<T>(0); } };
+	struct LtKernel  { template<typename T> static inline T apply(T a, T b) { return a <  b ? splat<T>(1) : splat<T>(0); } };
+	struct LteKernel { template<typename T> static inline T apply(T a, T b) { return a <= b ? splat<T>(1) : splat<T>(0); } };
+	struct GtKernel  { template<typename T> static inline T apply(T a, T b) { return a >  b ? splat<T>(1) : splat<T>(0); } };
+	struct GteKernel { template<typename T> static inline T apply(T a, T b) { return a >= b ? splat<T>(1) : splat<T>(0); } };
+	
+	struct AbsKernel { template<typename T> static inline T apply(T a) { return a < splat<T>(0) ? -a : a; } };
+	struct SqrtKernel {
+		static inline Number apply(Number a) { return sqrt(a); }
+#ifdef __GNUC__
+		static inline Lanes apply(Lanes a) { for(Index i = 0; i < lanes; i++) a[i] = sqrt(Number(a[i])); return a; }
+#endif
+	};
+	
+	/// Apply a kernel to \p n pairs of Numbers. When \p a_array or \p b_array is false, that side is the single Number it points to.
+	template<typename Kernel>
+	void run(Number const * a, bool a_array, Number const * b, bool b_array, Number * out, Size n) {
+		if (!n) return;
+		Index i = 0;
+#ifdef __GNUC__
+		Lanes const a_splat = splat<Lanes>(*a), b_splat = splat<Lanes>(*b);
+		for(; i + lanes <= n; i += lanes){
+			Lanes x = a_array ? *reinterpret_cast<Lanes const *>(a + i) : a_splat;
+			Lanes y = b_array ? *reinterpret_cast<Lanes const *>(b + i) : b_splat;
+			*reinterpret_cast<Lanes *>(out + i) = Kernel::apply(x, y);
+		}
+#endif
+		for(; i < n; i++) out[i] = Kernel::apply(a_array ? a[i] : *a, b_array ? b[i] : *b);
+	}
+	
+	/// Apply a kernel to \p n Numbers.
+	template<typename Kernel>
+	void run(Number const * a, Number * out, Size n) {
+		Index i = 0;
+#ifdef __GNUC__
+		for(; i + lanes <= n; i += lanes)
+			*reinterpret_cast<Lanes *>(out + i) = Kernel::apply(*reinterpret_cast<Lanes const *>(a + i));
+#endif
+		for(; i < n; i++) out[i] = Kernel::apply(a[i]);
+	}
+	
+	typedef void (*BinaryKernel)(Number const *, bool, Number const *, bool, Number *, Size);
+	typedef void (*UnaryKernel)(Number const *, Number *, Size);
+	
+	/// The kernel that does what the given instruction does on two Numbers, if there is one.
+	BinaryKernel binaryKernel(Instruction instruction) {
+		using namespace Instructions;
+		if (instruction == ADD) return run<AddKernel>;
+		if (instruction == SUB) return run<SubKernel>;
+		if (instruction == MUL) return run<MulKernel>;
+		if (instruction == DIV) return run<DivKernel>;
+		if (instruction == MIN) return run<MinKernel>;
+		if (instruction == MAX) return run<MaxKernel>;
+		if (instruction == EQ ) return run<EqKernel >;
+#if MIT_COMPATIBILITY != MIT_ONLY
+		if (instruction == NEQ) return run<NeqKernel>;
+#endif
+		if (instruction == LT ) return run<LtKernel >;
+		if (instruction == LTE) return run<LteKernel>;
+		if (instruction == GT ) return run<GtKernel >;
+		if (instruction == GTE) return run<GteKernel>;
+		return 0;
+	}
+	
+	/// The kernel that does what the given instruction does on a Number, if there is one.
+	UnaryKernel unaryKernel(Instruction instruction) {
+		if (instruction == Instructions::ABS ) return run<AbsKernel >;
+		if (instruction == Instructions::SQRT) return run<SqrtKernel>;
+		return 0;
+	}
+	
+	/// Fold Numbers with the MIN or MAX kernel, as MIN_HOOD folds a field with the MIN instruction.
+	template<typename Kernel>
+	Number fold(Number init, Number const * a, Size n) {
+		Index i = 0;
+		Number result = init;
+#ifdef __GNUC__
+		if (n >= 2 * lanes) {
+			Lanes acc = splat<Lanes>(init), nan = splat<Lanes>(0);
+			for(; i + lanes <= n; i += lanes){
+				Lanes x = *reinterpret_cast<Lanes const *>(a + i);
+				acc = Kernel::apply(acc, x);
+				nan = x != x ? splat<Lanes>(1) : nan;
+			}
+			for(; i < n; i++){
+				acc[0] = Kernel::apply(Number(acc[0]), a[i]);
+				if (a[i] != a[i]) nan[0] = 1;
+			}
+			if (!(nan[0] || nan[1] || nan[2] || nan[3])) {
+				for(Index l = 0; l < lanes; l++) result = Kernel::apply(result, Number(acc[l]));
+				// A sequential fold ends on the last of the values equal to the extreme (which matters for -0 and 0).
+				for(Index j = n; j-- > 0;) if (a[j] == result) return a[j];
+				return init;
+			}
+			// A sequential fold forgets a NaN again at the next element, so repeat it that way.
+			i = 0;
+			result = init;
+		}
+#endif
+		for(; i < n; i++) result = Kernel::apply(result, a[i]);
+		return result;
+	}
+
+	/// \}
+
+	/// \name Neighbourhood fuse functions
+	/// The fuse functions of the fused hood folds, which fold into \p result the import of the next neighbour.
+	/// Each gives the same result as the fuse function that FOLD_HOOD_PLUS would call back into: a Number overload for the common case, and a Data one for the rest.
+	/// \{
+
+	struct MinFuse {
+		static inline Number apply(Number a, Number b) { return a < b ? a : b; }
+		static inline void apply(Data & result, Data const & import) { if (!(compare(result, import) < 0)) result = import; }
+	};
+
+	struct MaxFuse {
+		static inline Number apply(Number a, Number b) { return a > b ? a : b; }
+		static inline void apply(Data & result, Data const & import) { if (!(compare(result, import) > 0)) result = import; }
+	};
+
+	struct SumFuse {
+		static inline Number apply(Number a, Number b) { return a + b; }
+		static void apply(Data & result, Data const & import) {
+			// as VADD, which the Vector sums fuse with
+			Tuple a = ensureTuple(result);
+			Tuple b = ensureTuple(import);
+			Size min_size = a.size() < b.size() ? a.size() : b.size();
+			Size max_size = a.size() < b.size() ? b.size() : a.size();
+			Tuple const & largest = a.size() < b.size() ? b : a;
+			Tuple sum(max_size);
+			for(Index i = 0       ; i < min_size; i++) sum.push(a[i].asNumber() + b[i].asNumber());
+			for(Index i = min_size; i < max_size; i++) sum.push(largest[i].asNumber());
+			result = sum;
+		}
+	};
+
+	/// (muxor a b), which is (mux a a b).
+	struct AnyFuse {
+		static inline Number apply(Number a, Number b) { return a ? a : b; }
+		static inline void apply(Data & result, Data const & import) { if (!result.asNumber()) result = import; }
+	};
+
+	/// (muxand a b), which is (mux a b 0).
+	struct AllFuse {
+		static inline Number apply(Number a, Number b) { return a ? b : 0; }
+		static inline void apply(Data & result, Data const & import) { result = result.asNumber() ? import : Data(Number(0)); }
+	};
+
+	/// \}
+
+}
+
 struct HoodInstructions {
 	
 	static void fold_hood(Machine & machine) {
@@ -24,7 +202,7 @@ struct HoodInstructions {
 		
 		machine.current_import = import_index;
 		
-		machine.thisMachine().imports[import_index] = export_value;
+		machine.thisMachine().imports.set(import_index, export_value);
 		
 		machine.current_neighbour = machine.hood.begin();
 		
@@ -55,7 +233,7 @@ struct HoodInstructions {
 		
 		machine.current_import = import_index;
 		
-		machine.thisMachine().imports[import_index] = export_value;
+		machine.thisMachine().imports.set(import_index, export_value);
 		
 		machine.current_neighbour = machine.hood.begin();
 		
@@ -94,9 +272,42 @@ struct HoodInstructions {
 		machine.environment.pop(2);
 		fold_hood_filter_next(machine);
 	}
+
+	template<typename Fuse>
+	static void fold_hood_fused(Machine & machine) {
+		Index import_index = machine.nextInt();
+		Data & result = machine.stack.peek();
+
+		machine.thisMachine().imports.set(import_index, result);
+
+		// The first neighbour is this machine, whose import is the export itself.
+		bool numeric = result.type() == Data::Type_number;
+		Number number = numeric ? result.asNumber() : 0;
+		NeighbourHood::iterator neighbour = machine.hood.begin();
+		while(++neighbour != machine.hood.end()){
+			Data const & import = neighbour->imports[import_index];
+			if (!import.isSet()) continue;
+			if (numeric && import.type() == Data::Type_number) {
+				number = Fuse::apply(number, import.asNumber());
+				continue;
+			}
+			if (numeric) {
+				machine.stack.replaceNumber(number);
+				numeric = false;
+			}
+			Fuse::apply(result, import);
+		}
+		if (numeric) machine.stack.replaceNumber(number);
+	}
 	
   static void fold_field(Machine & machine, Data& init, Instruction fuser) {
-    Data f = machine.stack.pop();
+    Data f;
+    machine.stack.popInto(f);
+    if (f.asField().isNumeric() && init.type() == Data::Type_number) {
+      FieldData const & field = f.asField();
+      if (fuser == Instructions::MIN) { machine.stack.push(fold<MinKernel>(init.asNumber(), field.numberValues(), field.size())); return; }
+      if (fuser == Instructions::MAX) { machine.stack.push(fold<MaxKernel>(init.asNumber(), field.numberValues(), field.size())); return; }
+    }
     FieldData::const_iterator fi = f.asField().begin();
     machine.stack.push(init);
     while(fi.hasNext()) {
@@ -117,7 +328,7 @@ namespace Instructions {
   // WARNING: THIS IS A TEST INSTRUCTION AND NOT COMPATIBLE WITH IF
   void NBR_IDS(Machine & machine) {
     NeighbourHood::iterator nbr = machine.hood.begin();
-    FieldData result = FieldData();
+    FieldData result = FieldData(machine.hood.size());
     while(nbr != machine.hood.end()) {
       result.push(nbr->id,nbr->id);
       nbr++;
@@ -217,17 +428,104 @@ namespace Instructions {
 		machine.nextInt8();
 		HoodInstructions::fold_hood_plus(machine);
 	}
-	
+
+	/// Fold all imported values for a specific neighbourhood variable with MIN and update the corresponding export.
+	/**
+	 * This does what FOLD_HOOD_PLUS does with MIN as fuse function and no filter, but in a single loop over the neighbours, without calling back into the script.
+	 *
+	 * \param Int The index of the neighbourhood (ie. import/export) variable.
+	 * \param Data The new export value for this Machine.
+	 *
+	 * \return Data The smallest of the values.
+	 */
+	void FOLD_HOOD_MIN(Machine & machine){
+		HoodInstructions::fold_hood_fused<MinFuse>(machine);
+	}
+
+	/// \deprecated_mitproto{FOLD_HOOD_MIN}
+	void VFOLD_HOOD_MIN(Machine & machine){
+		machine.nextInt8();
+		HoodInstructions::fold_hood_fused<MinFuse>(machine);
+	}
+
+	/// Fold all imported values for a specific neighbourhood variable with MAX and update the corresponding export.
+	/**
+	 * \see FOLD_HOOD_MIN
+	 *
+	 * \return Data The largest of the values.
+	 */
+	void FOLD_HOOD_MAX(Machine & machine){
+		HoodInstructions::fold_hood_fused<MaxFuse>(machine);
+	}
+
+	/// \deprecated_mitproto{FOLD_HOOD_MAX}
+	void VFOLD_HOOD_MAX(Machine & machine){
+		machine.nextInt8();
+		HoodInstructions::fold_hood_fused<MaxFuse>(machine);
+	}
+
+	/// Fold all imported values for a specific neighbourhood variable with ADD and update the corresponding export.
+	/**
+	 * \see FOLD_HOOD_MIN
+	 *
+	 * \return Data The sum of the values.
+	 */
+	void FOLD_HOOD_SUM(Machine & machine){
+		HoodInstructions::fold_hood_fused<SumFuse>(machine);
+	}
+
+	/// \deprecated_mitproto{FOLD_HOOD_SUM}
+	void VFOLD_HOOD_SUM(Machine & machine){
+		machine.nextInt8();
+		HoodInstructions::fold_hood_fused<SumFuse>(machine);
+	}
+
+	/// Fold all imported values for a specific neighbourhood variable with (muxor a b) and update the corresponding export.
+	/**
+	 * \see FOLD_HOOD_MIN
+	 *
+	 * \return Number The first value that is not 0, or the last value if there is none.
+	 */
+	void FOLD_HOOD_ANY(Machine & machine){
+		HoodInstructions::fold_hood_fused<AnyFuse>(machine);
+	}
+
+	/// Fold all imported values for a specific neighbourhood variable with (muxand a b) and update the corresponding export.
+	/**
+	 * \see FOLD_HOOD_MIN
+	 *
+	 * \return Number The last value if none of the others is 0, or 0 otherwise.
+	 */
+	void FOLD_HOOD_ALL(Machine & machine){
+		HoodInstructions::fold_hood_fused<AllFuse>(machine);
+	}
+
 	/// \}
 	
 }
 
-Data const &   FieldData::const_iterator::value() { return source->values[index]; }
+void FieldData::spill() {
+  values.reserve(ids.capacity());
+  for(Index i = 0; i < numbers.size(); i++) values.push(numbers[i]);
+  numbers = SharedVector<Number>();
+}
 
 // Two input pointwise:
-void FieldData::pointwise_instruction(Machine &machine,Instruction instruction,Data & a) {
-  FieldData::const_iterator ia = a.asField().begin();
-  FieldData result = FieldData(a.asField().size());
+void FieldData::pointwise_instruction(Machine &machine,Instruction instruction,Data & operand) {
+  // take the operand off the stack, as the elements are pushed into its slot
+  Data a;
+  a.take(operand);
+  FieldData const & field = a.asField();
+  UnaryKernel kernel;
+  if (field.isNumeric() && (kernel = unaryKernel(instruction))) {
+    SharedVector<Number> numbers(field.size());
+    for(Index i = 0; i < field.size(); i++) numbers.push(0);
+    kernel(field.numberValues(), numbers, field.size());
+    machine.stack.push(FieldData(field.ids, numbers));
+    return;
+  }
+  FieldData::const_iterator ia = field.begin();
+  FieldData result = FieldData(field.size());
   while(ia.hasNext()) {
     assert(ia.value().type() != Data::Type_field);
     machine.stack.push(ia.value());
@@ -239,11 +537,30 @@ void FieldData::pointwise_instruction(Machine &machine,Instruction instruction,D
 }
 
 // Three cases: a, b, or both are fields
-void FieldData::pointwise_instruction(Machine &machine,Instruction instruction,Data & a, Data & b) {
+void FieldData::pointwise_instruction(Machine &machine,Instruction instruction,Data & a_operand, Data & b_operand) {
+  // take the operands off the stack, as the elements are pushed into their slots
+  Data a, b;
+  a.take(a_operand);
+  b.take(b_operand);
   bool a_field = a.type() == Data::Type_field;
   bool b_field = b.type() == Data::Type_field;
   assert(a_field || b_field);
   
+  bool a_numbers = a_field ? a.asField().isNumeric() : a.type() == Data::Type_number;
+  bool b_numbers = b_field ? b.asField().isNumeric() : b.type() == Data::Type_number;
+  BinaryKernel kernel;
+  if (a_numbers && b_numbers && (kernel = binaryKernel(instruction))) {
+    FieldData const & field = a_field ? a.asField() : b.asField();
+    assert(!a_field || !b_field || a.asField().size() == b.asField().size());
+    SharedVector<Number> numbers(field.size());
+    for(Index i = 0; i < field.size(); i++) numbers.push(0);
+    kernel(a_field ? a.asField().numberValues() : &a.asNumber(), a_field,
+           b_field ? b.asField().numberValues() : &b.asNumber(), b_field,
+           numbers, field.size());
+    machine.stack.push(FieldData(field.ids, numbers));
+    return;
+  }
+  
   if(a_field && b_field) { // Both arguments are fields:
     FieldData::const_iterator ia = a.asField().begin();
     FieldData::const_iterator ib = b.asField().begin();
@@ -56,8 +56,8 @@ namespace {
 	}
 	
 	float compare(Machine & machine) {
-		Data b = machine.stack.pop();
-		Data a = machine.stack.pop();
+		Data const & b = machine.stack.pop();
+		Data const & a = machine.stack.pop();
 		return compare(a, b);
 	}
 
@@ -77,6 +77,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void EQ(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a == b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -96,6 +101,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void NEQ(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a != b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -115,6 +125,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void LT(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a < b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -137,6 +152,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void LTE(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a <= b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -159,6 +179,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void GT(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a > b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -181,6 +206,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void GTE(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a >= b ? 1 : 0);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -200,6 +230,11 @@ namespace Instructions {
 	 * \return \m{\left\lbrace\begin{array}{ll}1&a=0\\0&a\neq0\end{array}\right.}
 	 */
 	void NOT(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a ? 0 : 1);
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,NOT,rawa);
@@ -223,15 +258,14 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void ADD(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a + b);
+			return;
+		}
 		Data& b = machine.stack.pop();
 		Data& a = machine.stack.pop();
-		//Data& a = machine.stack.peek();
-                if (a.type() == Data::Type_number && b.type() == Data::Type_number) {
-			Number aa = a.asNumber();
-			Number bb = b.asNumber();
-			machine.stack.push(aa + bb);
-                        //machine.stack.replaceNumber(aa + bb);
-		} else if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
+		if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
                   FieldData::pointwise_instruction(machine,ADD,a,b);
                 } else { 
 			Tuple aa = ensureTuple(a);
@@ -256,15 +290,16 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void SUB(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a - b);
+			return;
+		}
 		Data& b = machine.stack.pop();
 		Data& a = machine.stack.pop();
                 if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
                   FieldData::pointwise_instruction(machine,SUB,a,b);
-                } else if (a.type() == Data::Type_number && b.type() == Data::Type_number) {
-			Number aa = a.asNumber();
-			Number bb = b.asNumber();
-			machine.stack.push(aa - bb);
-		} else {
+                } else {
 			Tuple aa = ensureTuple(a);
 			Tuple bb = ensureTuple(b);
 			Size size = aa.size() > bb.size() ? aa.size() : bb.size();
@@ -285,15 +320,16 @@ namespace Instructions {
 	 * \return \m{a \cdot b}
 	 */
 	void MUL(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a * b);
+			return;
+		}
 		Data& b = machine.stack.pop();
 		Data& a = machine.stack.pop();
 		if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
                   FieldData::pointwise_instruction(machine,MUL,a,b);
-                } else if (a.type() == Data::Type_number && b.type() == Data::Type_number) {
-			Number aa = a.asNumber();
-			Number bb = b.asNumber();
-			machine.stack.push(aa * bb);
-		} else {
+                } else {
 			Number        factor = a.type() == Data::Type_number ? a.asNumber() : b.asNumber();
 			Tuple const & vector = a.type() == Data::Type_number ? b.asTuple () : a.asTuple ();
 			Tuple result(vector.size());
@@ -309,6 +345,11 @@ namespace Instructions {
 	 * \return \m{\frac a b}
 	 */
 	void DIV(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a / b);
+			return;
+		}
 		Data& b = machine.stack.pop();
 		Data& a = machine.stack.pop();
 		if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -360,12 +401,14 @@ namespace Instructions {
 	 * \return \m{|a|}
 	 */
 	void ABS(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a < 0 ? -a : a);
+			return;
+		}
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,ABS,a);
-          } else if (a.type() == Data::Type_number) {
-            Number aa = a.asNumber();
-            machine.stack.push(aa < 0 ? -aa : aa);
           } else {
             Number s = 0;
             Tuple const & vector = a.asTuple();
@@ -386,6 +429,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void MAX(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a > b ? a : b);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -404,6 +452,11 @@ namespace Instructions {
 	 * \note If used on tuples, when one of the tuples is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void MIN(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(a < b ? a : b);
+			return;
+		}
           Data& b = machine.stack.pop();
           Data& a = machine.stack.pop();
           if (a.type() == Data::Type_field || b.type() == Data::Type_field) {
@@ -420,6 +473,11 @@ namespace Instructions {
 	 * \return \m{a^b}
 	 */
 	void POW(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(pow(a,b));
+			return;
+		}
           Data& rawb = machine.stack.pop();
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field || rawb.type() == Data::Type_field) {
@@ -437,6 +495,11 @@ namespace Instructions {
 	 * \return \m{x \equiv a \pmod{|b|}\,\quad \left\lbrace\begin{array}{ll} -|b| < x \leq 0 & a < 0 \\ 0 \leq x < |b| & a \geq 0 \end{array}\right.}
 	 */
 	void REM(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(fmod(a,b));
+			return;
+		}
           Data& rawb = machine.stack.pop();
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field || rawb.type() == Data::Type_field) {
@@ -454,6 +517,13 @@ namespace Instructions {
 	 * \return \m{x \equiv a \pmod{|b|}\,\quad 0 \leq x < |b|}
 	 */
 	void MOD(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			Number x = fmod(a,b);
+			if (x < 0) x += b; // fmod gives the remainder, not the modulus.
+			machine.stack.replaceNumber(x);
+			return;
+		}
           Data& rawb = machine.stack.pop();
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field || rawb.type() == Data::Type_field) {
@@ -472,6 +542,11 @@ namespace Instructions {
 	 * \return \m{\left\lfloor a \right\rfloor}
 	 */
 	void FLOOR(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(floor(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,FLOOR,rawa);
@@ -487,6 +562,11 @@ namespace Instructions {
 	 * \return \m{\left\lceil a \right\rceil}
 	 */
 	void CEIL(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(ceil(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,CEIL,rawa);
@@ -502,6 +582,11 @@ namespace Instructions {
 	 * \return \m{\left\lfloor a + \frac12 \right\rfloor}
 	 */
 	void ROUND(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(rint(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,ROUND,rawa);
@@ -517,6 +602,11 @@ namespace Instructions {
 	 * \return \m{\log_e a}
 	 */
 	void LOG(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(log(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,LOG,rawa);
@@ -532,6 +622,11 @@ namespace Instructions {
 	 * \return \m{\sqrt a}
 	 */
 	void SQRT(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(sqrt(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,SQRT,rawa);
@@ -547,6 +642,11 @@ namespace Instructions {
 	 * \return \m{\sin a}
 	 */
 	void SIN(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(sin(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,SIN,rawa);
@@ -562,6 +662,11 @@ namespace Instructions {
 	 * \return \m{\cos a}
 	 */
 	void COS(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(cos(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,COS,rawa);
@@ -577,6 +682,11 @@ namespace Instructions {
 	 * \return \m{\tan a}
 	 */
 	void TAN(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(tan(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,TAN,rawa);
@@ -592,6 +702,11 @@ namespace Instructions {
 	 * \return \m{\sinh a}
 	 */
 	void SINH(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(sinh(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,SINH,rawa);
@@ -607,6 +722,11 @@ namespace Instructions {
 	 * \return \m{\cosh a}
 	 */
 	void COSH(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(cosh(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,COSH,rawa);
@@ -622,6 +742,11 @@ namespace Instructions {
 	 * \return \m{\tanh a}
 	 */
 	void TANH(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(tanh(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,TANH,rawa);
@@ -637,6 +762,11 @@ namespace Instructions {
 	 * \return \m{\arcsin a}
 	 */
 	void ASIN(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(asin(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,ASIN,rawa);
@@ -652,6 +782,11 @@ namespace Instructions {
 	 * \return \m{\arccos a}
 	 */
 	void ACOS(Machine & machine){
+		if (machine.stack.topNumbers(1)) {
+			Number a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(acos(a));
+			return;
+		}
           Data& rawa = machine.stack.pop();
           if (rawa.type() == Data::Type_field) {
             FieldData::pointwise_instruction(machine,ACOS,rawa);
@@ -668,6 +803,11 @@ namespace Instructions {
 	 * \return \m{\arctan \frac y x}
 	 */
 	void ATAN2(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number x = machine.stack.popNumber(), y = machine.stack.peekNumber();
+			machine.stack.replaceNumber(atan2(y,x));
+			return;
+		}
           Data& rawx = machine.stack.pop();
           Data& rawy = machine.stack.pop();
           if (rawx.type() == Data::Type_field || rawy.type() == Data::Type_field) {
@@ -688,15 +828,16 @@ namespace Instructions {
 	 * \note If used on vectors, when one of the vectors is shorter, the remaining of the elements will be interpreted as 0.
 	 */
 	void RND(Machine & machine){
+		if (machine.stack.topNumbers(2)) {
+			Number b = machine.stack.popNumber(), a = machine.stack.peekNumber();
+			machine.stack.replaceNumber(machine.random.number(a,b));
+			return;
+		}
 		Data& max = machine.stack.pop();
 		Data& min = machine.stack.pop();
                 if (min.type() == Data::Type_field || max.type() == Data::Type_field) {
                   FieldData::pointwise_instruction(machine,RND,min,max);
-                } else if (min.type() == Data::Type_number && max.type() == Data::Type_number) {
-			Number a = min.asNumber();
-			Number b = max.asNumber();
-			machine.stack.push(Random::number(a,b));
-		} else {
+                } else {
 			Tuple a = ensureTuple(min);
 			Tuple b = ensureTuple(max);
 			Size size = a.size() > b.size() ? a.size() : b.size();
@@ -704,7 +845,7 @@ namespace Instructions {
 			for(Index i = 0; i < size; i++){
 				Number a_element = i < a.size() ? a[i].asNumber() : 0;
 				Number b_element = i < b.size() ? b[i].asNumber() : 0;
-				result.push(Random::number(a_element, b_element));
+				result.push(machine.random.number(a_element, b_element));
 			}
 			machine.stack.push(result);
 		}
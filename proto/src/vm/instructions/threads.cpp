@@ -42,9 +42,9 @@ namespace Instructions {
 	
 	/// Set the desired period of a thread.
 	/**
-	 * Set the minimum period for this thread.
+	 * Set the minimum period for this thread: it is not run again until this much time has passed since its last run.
 	 * 
-	 * \warning Currently, the scheduler ignores this setting.
+	 * \see Thread::desired_period
 	 */
 	void SET_DT(Machine & machine){
 		Number dt = machine.stack.peek().asNumber();
@@ -27,8 +27,9 @@ namespace Instructions {
 	 */
 	void ELT(Machine & machine){
 		Index element = machine.stack.popNumber();
-		Tuple  tuple  = machine.stack.popTuple ();
-		machine.stack.push(tuple[element]);
+		Data tuple; // taken off the stack, since the element is pushed into its slot
+		machine.stack.popInto(tuple);
+		machine.stack.push(tuple.asTuple()[element]);
 	}
 	
 	/// An empty tuple.
@@ -74,7 +75,8 @@ namespace Instructions {
 	void FAB_VEC(Machine & machine){
 		Size elements = machine.nextInt();
 		Tuple tuple(elements);
-		Data element = machine.stack.pop();
+		Data element;
+		machine.stack.popInto(element);
 		for(Index i = 0; i < elements; i++) tuple.push(element);
 		machine.stack.push(tuple);
 	}
@@ -99,7 +101,7 @@ namespace Instructions {
 	 * \note If a Number was given as parameter, 1 is returned.
 	 */
 	void LEN(Machine & machine){
-		Data a = machine.stack.pop();
+		Data const & a = machine.stack.pop();
 		machine.stack.push(a.type() == Data::Type_number ? 1 : a.asTuple().size());
 	}
 	
@@ -107,11 +109,11 @@ namespace Instructions {
 	/// \deprecated_mitproto{ADD}
 	void VADD(Machine & machine){
 		machine.nextInt8();
-		Tuple b = machine.stack.popTuple();
-		Tuple a = machine.stack.popTuple();
+		Tuple const & b = machine.stack.pop().asTuple();
+		Tuple const & a = machine.stack.pop().asTuple();
 		Size min_size = a.size() < b.size() ? a.size() : b.size();
 		Size max_size = a.size() < b.size() ? b.size() : a.size();
-		Tuple & largest = a.size() < b.size() ? b : a;
+		Tuple const & largest = a.size() < b.size() ? b : a;
 		Tuple result(max_size);
 		for(Index i = 0       ; i < min_size; i++) result.push(a[i].asNumber() + b[i].asNumber());
 		for(Index i = min_size; i < max_size; i++) result.push(largest[i].asNumber());
@@ -121,11 +123,11 @@ namespace Instructions {
 	/// \deprecated_mitproto{SUB}
 	void VSUB(Machine & machine){
 		machine.nextInt8();
-		Tuple b = machine.stack.popTuple();
-		Tuple a = machine.stack.popTuple();
+		Tuple const & b = machine.stack.pop().asTuple();
+		Tuple const & a = machine.stack.pop().asTuple();
 		Size min_size     = a.size() < b.size() ? a.size() : b.size();
 		Size max_size     = a.size() < b.size() ? b.size() : a.size();
-		Tuple & largest     = a.size() < b.size() ? b        : a       ;
+		Tuple const & largest     = a.size() < b.size() ? b        : a       ;
 		Number padding_sign = a.size() < b.size() ? -1       : 1       ;
 		Tuple result(max_size);
 		for(Index i = 0       ; i < min_size; i++) result.push(a[i].asNumber() - b[i].asNumber());
@@ -136,8 +138,8 @@ namespace Instructions {
 	/// \deprecated_mitproto{DOT}
 	void VDOT(Machine & machine){
 		Number result = 0;
-		Tuple b = machine.stack.popTuple();
-		Tuple a = machine.stack.popTuple();
+		Tuple const & b = machine.stack.pop().asTuple();
+		Tuple const & a = machine.stack.pop().asTuple();
 		Size min_size = a.size() < b.size() ? a.size() : b.size();
 		for(Index i = 0; i < min_size; i++) result += a[i].asNumber() * b[i].asNumber();
 		machine.stack.push(result);
@@ -146,7 +148,7 @@ namespace Instructions {
 	/// \deprecated_mitproto{MUL}
 	void VMUL(Machine & machine){
 		machine.nextInt8();
-		Tuple  b = machine.stack.popTuple ();
+		Tuple const & b = machine.stack.pop().asTuple();
 		Number a = machine.stack.popNumber();
 		Tuple result(b.size());
 		for(Index i = 0; i < b.size(); i++) result.push(a * b[i].asNumber());
@@ -156,7 +158,7 @@ namespace Instructions {
 	/// \deprecated_mitproto
 	void VSLICE(Machine & machine){
 		machine.nextInt8();
-		Tuple source = machine.stack.popTuple();
+		Tuple const & source = machine.stack.pop().asTuple();
 		Index start = machine.stack.popNumber();
 		Index stop  = machine.stack.popNumber();
 		start = start >= 0 ? start : source.size() + start;
@@ -24,6 +24,7 @@
 #include "neighbourhood.hpp"
 #include "instructions.hpp"
 #include "machineid.hpp"
+#include "random.hpp"
 #include <iostream>
 using namespace std;
 
@@ -67,6 +68,10 @@ class BasicMachine {
 		/** \memberof Machine */
 		NeighbourHood hood;
 		
+		/// The random number generator of this Machine.
+		/** \memberof Machine */
+		Random random;
+		
 		/// A pointer to the next instruction.
 		/** \memberof Machine */
 		Address instruction_pointer;
@@ -349,6 +354,31 @@ class Machine : public ExtendedMachine {
 				callbacks.push(0);
 			}
 			
+			/// Start as a copy of a Machine whose installation script has finished.
+			/**
+			 * This has the same result as installing and executing the script of \p image,
+			 * without executing anything: the globals, threads and the sizes of all stacks are copied from \p image.
+			 * The script itself and the tuples in the globals are shared with \p image, not copied.
+			 * 
+			 * This Machine keeps its own id and random number generator,
+			 * so the installation script must not depend on them (e.g. through Instructions::MID or Instructions::RND).
+			 * 
+			 * \param image A Machine that has finished() its installation script, and has not been run.
+			 */
+			inline void install(Machine const & image) {
+				script = image.script;
+				copy_stack(stack, image.stack);
+				copy_stack(environment, image.environment);
+				copy_stack(globals, image.globals);
+				threads = image.threads;
+				state = image.state;
+				copy_stack(firstFeedbackUpdate, image.firstFeedbackUpdate);
+				hood.reset(image.hood.importCount());
+				hood.add(id);
+				callbacks.reset(image.callbacks.size() + image.callbacks.free());
+				current_thread = image.current_thread;
+			}
+			
 			/// Start the next scheduled task.
 			/**
 			 * \note This does not execute Proto code, it only prepares the next run. Call step() while not finished() to execute it.
@@ -358,7 +388,7 @@ class Machine : public ExtendedMachine {
 			inline void run(Time start) {
 				start_time = start;
 				for(Size i = 0; i < threads.size(); i++){
-					if (threads[current_thread].pending()){
+					if (threads[current_thread].pending() && threads[current_thread].due(start)){
 						threads[current_thread].untrigger();
 						jump(globals.peek(current_thread).asAddress());
 						callbacks.push(run_callback);
@@ -369,6 +399,48 @@ class Machine : public ExtendedMachine {
 				}
 			}
 			
+			/// Pass over the next scheduled task, as if it ran and gave the same results as its previous run.
+			/**
+			 * Only the time of the run and the thread bookkeeping are updated: results, state and exports are left as they are.
+			 * It is up to the caller to know that running the task would not have changed them.
+			 * 
+			 * \param start The time at the start of this run.
+			 */
+			inline void skip_run(Time start) {
+				start_time = start;
+				for(Size i = 0; i < threads.size(); i++){
+					Thread & thread = threads[current_thread];
+					current_thread++;
+					if (current_thread >= threads.size()) current_thread = 0;
+					if (thread.pending() && thread.due(start)){
+						thread.untrigger();
+						thread.last_time = start;
+						return;
+					}
+				}
+			}
+			
+			/// The time from \p now until the next scheduled task is due.
+			/**
+			 * This is when the machine next needs to run: the earliest Thread::wait() of the pending threads.
+			 * A machine with threads that have a Thread::desired_period longer than the rate of the device
+			 * can sleep through the rounds in which none of them is due.
+			 * 
+			 * \param now The time of the current run.
+			 * \param period The rate of the device.
+			 */
+			inline Time next_run(Time now, Time period) const {
+				Time wait = period;
+				bool pending = false;
+				for(Index i = 0; i < threads.size(); i++){
+					if (!threads[i].pending()) continue;
+					Time w = threads[i].wait(now, period);
+					if (!pending || w < wait) wait = w;
+					pending = true;
+				}
+				return wait;
+			}
+			
 			/** \cond */
 		protected:
 			static void run_callback(Machine & machine){
@@ -382,11 +454,27 @@ class Machine : public ExtendedMachine {
 				}
 				machine.current_thread++;
 				if (machine.current_thread >= machine.threads.size()) machine.current_thread = 0;
+				MemoryStatistics::count(&MemoryStatistics::rounds);
+			}
+			
+			template<typename S>
+			static void copy_stack(S & to, S const & from){
+				to.reset(from.size() + from.free());
+				for(Index i = 0; i < from.size(); i++) to.push(from[i]);
 			}
 			
 			/** \endcond */
 			
 		public:
+			/** \cond */
+			/// The \ref instructions table, with execute_unknown() in its empty slots.
+			static Instruction dispatch[256];
+			
+			static void dispatch_unknown(Machine & machine){
+				machine.execute_unknown(static_cast<Int8 const *>(machine.instruction_pointer)[-1]);
+			}
+			/** \endcond */
+			
 			/// Execute the next instruction.
 			/**
 			 * \note Do not use this function when already finished().
@@ -398,6 +486,37 @@ class Machine : public ExtendedMachine {
 				else execute_unknown(opcode);
 			}
 			
+			/// Execute instructions until the running script has finished().
+			/**
+			 * This does the same as calling step() while not finished(),
+			 * but opcodes are looked up in a table without empty slots,
+			 * so each instruction costs a single indirect call.
+			 */
+			inline void run_to_completion() {
+				Untraced untraced;
+				run_to_completion(untraced);
+			}
+			
+			/// Execute instructions until the running script has finished(), reporting each one to a tracer.
+			/**
+			 * Before each instruction, <tt>tracer(*this)</tt> is called, with the instruction_pointer still at its opcode.
+			 * 
+			 * The tracer is a compile time policy: run_to_completion() without one uses Untraced,
+			 * whose calls compile to nothing, so only the loops of traced machines pay for tracing.
+			 */
+			template<class Tracer>
+			inline void run_to_completion(Tracer & tracer) {
+				while (!callbacks.empty()) {
+					tracer(*this);
+					dispatch[nextInt8()](*this);
+				}
+			}
+			
+			/// The tracer of untraced runs, which does nothing.
+			struct Untraced {
+				inline void operator()(Machine &) {}
+			};
+			
 			/// Check whether the running script (installation or a single run) has finished (true) or not (false).
 			inline bool finished() {
 				return callbacks.empty();
@@ -17,9 +17,156 @@
 #define __MEMORY_HPP
 
 #include "types.hpp"
+#ifdef HAVE_CONFIG_H
+// MEMORY_POOL, MEMORY_STATISTICS and THREAD_LOCAL may also be given as compiler defines
+#include "config.h"
+#endif
+
+/** \cond */
+#ifndef THREAD_LOCAL
+#define THREAD_LOCAL
+#endif
+/** \endcond */
+
+/// Counters for the memory (de)allocations done through Memory.
+/**
+ * These are only kept when \c MEMORY_STATISTICS is defined (see \c --enable-memory-stats),
+ * so the effect of the MemoryPool (enabled with \c MEMORY_POOL) can be measured:
+ * without the pool, every allocation is a heap allocation.
+ * Otherwise count() does nothing, and all counters stay zero.
+ *
+ * \note When \c THREAD_SAFE_VM is defined, every thread has its own counters.
+ */
+class MemoryStatistics {
+
+	public:
+		/// The number of calls to Memory::allocate.
+		Size allocations;
+
+		/// The number of those that needed memory from the system heap.
+		Size heap_allocations;
+
+		/// The number of calls to Memory::deallocate.
+		Size deallocations;
+
+		/// The number of completed runs of all Machines.
+		/** \see Machine::run */
+		Size rounds;
+
+		/// The statistics of this thread.
+		static inline MemoryStatistics & get() {
+			static THREAD_LOCAL MemoryStatistics statistics;
+			return statistics;
+		}
+
+		/// Increment one of the counters of this thread, e.g. \c count(&MemoryStatistics::rounds).
+		static inline void count(Size MemoryStatistics::* counter) {
+#ifdef MEMORY_STATISTICS
+			get().*counter += 1;
+#endif
+		}
+
+		/// Move the counts of another thread into these.
+		inline void take(MemoryStatistics & other) {
+			allocations      += other.allocations     ; other.allocations      = 0;
+			heap_allocations += other.heap_allocations; other.heap_allocations = 0;
+			deallocations    += other.deallocations   ; other.deallocations    = 0;
+			rounds           += other.rounds          ; other.rounds           = 0;
+		}
+
+};
+
+#ifdef MEMORY_POOL
+
+/// A slab allocator for small blocks of memory.
+/**
+ * Requests up to \c max_block_size bytes are rounded up to a multiple of \c granularity, and served from a free list per size class.
+ * When a free list is empty, a slab of \c blocks_per_slab blocks is allocated from the heap at once and cut up.
+ * Deallocated blocks go back on their free list, and are never returned to the heap.
+ *
+ * Most Tuples, Fields and their contents are short lived (created and destroyed within a single run), and are all of a few different sizes.
+ * With the pool, a Machine reaches a steady state after a few runs in which it does not touch the heap at all.
+ *
+ * \note The pool is shared by all Machines in a thread.
+ * When \c THREAD_SAFE_VM is defined, every thread has its own free lists.
+ * A block freed by another thread than the one that allocated it simply moves to the free list of the former.
+ */
+class MemoryPool {
+
+	public:
+		/// The size classes are multiples of this number of bytes.
+		static Size const granularity = 2 * sizeof(void *);
+
+		/// The number of size classes.
+		static Size const classes = 16;
+
+		/// Bigger requests are passed on to the heap directly.
+		static Size const max_block_size = granularity * classes;
+
+		/// The number of blocks allocated at once for an empty size class.
+		static Size const blocks_per_slab = 64;
+
+	protected:
+		struct Block {
+			Block * next;
+		};
+
+		static inline Index size_class(Size bytes) {
+			return bytes ? (bytes - 1) / granularity : 0;
+		}
+
+		static inline Block * & free_list(Index size_class) {
+			static THREAD_LOCAL Block * free_lists[classes];
+			return free_lists[size_class];
+		}
+
+		static void refill(Index size_class) {
+			Size block_size = (size_class + 1) * granularity;
+			char * slab = static_cast<char *>(operator new (block_size * blocks_per_slab));
+			MemoryStatistics::count(&MemoryStatistics::heap_allocations);
+			Block * & list = free_list(size_class);
+			for(Index i = blocks_per_slab; i > 0; i--){
+				Block * block = reinterpret_cast<Block *>(slab + (i - 1) * block_size);
+				block->next = list;
+				list = block;
+			}
+		}
+
+	public:
+		/// Allocate a number of bytes.
+		static inline void * allocate(Size bytes) {
+			if (bytes > max_block_size){
+				MemoryStatistics::count(&MemoryStatistics::heap_allocations);
+				return operator new (bytes);
+			}
+			Index c = size_class(bytes);
+			Block * & list = free_list(c);
+			if (!list) refill(c);
+			Block * block = list;
+			list = block->next;
+			return block;
+		}
+
+		/// Deallocate memory allocated by allocate(), with the same number of bytes.
+		static inline void deallocate(void * memory, Size bytes) {
+			if (bytes > max_block_size){
+				operator delete (memory);
+				return;
+			}
+			Block * & list = free_list(size_class(bytes));
+			Block * block = static_cast<Block *>(memory);
+			block->next = list;
+			list = block;
+		}
+
+};
+
+#endif
 
 /// An interface to the memory (de)allocation functions.
 /**
+ * When \c MEMORY_POOL is defined (see \c --enable-memory-pool), small allocations are served by the MemoryPool.
+ * 
  * \tparam Element The type of the element(s) to (de)allocate.
  */
 template<typename Element>
@@ -42,7 +189,13 @@ class Memory {
 		 * \endcode
 		 */
 		static inline Element * allocate(Size capacity = 1) {
+			MemoryStatistics::count(&MemoryStatistics::allocations);
+#ifdef MEMORY_POOL
+			return static_cast<Element *>(MemoryPool::allocate(capacity * sizeof(Element)));
+#else
+			MemoryStatistics::count(&MemoryStatistics::heap_allocations);
 			return static_cast<Element *>(operator new [] (capacity * sizeof(Element)));
+#endif
 		}
 		
 		/// Deallocate memory.
@@ -58,9 +211,16 @@ class Memory {
 		 * t->~Thing();
 		 * Memory<Thing>::deallocate(t);
 		 * \endcode
+		 * 
+		 * \warning The capacity must be the same as the one given to Memory::allocate, as it determines where the memory goes back to.
 		 */
 		static inline void deallocate(Element * memory, Size capacity = 1) {
+			MemoryStatistics::count(&MemoryStatistics::deallocations);
+#ifdef MEMORY_POOL
+			MemoryPool::deallocate(memory, capacity * sizeof(Element));
+#else
 			operator delete [] (memory);
+#endif
 		}
 		
 };
@@ -14,8 +14,8 @@
 #ifndef __NEIGHBOUR_HPP
 #define __NEIGHBOUR_HPP
 
-#include "array.hpp"
 #include "data.hpp"
+#include "imports.hpp"
 #include "machineid.hpp"
 
 class BasicNeighbour {
@@ -27,7 +27,7 @@ class BasicNeighbour {
 		
 		/// The imports from this machine.
 		/** \memberof Neighbour */
-		Array<Data> imports;
+		Imports imports;
 		
 		BasicNeighbour(MachineId const & id, Size imports) : id(id), imports(imports) {}
 		
@@ -20,128 +20,238 @@
 
 /// A list of Neighbours.
 /**
- * This implements a doubly linked list.
- * Though, it could be replaced by any other implementation (raw array, tree set, etc.), as long as it has the same public interface.
- * 
- * \todo Add documentation and some examples.
+ * The Neighbours are stored in a contiguous array of slots, in the order in which they were added.
+ * A removed Neighbour leaves an empty slot behind, which is skipped when iterating.
+ * Empty slots are only reclaimed when a new Neighbour is added to a full array,
+ * so removing while iterating (see remove()) keeps the iteration order intact.
+ *
+ * Lookups by MachineId go through an open-addressed hash table (linear probing) that maps IDs to slots,
+ * which makes find() and operator[] O(1) instead of a walk over the whole neighbourhood.
+ *
+ * \note Adding a Neighbour may move all Neighbours to a new array.
+ *       Iterators, references and pointers to Neighbours are only guaranteed to stay valid until the next add().
+ *       (They do stay valid when other Neighbours are removed.)
+ *
+ * \note The first Neighbour added (by the \ref Instructions::DEF_VM "DEF_VM" instruction) is the Machine itself.
+ * \see Machine::thisMachine()
  */
 class NeighbourHood {
-	
+
 	protected:
-		
-		struct NeighbourHoodElement {
-			Neighbour neighbour;
-			NeighbourHoodElement * next;
-			NeighbourHoodElement * previous;
-			inline NeighbourHoodElement(MachineId const & id, Size imports) : neighbour(id,imports), next(0), previous(0) {}
-		};
-		
-		NeighbourHoodElement * first;
-		NeighbourHoodElement * last;
-		
+
+		/// The slots, only those marked in \c occupied contain a constructed Neighbour.
+		Neighbour * slots;
+
+		/// For every slot, whether it contains a Neighbour (true) or is empty (false).
+		bool * occupied;
+
+		/// The number of allocated slots.
+		Size slots_capacity;
+
+		/// The number of slots that have been used since the last compaction (including empty ones).
+		Size slots_used;
+
+		/// The hash table mapping ids to slots. Entries contain the slot index plus one, 0 means empty.
+		Index * table;
+
+		/// The size of the hash table (always a power of two, or 0).
+		Size table_capacity;
+
+		/// The number of Neighbours.
 		Size list_size;
-		
+
+		/// The number of imports of every Neighbour.
 		Size imports;
-		
+
+		static inline Index hash(MachineId const & id) {
+			Int key = static_cast<Int>(id);
+			key ^= key >> 16;
+			key *= 0x45d9f3b;
+			key ^= key >> 16;
+			return key;
+		}
+
+		/// Find the hash table entry for an id: either the entry containing it, or the empty entry where it belongs.
+		inline Index table_position(MachineId const & id) const {
+			Index mask = table_capacity - 1;
+			Index position = hash(id) & mask;
+			while(table[position] && slots[table[position]-1].id != id) position = (position + 1) & mask;
+			return position;
+		}
+
+		/// Remove an entry from the hash table, shifting back any entries that were displaced by it.
+		inline void table_erase(Index position) {
+			Index mask = table_capacity - 1;
+			Index empty = position;
+			table[empty] = 0;
+			for(Index next = (empty + 1) & mask; table[next]; next = (next + 1) & mask){
+				Index home = hash(slots[table[next]-1].id) & mask;
+				// Move the entry back when its home position is not cyclically within (empty, next].
+				if (empty <= next ? (home <= empty || home > next) : (home <= empty && home > next)){
+					table[empty] = table[next];
+					table[next] = 0;
+					empty = next;
+				}
+			}
+		}
+
+		/// Move all Neighbours (in order, without empty slots) to a new array with the given capacity and rebuild the hash table.
+		inline void relocate(Size new_capacity) {
+			Neighbour * new_slots = Memory<Neighbour>::allocate(new_capacity);
+			bool * new_occupied = Memory<bool>::allocate(new_capacity);
+			Size new_used = 0;
+			for(Index i = 0; i < slots_used; i++){
+				if (!occupied[i]) continue;
+				new (&new_slots[new_used]) Neighbour(slots[i]);
+				new_occupied[new_used++] = true;
+				slots[i].~Neighbour();
+			}
+			if (slots){
+				Memory<Neighbour>::deallocate(slots, slots_capacity);
+				Memory<bool>::deallocate(occupied, slots_capacity);
+			}
+			slots = new_slots;
+			occupied = new_occupied;
+			slots_capacity = new_capacity;
+			slots_used = new_used;
+
+			if (table) Memory<Index>::deallocate(table, table_capacity);
+			for(table_capacity = 8; table_capacity < 2 * slots_capacity; table_capacity *= 2);
+			table = Memory<Index>::allocate(table_capacity);
+			for(Index i = 0; i < table_capacity; i++) table[i] = 0;
+			for(Index i = 0; i < slots_used; i++) table[table_position(slots[i].id)] = i + 1;
+		}
+
+		/// The first occupied slot at or after the given one, or slots_used if there is none.
+		inline Index next_occupied(Index slot) const {
+			while(slot < slots_used && !occupied[slot]) slot++;
+			return slot;
+		}
+
+		/// The last occupied slot before the given one.
+		inline Index previous_occupied(Index slot) const {
+			do slot--; while(!occupied[slot]);
+			return slot;
+		}
+
 	public:
-		
+
 		class iterator {
 			protected:
-				NeighbourHoodElement * element;
-				inline iterator(NeighbourHoodElement * element) : element(element) {}
+				NeighbourHood * hood;
+				Index slot;
+				inline iterator(NeighbourHood * hood, Index slot) : hood(hood), slot(slot) {}
 				friend class const_iterator;
 				friend class NeighbourHood;
 			public:
 				inline iterator() {}
-				inline iterator & operator ++ (     ) {                     element = element->next    ; return *this; }
-				inline iterator   operator ++ (int x) { iterator i = *this; element = element->next    ; return  i   ; }
-				inline iterator & operator -- (     ) {                     element = element->previous; return *this; }
-				inline iterator   operator -- (int x) { iterator i = *this; element = element->previous; return  i   ; }
-				inline Neighbour & operator *  () const { return   element->neighbour ; }
-				inline Neighbour * operator -> () const { return &(element->neighbour); }
-				inline bool operator == (iterator const & i) const { return element == i.element; }
-				inline bool operator != (iterator const & i) const { return element != i.element; }
-				inline operator Neighbour * () const { return &(element->neighbour); }
+				inline iterator & operator ++ (     ) {                     slot = hood->next_occupied(slot+1); return *this; }
+				inline iterator   operator ++ (int x) { iterator i = *this; slot = hood->next_occupied(slot+1); return  i   ; }
+				inline iterator & operator -- (     ) {                     slot = hood->previous_occupied(slot); return *this; }
+				inline iterator   operator -- (int x) { iterator i = *this; slot = hood->previous_occupied(slot); return  i   ; }
+				inline Neighbour & operator *  () const { return   hood->slots[slot] ; }
+				inline Neighbour * operator -> () const { return &(hood->slots[slot]); }
+				inline bool operator == (iterator const & i) const { return slot == i.slot; }
+				inline bool operator != (iterator const & i) const { return slot != i.slot; }
+				inline operator Neighbour * () const { return &(hood->slots[slot]); }
 		};
-		
+
 		class const_iterator {
 			protected:
-				NeighbourHoodElement const * element;
-				inline const_iterator(NeighbourHoodElement const * element) : element(element) {}
-				inline const_iterator(iterator const & i) : element(i.element) {}
+				NeighbourHood const * hood;
+				Index slot;
+				inline const_iterator(NeighbourHood const * hood, Index slot) : hood(hood), slot(slot) {}
+				inline const_iterator(iterator const & i) : hood(i.hood), slot(i.slot) {}
 				friend class NeighbourHood;
 			public:
 				inline const_iterator() {}
-				inline const_iterator & operator ++ (     ) {                           element = element->next    ; return *this; }
-				inline const_iterator   operator ++ (int x) { const_iterator i = *this; element = element->next    ; return  i   ; }
-				inline const_iterator & operator -- (     ) {                           element = element->previous; return *this; }
-				inline const_iterator   operator -- (int x) { const_iterator i = *this; element = element->previous; return  i   ; }
-				inline Neighbour const & operator *  () const { return   element->neighbour ; }
-				inline Neighbour const * operator -> () const { return &(element->neighbour); }
-				inline bool operator == (const_iterator const & i) const { return element == i.element; }
-				inline bool operator != (const_iterator const & i) const { return element != i.element; }
-				inline operator Neighbour const * () const { return &(element->neighbour); }
+				inline const_iterator & operator ++ (     ) {                           slot = hood->next_occupied(slot+1); return *this; }
+				inline const_iterator   operator ++ (int x) { const_iterator i = *this; slot = hood->next_occupied(slot+1); return  i   ; }
+				inline const_iterator & operator -- (     ) {                           slot = hood->previous_occupied(slot); return *this; }
+				inline const_iterator   operator -- (int x) { const_iterator i = *this; slot = hood->previous_occupied(slot); return  i   ; }
+				inline Neighbour const & operator *  () const { return   hood->slots[slot] ; }
+				inline Neighbour const * operator -> () const { return &(hood->slots[slot]); }
+				inline bool operator == (const_iterator const & i) const { return slot == i.slot; }
+				inline bool operator != (const_iterator const & i) const { return slot != i.slot; }
+				inline operator Neighbour const * () const { return &(hood->slots[slot]); }
 		};
-		
-		explicit inline NeighbourHood(Size imports = 0) : first(0), last(0), list_size(0), imports(imports) {}
-		
+
+		explicit inline NeighbourHood(Size imports = 0) : slots(0), occupied(0), slots_capacity(0), slots_used(0), table(0), table_capacity(0), list_size(0), imports(imports) {}
+
 		inline void reset(Size imports){
-			iterator i = first;
+			iterator i = begin();
 			while(i != end()) i = remove(i);
+			slots_used = 0;
 			this->imports = imports;
 		}
-		
-		inline       iterator begin()       { return first; }
-		inline const_iterator begin() const { return first; }
-		inline       iterator end  ()       { return 0    ; }
-		inline const_iterator end  () const { return 0    ; }
-		
+
+		inline       iterator begin()       { return       iterator(this, next_occupied(0)); }
+		inline const_iterator begin() const { return const_iterator(this, next_occupied(0)); }
+		inline       iterator end  ()       { return       iterator(this, slots_used); }
+		inline const_iterator end  () const { return const_iterator(this, slots_used); }
+
 		inline Neighbour const & operator [] (MachineId const & id) const {
 			return *find(id);
 		}
-		
+
 		inline Neighbour & operator [] (MachineId const & id) {
 			iterator i = find(id);
 			return *(i == end() ? add(id) : i);
 		}
-		
+
 		inline iterator find(MachineId const & id) {
-			for(iterator i = begin(); i != end(); i++) if (i->id == id) return i;
-			return end();
+			if (!list_size) return end();
+			Index entry = table[table_position(id)];
+			return entry ? iterator(this, entry-1) : end();
 		}
-		
+
 		inline const_iterator find(MachineId const & id) const {
-			for(const_iterator i = begin(); i != end(); i++) if (i->id == id) return i;
-			return end();
+			if (!list_size) return end();
+			Index entry = table[table_position(id)];
+			return entry ? const_iterator(this, entry-1) : end();
 		}
-		
+
 		inline iterator add(MachineId const & id) {
-			NeighbourHoodElement * n = Memory<NeighbourHoodElement>::allocate();
-			new (n) NeighbourHoodElement(id,imports);
-			if (last) last->next = n;
-			n->previous = last;
-			last = n;
-			if (!first) first = n;
+			if (slots_used == slots_capacity){
+				// Reclaim the empty slots if that frees enough space, grow otherwise.
+				relocate(list_size < slots_capacity / 2 ? slots_capacity : slots_capacity ? 2 * slots_capacity : 4);
+			}
+			Index slot = slots_used++;
+			new (&slots[slot]) Neighbour(id,imports);
+			occupied[slot] = true;
+			table[table_position(id)] = slot + 1;
 			list_size++;
-			return n;
+			return iterator(this, slot);
 		}
-		
+
 		inline iterator remove(iterator neighbour) {
-			NeighbourHoodElement * n = neighbour.element;
-			if (n->previous) n->previous->next = n->next;
-			if (n->next    ) n->next->previous = n->previous;
-			if (n == first) first = n->next;
-			if (n == last ) last  = n->previous;
-			iterator next = n->next;
-			n->~NeighbourHoodElement();
-			Memory<NeighbourHoodElement>::deallocate(n);
+			Index slot = neighbour.slot;
+			table_erase(table_position(slots[slot].id));
+			slots[slot].~Neighbour();
+			occupied[slot] = false;
 			list_size--;
-			return next;
+			return iterator(this, next_occupied(slot+1));
 		}
-		
+
 		inline Size size () const { return  list_size; }
 		inline bool empty() const { return !list_size; }
-		
+
+		/// The number of imports of every Neighbour.
+		inline Size importCount() const { return imports; }
+
+		inline ~NeighbourHood() {
+			for(Index i = 0; i < slots_used; i++) if (occupied[i]) slots[i].~Neighbour();
+			if (slots){
+				Memory<Neighbour>::deallocate(slots, slots_capacity);
+				Memory<bool>::deallocate(occupied, slots_capacity);
+			}
+			if (table) Memory<Index>::deallocate(table, table_capacity);
+		}
+
+	private:
+		inline NeighbourHood(NeighbourHood const &);
+		inline NeighbourHood & operator = (NeighbourHood const &);
+
 };
 
 #endif
@@ -19,10 +19,46 @@
 #include "types.hpp"
 
 /// Pseudo random Number generator.
+/**
+ * Every Machine has its own generator, so the sequence a Machine sees
+ * does not depend on what other Machines do, or in which order (or thread) they run.
+ * It is counter-based: the n-th Number is a hash of the seed and n, which needs only 32 bit arithmetic.
+ */
 class Random {
 	
+	protected:
+		
+		/// The key of the sequence, derived from the seed.
+		Int key;
+		
+		/// The number of Numbers drawn so far.
+		Int counter;
+		
+		/// Hash an Int (the MurmurHash3 finalizer).
+		static inline Int mix(Int h) {
+			h ^= h >> 16; h *= 0x85ebca6bu;
+			h ^= h >> 13; h *= 0xc2b2ae35u;
+			return h ^ (h >> 16);
+		}
+		
 	public:
 		
+		/// Construct a generator with seed zero.
+		/**
+		 * This does not touch std::rand(), which is not safe to call from several threads.
+		 * Every Machine starts with the same sequence, until it is given its own seed().
+		 */
+		Random() { seed(0); }
+		
+		/// Construct a generator with the given seed.
+		explicit Random(Int seed) { this->seed(seed); }
+		
+		/// Restart the sequence from a seed.
+		inline void seed(Int seed) {
+			key = mix(seed);
+			counter = 0;
+		}
+		
 		/// Get a random Number.
 		/**
 		 * The random Number is picked from an uniform distribution.
@@ -32,8 +68,9 @@ class Random {
 		 *
 		 * \return A random Number between min and max.
 		 */
-		static Number number(Number min, Number max) {
-			return Number(std::rand()) / Number(RAND_MAX) * (max - min) + min;
+		inline Number number(Number min, Number max) {
+			Int value = mix(key + ++counter * 0x9e3779b9u);
+			return Number(value >> 8) / Number(1 << 24) * (max - min) + min;
 		}
 		
 };
@@ -14,18 +14,52 @@
 #ifndef __SHAREDVECTOR_HPP
 #define __SHAREDVECTOR_HPP
 
+#include <cstring>
 #include "types.hpp"
 #include "memory.hpp"
 
+/// Storage for the first elements of a SharedVector, kept in the same allocation as its header.
+/**
+ * \tparam Element The type of elements in the vector.
+ * \tparam capacity The number of elements there is room for.
+ */
+template<typename Element, Size capacity>
+struct InlineElements {
+	union {
+		char bytes[capacity * sizeof(Element)];
+		void * pointer_alignment;
+		double number_alignment;
+	};
+	inline Element * get() { return reinterpret_cast<Element *>(bytes); }
+};
+
+/// No inline storage at all.
+template<typename Element>
+struct InlineElements<Element, 0> {
+	inline Element * get() { return 0; }
+};
+
 /// A vector with shared contents.
 /**
- * A SharedVector can only grow, not shrink. New space is automatically allocated when needed.
+ * A SharedVector can only grow, not shrink. New space is automatically allocated when needed,
+ * at least doubling the capacity each time, so a series of push()es takes amortised constant time.
+ * If the final size is known in advance, reserve() it to avoid the reallocations altogether.
+ * 
+ * When the space is reallocated, the elements are relocated by copying their bytes, without calling their copy constructors and destructors.
+ * Elements therefore must not point into themselves. (Numbers, Data and the shared containers meet this requirement.)
+ * 
+ * When \c THREAD_SAFE_VM is defined, the reference count is updated atomically,
+ * since contents exported by one Machine may be shared with Machines running in other threads.
  * 
  * The contents will be shared across copies of an instance, unless created by copy().
  * 
+ * The first \p inline_capacity elements are stored in the same allocation as the shared header,
+ * so a small vector costs a single allocation. Only a vector that grows beyond them allocates a separate element array.
+ * 
  * \tparam Element The type of elements in the vector.
+ * \tparam inline_capacity The number of elements stored inline.
  */
-template<typename Element>
+template<typename Element, Size inline_capacity = 0>
 class SharedVector {
 	
 	protected:
@@ -37,24 +71,41 @@ class SharedVector {
 				Size vectorsize;
 				Size vectorcapacity;
 				Element * elements;
+				InlineElements<Element, inline_capacity> inline_elements;
+				
+				inline bool isInline() const {
+					return elements == const_cast<VectorData *>(this)->inline_elements.get();
+				}
+				
+				// Point elements at room for at least the given number of them.
+				inline void allocate(Size capacity) {
+					if (capacity <= inline_capacity){
+						vectorcapacity = inline_capacity;
+						elements = inline_elements.get();
+					} else {
+						vectorcapacity = capacity;
+						elements = Memory<Element>::allocate(capacity);
+					}
+				}
+				
+				inline void deallocate() {
+					if (elements && !isInline()) Memory<Element>::deallocate(elements, vectorcapacity);
+				}
 				
 				inline void reset(Size size = 0) {
 					if (elements){
 						for(Index i = 0; i < vectorsize; i++) elements[i].~Element();
-						Memory<Element>::deallocate(elements, vectorcapacity);
+						deallocate();
 					}
 					vectorsize = size;
-					elements = vectorsize ? Memory<Element>::allocate(size) : 0;
+					allocate(size);
 				}
 				
-				inline void grow(Size extra_capacity = 1) {
-					Element * new_elements = Memory<Element>::allocate(vectorcapacity + extra_capacity);
-					for(Index i = 0; i < vectorsize; i++){
-						new (&new_elements[i]) Element(elements[i]);
-						elements[i].~Element();
-					}
-					if (elements) Memory<Element>::deallocate(elements,vectorcapacity);
-					vectorcapacity += extra_capacity;
+				inline void grow(Size new_capacity) {
+					Element * new_elements = Memory<Element>::allocate(new_capacity);
+					if (vectorsize) std::memcpy(static_cast<void *>(new_elements), static_cast<void const *>(elements), vectorsize * sizeof(Element));
+					deallocate();
+					vectorcapacity = new_capacity;
 					elements = new_elements;
 				}
 				
@@ -63,18 +114,23 @@ class SharedVector {
 				}
 				
 			public:
-				inline VectorData() : reference_count(1), vectorsize(0), vectorcapacity(0), elements(0) {}
-				inline explicit VectorData(Size capacity) : reference_count(1), vectorsize(0), vectorcapacity(capacity), elements(Memory<Element>::allocate(vectorcapacity)) {}
+				inline VectorData() : reference_count(1), vectorsize(0) { allocate(0); }
+				inline explicit VectorData(Size capacity) : reference_count(1), vectorsize(0) { allocate(capacity); }
 				
-				inline VectorData(VectorData const & vector, Size free_space = 0) : reference_count(1), vectorsize(0), vectorcapacity(vector.size() + free_space), elements(Memory<Element>::allocate(vectorcapacity)) {
+				inline VectorData(VectorData const & vector, Size free_space = 0) : reference_count(1), vectorsize(0) {
+					allocate(vector.size() + free_space);
 					for(;vectorsize < vector.size(); vectorsize++) new (&elements[vectorsize]) Element(vector.elements[vectorsize]);
 				}
 				
 				inline void push(Element const & element) {
-					if (vectorsize == vectorcapacity) grow();
+					if (vectorsize == vectorcapacity) grow(vectorcapacity ? 2 * vectorcapacity : 4);
 					new (&elements[vectorsize++]) Element(element);
 				}
 				
+				inline void reserve(Size capacity) {
+					if (capacity > vectorcapacity) grow(capacity);
+				}
+				
 				inline Size    size      () const { return vectorsize     ; }
 				inline Size    capacity  () const { return vectorcapacity ; }
 				inline Counter references() const { return reference_count; }
@@ -82,11 +138,19 @@ class SharedVector {
 				inline operator Element       * ()       { return elements; }
 				inline operator Element const * () const { return elements; }
 				
-				inline VectorData       * grab()       { reference_count++; return this; }
-				inline VectorData const * grab() const { reference_count++; return this; }
+#ifdef THREAD_SAFE_VM
+				inline void    reference  () const { __sync_add_and_fetch(&reference_count, 1); }
+				inline Counter unreference() const { return __sync_sub_and_fetch(&reference_count, 1); }
+#else
+				inline void    reference  () const { ++reference_count; }
+				inline Counter unreference() const { return --reference_count; }
+#endif
+				
+				inline VectorData       * grab()       { reference(); return this; }
+				inline VectorData const * grab() const { reference(); return this; }
 				
 				inline void release() const {
-					if (!--reference_count){
+					if (!unreference()){
 						this->~VectorData();
 						Memory<VectorData>::deallocate(const_cast<VectorData *>(this));
 					}
@@ -95,6 +159,7 @@ class SharedVector {
 				inline VectorData & operator = (VectorData const & vector){
 					reset(vector.size());
 					for(;vectorsize < vector.size(); vectorsize++) new (&elements[vectorsize]) Element(vector.elements[vectorsize]);
+					return *this;
 				}
 				
 		} * data;
@@ -125,6 +190,14 @@ class SharedVector {
 			data->push(element);
 		}
 		
+		/// Make sure the vector can hold at least the given number of elements without reallocating.
+		/**
+		 * \note The space is reserved for all instances sharing the contents.
+		 */
+		inline void reserve(Size capacity) {
+			data->reserve(capacity);
+		}
+		
 		/// Get the contents from another vector.
 		/**
 		 * \note The contents will be shared, not copied. To get a copy, you can use:
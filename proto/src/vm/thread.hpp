@@ -32,16 +32,19 @@ class BasicThread {
 		/// The desired period for this thread.
 		/** \memberof Thread */
 		/**
-		 * \warning This variable is currently not used in the scheduler.
+		 * An active thread with a desired period is not run again until that much time has passed since its last run.
+		 * A thread without one (0, the default) runs at the rate of the device.
+		 * 
+		 * \see Machine::next_run()
 		 */
-		Time desired_period; //TODO: Use this in the scheduler.
+		Time desired_period;
 		
 	protected:
 		bool is_triggered;
 		bool is_active;
 		
 	public:
-		BasicThread() : desired_period(1) {} //TODO: Find a better way to get a value for desired_period.
+		BasicThread() : last_time(0), desired_period(0) {}
 		
 		/// Trigger this thread.
 		/**
@@ -82,6 +85,30 @@ class BasicThread {
 			return is_active || is_triggered;
 		}
 		
+		/// Check whether this thread is due to run at the given time (true) or not (false).
+		/**
+		 * A triggered thread is always due, an active one once its desired_period has passed since its last run.
+		 * A thread stays due at the time of its last run, so a device can run it more than once in one round.
+		 */
+		/** \memberof Thread */
+		bool due(Time now) const {
+			return is_triggered || desired_period <= 0 || last_time == now || last_time + desired_period <= now;
+		}
+		
+		/// The time from \p now until this thread is due.
+		/**
+		 * \param now The time of the current run.
+		 * A thread that is already due, but was not run because another one was, waits for the next round.
+		 * 
+		 * \param period The rate of the device, used for threads without a desired_period, for triggered threads and for threads that are already due.
+		 */
+		/** \memberof Thread */
+		Time wait(Time now, Time period) const {
+			if (is_triggered || desired_period <= 0) return period;
+			Time wait = last_time + desired_period - now;
+			return wait > 0 ? wait : period;
+		}
+		
 		/// The result of the last execution of this thread.
 		/** \memberof Thread */
 		Data result;
@@ -108,7 +135,7 @@ typedef Thread ExtendedThread;
  * The first thread corresponds to the last global, the second thread to the second last global, and so on.
  * 
  * A thread can be triggered and activated. It is called 'pending' when it is either triggered, activated or both.
- * The Machine::run() starts the execution of the next pending Thread, Round-robin style.
+ * The Machine::run() starts the execution of the next pending Thread that is due, Round-robin style.
  * 
  * \note This class is \ref extending "extensible".
  * 
@@ -22,7 +22,8 @@ class Data;
  * \brief A SharedVector of Data.
  * 
  * One of the types that can be stored in Data.
+ * Most tuples are 2D or 3D coordinates and vectors, so up to 4 elements are stored inline.
  */
-typedef SharedVector<Data> Tuple;
+typedef SharedVector<Data, 4> Tuple;
 
 #endif